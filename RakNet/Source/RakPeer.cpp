@@ -316,6 +316,7 @@ RakPeer::RakPeer()
 	GenerateGUID();
 
 	quitAndDataEvents.InitEvent();
+	packetArrivalEvent.InitEvent();
 	limitConnectionFrequencyFromTheSameIP = false;
 	ResetSendReceipt();
 }
@@ -335,6 +336,7 @@ RakPeer::~RakPeer()
 	WSAStartupSingleton::Deref();
 
 	quitAndDataEvents.CloseEvent();
+	packetArrivalEvent.CloseEvent();
 
 #if LIBCAT_SECURITY==1
 	// Encryption and security
@@ -1033,6 +1035,7 @@ void RakPeer::Shutdown(unsigned int blockDuration, unsigned char orderingChannel
 	activeSystemListSize = 0;
 
 	quitAndDataEvents.SetEvent();
+	packetArrivalEvent.SetEvent();
 
 	endThreads = true;
 
@@ -1117,9 +1120,7 @@ void RakPeer::Shutdown(unsigned int blockDuration, unsigned char orderingChannel
 		DeallocatePacket(packetReturnQueue[i]);
 	packetReturnQueue.Clear(_FILE_AND_LINE_);
 	packetReturnMutex.Unlock();
-	packetAllocationPoolMutex.Lock();
-	packetAllocationPool.Clear(_FILE_AND_LINE_);
-	packetAllocationPoolMutex.Unlock();
+	// The packets still held by the user are deallocated after the shutdown: the pool is freed with the peer
 
 	/*
 	if (isRecvFromLoopThreadActive.GetValue()>0)
@@ -1507,6 +1508,20 @@ Packet* RakPeer::Receive(void)
 	return packet;
 }
 
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+// Blocks until a packet is added to the incoming queue, the peer shuts down or the timeout elapses
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RakPeer::WaitForPacket(int timeoutMs)
+{
+	packetReturnMutex.Lock();
+	bool hasPacket = !packetReturnQueue.IsEmpty();
+	packetReturnMutex.Unlock();
+
+	if (!hasPacket && IsActive())
+		packetArrivalEvent.WaitOnEvent(timeoutMs);
+}
+
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // Description:
 // Call this to deallocate a packet returned by Receive
@@ -2741,6 +2756,7 @@ void RakPeer::PushBackPacket(Packet *packet, bool pushAtHead)
 	else
 		packetReturnQueue.Push(packet, _FILE_AND_LINE_);
 	packetReturnMutex.Unlock();
+	packetArrivalEvent.SetEvent();
 }
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -4301,6 +4317,7 @@ inline void RakPeer::AddPacketToProducer(RakNet::Packet *p)
 	packetReturnMutex.Lock();
 	packetReturnQueue.Push(p, _FILE_AND_LINE_);
 	packetReturnMutex.Unlock();
+	packetArrivalEvent.SetEvent();
 }
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 union Buff6AndBuff8
@@ -273,6 +273,11 @@ namespace RakNet {
 		/// \sa RakNetTypes.h contains struct Packet.
 		Packet* Receive(void);
 
+		/// \brief Blocks the calling thread until a message is pushed to the incoming message queue, the peer shuts down, or the timeout elapses.
+		/// \details Call Receive() in a loop afterwards to drain the queue.
+		/// \param[in] timeoutMs Maximum time to wait, in milliseconds.
+		void WaitForPacket(int timeoutMs);
+
 		/// \brief Call this to deallocate a message returned by Receive() when you are done handling it.
 		/// \param[in] packet Message to deallocate.	
 		void DeallocatePacket(Packet *packet);
@@ -988,6 +993,7 @@ namespace RakNet {
 
 
 		SignaledEvent quitAndDataEvents;
+		SignaledEvent packetArrivalEvent{ true };
 		bool limitConnectionFrequencyFromTheSameIP;
 
 		SimpleMutex packetAllocationPoolMutex;
@@ -246,6 +246,11 @@ namespace RakNet
 		/// sa RakNetTypes.h contains struct Packet
 		virtual Packet* Receive(void) = 0;
 
+		/// Blocks the calling thread until a message is pushed to the incoming message queue, the peer shuts down, or the timeout elapses.
+		/// Call Receive() in a loop afterwards to drain the queue.
+		/// \param[in] timeoutMs Maximum time to wait, in milliseconds.
+		virtual void WaitForPacket(int timeoutMs) = 0;
+
 		/// Call this to deallocate a message returned by Receive() when you are done handling it.
 		/// \param[in] packet The message to deallocate.	
 		virtual void DeallocatePacket(Packet *packet) = 0;
@@ -26,7 +26,8 @@ using namespace RakNet;
 
 
 
-SignaledEvent::SignaledEvent()
+SignaledEvent::SignaledEvent(bool autoReset)
+	: autoReset(autoReset)
 {
 
 }
@@ -47,11 +48,25 @@ void SignaledEvent::CloseEvent(void)
 
 void SignaledEvent::SetEvent(void)
 {
+	if (autoReset)
+	{
+		std::lock_guard<std::mutex> lock(this->_signalLock);
+		isSignaled = true;
+	}
 	condition.notify_all();
 }
 
 void SignaledEvent::WaitOnEvent(int timeoutMs)
 {
 	std::unique_lock<std::mutex> lock(this->_signalLock);
-	condition.wait_for(lock, std::chrono::milliseconds(timeoutMs));
+	if (autoReset)
+	{
+		// A SetEvent() issued before the wait is not lost
+		condition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]() { return isSignaled; });
+		isSignaled = false;
+	}
+	else
+	{
+		condition.wait_for(lock, std::chrono::milliseconds(timeoutMs));
+	}
 }
@@ -37,7 +37,9 @@ namespace RakNet
 class RAK_DLL_EXPORT SignaledEvent
 {
 public:
-	SignaledEvent();
+	/// An auto-reset event stays signaled until a waiter consumes it, so a SetEvent() issued
+	/// before WaitOnEvent() is not lost. Otherwise SetEvent() only wakes the current waiters.
+	explicit SignaledEvent(bool autoReset = false);
 	~SignaledEvent();
 
 	void InitEvent(void);
@@ -49,6 +51,8 @@ protected:
 	
 	std::mutex _signalLock;
 	std::condition_variable condition;
+	const bool autoReset;
+	bool isSignaled = false;
 };
 
 } // namespace RakNet
@@ -0,0 +1,117 @@
+#pragma once
+#include "TestCase.h"
+#include "stormancer/stormancer.h"
+#include "stormancer/ContainerConfigurator.h"
+#include "stormancer/AES/IAES.h"
+#include "stormancer/KeyStore.h"
+
+/// Measures the encrypt and decrypt throughput of the platform IAES implementation at typical packet sizes.
+class TestAESThroughput : public TestCase
+{
+public:
+
+	virtual void set_up() override
+	{
+	}
+
+	virtual void tear_down() override
+	{
+	}
+
+	virtual bool run() override
+	{
+		using namespace Stormancer;
+
+		auto config = Configuration::create("http://localhost:8081", "test", "test");
+		config->logger = _logger;
+
+		DependencyResolver resolver;
+		ConfigureContainer(&resolver, config);
+		auto keyStore = resolver.resolve<KeyStore>();
+		for (int i = 0; i < 256 / 8; i++)
+		{
+			keyStore->key[i] = (byte)i;
+		}
+		auto aes = resolver.resolve<IAES>();
+		if (!aes)
+		{
+			set_error("No IAES implementation on this platform");
+			return false;
+		}
+
+		const std::streamsize packetSizes[] = { 64, 256, 512, 1024, 1400 };
+		for (auto packetSize : packetSizes)
+		{
+			if (!measure(aes, packetSize))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	virtual std::string get_name() override
+	{
+		return "TestAESThroughput";
+	}
+
+private:
+
+	static const int iterations = 20000;
+
+	bool measure(std::shared_ptr<Stormancer::IAES> aes, std::streamsize packetSize)
+	{
+		using namespace Stormancer;
+
+		std::vector<byte> data((std::size_t)packetSize);
+		for (std::size_t i = 0; i < data.size(); i++)
+		{
+			data[i] = (byte)(i * 7);
+		}
+		std::streamsize ivSize = aes->ivSize();
+		byte iv[256 / 8];
+		aes->generateRandomIV(iv);
+
+		// Warm up the contexts and the output buffers, so the streams can be rewound in the loops
+		obytestream encrypted;
+		aes->encrypt(data.data(), packetSize, iv, ivSize, &encrypted, 0);
+		obytestream decrypted;
+		aes->decrypt(encrypted.startPtr(), encrypted.writtenBytesCount(), iv, ivSize, &decrypted, 0);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			encrypted.seekp(0);
+			aes->encrypt(data.data(), packetSize, iv, ivSize, &encrypted, 0);
+		}
+		auto encryptDuration = std::chrono::steady_clock::now() - start;
+		std::streamsize encryptedSize = encrypted.writtenBytesCount();
+
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			decrypted.seekp(0);
+			aes->decrypt(encrypted.startPtr(), encryptedSize, iv, ivSize, &decrypted, 0);
+		}
+		auto decryptDuration = std::chrono::steady_clock::now() - start;
+
+		if (decrypted.writtenBytesCount() != packetSize || std::memcmp(decrypted.startPtr(), data.data(), (std::size_t)packetSize) != 0)
+		{
+			set_error("Decrypted data differs from the original data for " + std::to_string(packetSize) + " bytes packets");
+			return false;
+		}
+
+		auto size = std::to_string(packetSize) + " B";
+		_logger->log(LogLevel::Info, "TestAESThroughput", "Encrypt bytes/s, " + size, std::to_string(bytesPerSecond(packetSize, encryptDuration)));
+		_logger->log(LogLevel::Info, "TestAESThroughput", "Decrypt bytes/s, " + size, std::to_string(bytesPerSecond(packetSize, decryptDuration)));
+		return true;
+	}
+
+	static Stormancer::uint64 bytesPerSecond(std::streamsize packetSize, std::chrono::steady_clock::duration duration)
+	{
+		auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+		return (us > 0 ? (Stormancer::uint64)(packetSize * iterations * 1000000 / us) : 0);
+	}
+
+	Stormancer::ILogger_ptr _logger = std::make_shared<Stormancer::ConsoleLogger>();
+};
@@ -0,0 +1,141 @@
+#pragma once
+#include <queue>
+#include "TestCase.h"
+#include "stormancer/stormancer.h"
+#include "stormancer/IActionDispatcher.h"
+
+/// Measures the post and drain throughput of MainThreadActionDispatcher with 1 to 16 producer threads,
+/// against a dispatcher protecting a std::queue with a mutex (the previous implementation).
+class TestActionDispatcherThroughput : public TestCase
+{
+public:
+
+	virtual void set_up() override
+	{
+	}
+
+	virtual void tear_down() override
+	{
+	}
+
+	virtual bool run() override
+	{
+		const int producersCounts[] = { 1, 2, 4, 8, 16 };
+		for (auto producersCount : producersCounts)
+		{
+			Stormancer::MainThreadActionDispatcher dispatcher;
+			dispatcher.start();
+			auto lockFree = measure(producersCount,
+				[&](const std::function<void()>& action) { dispatcher.post(action); },
+				[&]() { dispatcher.update(std::chrono::milliseconds(5)); });
+
+			MutexQueueDispatcher reference;
+			auto mutexQueue = measure(producersCount,
+				[&](const std::function<void()>& action) { reference.post(action); },
+				[&]() { reference.update(std::chrono::milliseconds(5)); });
+
+			if (lockFree < 0 || mutexQueue < 0)
+			{
+				set_error("Not all the posted actions were run");
+				return false;
+			}
+
+			auto producers = std::to_string(producersCount) + " producers";
+			_logger->log(Stormancer::LogLevel::Info, "TestActionDispatcherThroughput", "Actions/s, lock-free, " + producers, std::to_string(lockFree));
+			_logger->log(Stormancer::LogLevel::Info, "TestActionDispatcherThroughput", "Actions/s, mutex queue, " + producers, std::to_string(mutexQueue));
+		}
+		return true;
+	}
+
+	virtual std::string get_name() override
+	{
+		return "TestActionDispatcherThroughput";
+	}
+
+private:
+
+	static const int actionsCount = 400000;
+
+	/// The previous MainThreadActionDispatcher implementation.
+	class MutexQueueDispatcher
+	{
+	public:
+
+		void post(const std::function<void()>& action)
+		{
+			std::lock_guard<std::mutex> l(_mutex);
+			_actions.push(action);
+		}
+
+		void update(std::chrono::milliseconds maxDuration)
+		{
+			auto start = std::chrono::system_clock::now();
+			while (true)
+			{
+				std::function<void()> action;
+				{
+					std::lock_guard<std::mutex> l(_mutex);
+					if (_actions.empty())
+					{
+						return;
+					}
+					action = _actions.front();
+					_actions.pop();
+				}
+				action();
+				if (std::chrono::system_clock::now() - start > maxDuration)
+				{
+					return;
+				}
+			}
+		}
+
+	private:
+
+		std::queue<std::function<void()>> _actions;
+		std::mutex _mutex;
+	};
+
+	/// Returns the number of actions posted and run per second, or -1 if some actions were not run.
+	Stormancer::int64 measure(int producersCount, std::function<void(const std::function<void()>&)> post, std::function<void()> update)
+	{
+		std::atomic<int> runCount(0);
+		int actionsPerProducer = actionsCount / producersCount;
+		int total = actionsPerProducer * producersCount;
+
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> producers;
+		for (int p = 0; p < producersCount; p++)
+		{
+			producers.emplace_back([&]() {
+				for (int i = 0; i < actionsPerProducer; i++)
+				{
+					post([&runCount]() { runCount++; });
+				}
+			});
+		}
+
+		// The current thread is the main thread draining the dispatcher
+		auto timeout = start + std::chrono::seconds(30);
+		while (runCount < total && std::chrono::steady_clock::now() < timeout)
+		{
+			update();
+		}
+		auto duration = std::chrono::steady_clock::now() - start;
+
+		for (auto& producer : producers)
+		{
+			producer.join();
+		}
+
+		if (runCount != total)
+		{
+			return -1;
+		}
+		auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+		return (us > 0 ? (Stormancer::int64)total * 1000000 / us : 0);
+	}
+
+	Stormancer::ILogger_ptr _logger = std::make_shared<Stormancer::ConsoleLogger>();
+};
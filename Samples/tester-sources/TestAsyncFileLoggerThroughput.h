@@ -0,0 +1,150 @@
+#pragma once
+#include <cstdio>
+#include <fstream>
+#include "TestCase.h"
+#include "stormancer/stormancer.h"
+#include "stormancer/Logger/AsyncFileLogger.h"
+
+/// Measures the time spent in log() by 4 threads logging Trace records, with FileLogger and AsyncFileLogger,
+/// and checks that AsyncFileLogger writes every record when it waits for free slots, and rotates its file.
+class TestAsyncFileLoggerThroughput : public TestCase
+{
+public:
+
+	virtual void set_up() override
+	{
+		removeFiles();
+	}
+
+	virtual void tear_down() override
+	{
+		removeFiles();
+	}
+
+	virtual bool run() override
+	{
+		using namespace Stormancer;
+
+		{
+			auto logger = std::make_shared<FileLogger>(fileLoggerPath);
+			report("FileLogger", measure(logger));
+		}
+
+		uint64 dropped = 0;
+		{
+			auto logger = std::make_shared<AsyncFileLogger>(asyncDropPath, 8192, AsyncFileLogger::OverflowPolicy::Drop);
+			report("AsyncFileLogger, Drop", measure(logger));
+			logger->flush();
+			dropped = logger->droppedCount();
+		}
+		_logger->log(LogLevel::Info, "TestAsyncFileLoggerThroughput", "Dropped records, Drop", std::to_string(dropped));
+		// The file also counts the dropped records report lines
+		if (countLines(asyncDropPath) < (int64)(threadsCount * recordsPerThread - dropped))
+		{
+			set_error("AsyncFileLogger lost records it didn't count as dropped");
+			return false;
+		}
+
+		{
+			auto logger = std::make_shared<AsyncFileLogger>(asyncWaitPath, 8192, AsyncFileLogger::OverflowPolicy::Wait);
+			report("AsyncFileLogger, Wait", measure(logger));
+		}
+		if (countLines(asyncWaitPath) != threadsCount * recordsPerThread)
+		{
+			set_error("AsyncFileLogger didn't write all the records");
+			return false;
+		}
+
+		{
+			auto logger = std::make_shared<AsyncFileLogger>(asyncRotatePath, 1024, AsyncFileLogger::OverflowPolicy::Wait, 64 * 1024, 2);
+			for (int i = 0; i < 10000; i++)
+			{
+				logger->log(LogLevel::Trace, "TestAsyncFileLoggerThroughput", "Rotated record", std::to_string(i));
+			}
+		}
+		if (countLines(asyncRotatePath) <= 0 || countLines(std::string(asyncRotatePath) + ".1") <= 0 || countLines(std::string(asyncRotatePath) + ".2") <= 0 || countLines(std::string(asyncRotatePath) + ".3") >= 0)
+		{
+			set_error("AsyncFileLogger didn't rotate its file");
+			return false;
+		}
+
+		return true;
+	}
+
+	virtual std::string get_name() override
+	{
+		return "TestAsyncFileLoggerThroughput";
+	}
+
+private:
+
+	static const int threadsCount = 4;
+	static const int recordsPerThread = 100000;
+
+	const char* fileLoggerPath = "test_filelogger.log";
+	const char* asyncDropPath = "test_asyncfilelogger_drop.log";
+	const char* asyncWaitPath = "test_asyncfilelogger_wait.log";
+	const char* asyncRotatePath = "test_asyncfilelogger_rotate.log";
+
+	/// Returns the average time in log(), in nanoseconds.
+	Stormancer::int64 measure(Stormancer::ILogger_ptr logger)
+	{
+		using namespace Stormancer;
+
+		std::atomic<int64> totalNs(0);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadsCount; t++)
+		{
+			threads.emplace_back([&, t]() {
+				std::string data = std::to_string(t);
+				auto start = std::chrono::steady_clock::now();
+				for (int i = 0; i < recordsPerThread; i++)
+				{
+					logger->log(LogLevel::Trace, "RakNetTransport", "RakNet packet received", data);
+				}
+				totalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		return totalNs / (threadsCount * recordsPerThread);
+	}
+
+	void report(const std::string& name, Stormancer::int64 ns)
+	{
+		_logger->log(Stormancer::LogLevel::Info, "TestAsyncFileLoggerThroughput", "ns per log(), " + name, std::to_string(ns));
+	}
+
+	/// Returns the number of lines of a file, or -1 if it doesn't exist.
+	static Stormancer::int64 countLines(const std::string& path)
+	{
+		std::ifstream file(path);
+		if (!file.is_open())
+		{
+			return -1;
+		}
+		Stormancer::int64 count = 0;
+		std::string line;
+		while (std::getline(file, line))
+		{
+			count++;
+		}
+		return count;
+	}
+
+	void removeFiles()
+	{
+		for (auto path : { fileLoggerPath, asyncDropPath, asyncWaitPath })
+		{
+			std::remove(path);
+		}
+		for (auto suffix : { "", ".1", ".2", ".3" })
+		{
+			std::remove((std::string(asyncRotatePath) + suffix).c_str());
+		}
+	}
+
+	Stormancer::ILogger_ptr _logger = std::make_shared<Stormancer::ConsoleLogger>();
+};
@@ -0,0 +1,165 @@
+#pragma once
+#include "TestCase.h"
+#include "stormancer/stormancer.h"
+#include "stormancer/EndpointRace.h"
+
+/// Races fake endpoints answering after a known delay: checks the fastest endpoint wins without waiting for the slow
+/// ones, a failure starts the next attempt immediately, and the next race tries the fastest endpoint first.
+/// Checks that a race canceled by the caller doesn't try the remaining endpoints.
+class TestEndpointRace : public TestCase
+{
+public:
+
+	virtual void set_up() override
+	{
+	}
+
+	virtual void tear_down() override
+	{
+	}
+
+	virtual bool run() override
+	{
+		using namespace Stormancer;
+
+		auto latencies = std::make_shared<EndpointLatencies>();
+
+		// "slow" is tried first, "fast" starts after the race delay and answers before "slow"
+		auto result = race({ "slow", "fast", "broken" }, latencies);
+		if (result.first != "fast" || result.second >= slowDelay)
+		{
+			set_error("The fast endpoint didn't win the first race (" + result.first + " after " + std::to_string(result.second) + " ms)");
+			return false;
+		}
+		// The losers are canceled right after the winner result is set
+		for (int i = 0; i < 100 && _canceled == 0; i++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		if (_canceled != 1)
+		{
+			set_error("The slow endpoint attempt was not canceled");
+			return false;
+		}
+
+		// The fast endpoint is tried first now
+		auto sorted = latencies->sort({ "slow", "fast", "broken" });
+		if (sorted[0] != "fast")
+		{
+			set_error("The fast endpoint is not sorted first");
+			return false;
+		}
+		result = race(sorted, latencies);
+		if (result.first != "fast" || result.second >= raceDelay)
+		{
+			set_error("The second race didn't start with the fast endpoint");
+			return false;
+		}
+
+		// A failing endpoint doesn't delay the next one
+		result = race({ "broken", "fast" }, latencies, std::chrono::milliseconds(5000));
+		if (result.first != "fast" || result.second >= 1000)
+		{
+			set_error("The failure of an endpoint didn't start the next attempt");
+			return false;
+		}
+		if (latencies->sort({ "broken", "slow" })[0] != "slow")
+		{
+			set_error("The failed endpoint is not sorted last");
+			return false;
+		}
+
+		// All the endpoints failing fail the race
+		try
+		{
+			race({ "broken", "broken2" }, latencies);
+			set_error("The race succeeded without any working endpoint");
+			return false;
+		}
+		catch (const std::exception& ex)
+		{
+			_logger->log(LogLevel::Info, "TestEndpointRace", "Race failed as expected", ex.what());
+		}
+
+		// Canceling the race cancels the running attempt, and doesn't start the next ones
+		pplx::cancellation_token_source cts;
+		_attempts = 0;
+		auto canceledRace = raceEndpoints({ "slow", "slow", "slow" }, attempt(), std::chrono::milliseconds(raceDelay), latencies, cts.get_token());
+		cts.cancel();
+		try
+		{
+			canceledRace.get();
+			set_error("The canceled race succeeded");
+			return false;
+		}
+		catch (const pplx::task_canceled&)
+		{
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(3 * raceDelay));
+		if (_attempts != 1)
+		{
+			set_error("The race tried " + std::to_string(_attempts.load()) + " endpoints after being canceled");
+			return false;
+		}
+
+		return true;
+	}
+
+	virtual std::string get_name() override
+	{
+		return "TestEndpointRace";
+	}
+
+private:
+
+	static const int raceDelay = 100;
+	static const int slowDelay = 1000;
+	static const int fastDelay = 20;
+
+	/// Returns the winning endpoint, and the race duration in milliseconds.
+	std::pair<std::string, Stormancer::int64> race(std::vector<std::string> endpoints, std::shared_ptr<Stormancer::EndpointLatencies> latencies, std::chrono::milliseconds delay = std::chrono::milliseconds(raceDelay))
+	{
+		using namespace Stormancer;
+
+		_canceled = 0;
+		auto start = std::chrono::steady_clock::now();
+		auto winner = raceEndpoints(endpoints, attempt(), delay, latencies).get();
+		auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		_logger->log(LogLevel::Info, "TestEndpointRace", "Race won by " + winner, std::to_string(ms) + " ms");
+		return { winner, ms };
+	}
+
+	/// Fake attempt: the "broken" endpoints fail, "slow" answers after slowDelay, the others after fastDelay.
+	std::function<pplx::task<std::string>(const std::string&, pplx::cancellation_token)> attempt()
+	{
+		using namespace Stormancer;
+
+		return [this](const std::string& endpoint, pplx::cancellation_token ct) {
+			_attempts++;
+			pplx::task_completion_event<std::string> tce;
+			if (endpoint.compare(0, 6, "broken") == 0)
+			{
+				TimerThread::getInstance().schedule([tce]() {
+					tce.set_exception(std::runtime_error("unreachable"));
+				}, TimerThread::clock_type::now() + std::chrono::milliseconds(fastDelay));
+			}
+			else
+			{
+				TimerThread::getInstance().schedule([tce, endpoint]() {
+					tce.set(endpoint);
+				}, TimerThread::clock_type::now() + std::chrono::milliseconds(endpoint == "slow" ? slowDelay : fastDelay));
+			}
+			if (endpoint == "slow")
+			{
+				ct.register_callback([this]() {
+					_canceled++;
+				});
+			}
+			return pplx::task<std::string>(tce, ct);
+		};
+	}
+
+	std::atomic<int> _canceled;
+	std::atomic<int> _attempts;
+	Stormancer::ILogger_ptr _logger = std::make_shared<Stormancer::ConsoleLogger>();
+};
@@ -0,0 +1,211 @@
+#pragma once
+#include <algorithm>
+#include "TestCase.h"
+#include "stormancer/stormancer.h"
+#include "stormancer/P2P/ConnectionsRepository.h"
+#include "stormancer/P2P/RakNet/P2PTunnels.h"
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+/// Runs datagrams through a host side P2P tunnel on the loopback: the datagrams received from the peer are forwarded
+/// to a local echo game server, and the replies are sent back on the peer connection.
+/// Measures the tunnel round trip latency and throughput.
+class TestP2PTunnelThroughput : public TestCase
+{
+public:
+
+	virtual void set_up() override
+	{
+	}
+
+	virtual void tear_down() override
+	{
+	}
+
+	virtual bool run() override
+	{
+#if defined(__linux__)
+		using namespace Stormancer;
+
+		// Game server echoing the datagrams
+		int server = ::socket(AF_INET, SOCK_DGRAM, 0);
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t addressSize = sizeof(address);
+		timeval timeout = { 0, 100000 };
+		setsockopt(server, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		if (::bind(server, (sockaddr*)&address, addressSize) < 0 || getsockname(server, (sockaddr*)&address, &addressSize) < 0)
+		{
+			::close(server);
+			set_error("Can't open the game server socket");
+			return false;
+		}
+		std::atomic<bool> stopServer(false);
+		std::thread serverThread([&]() {
+			byte buffer[2048];
+			while (!stopServer)
+			{
+				sockaddr_in from;
+				socklen_t fromSize = sizeof(from);
+				ssize_t size = ::recvfrom(server, buffer, sizeof(buffer), 0, (sockaddr*)&from, &fromSize);
+				if (size > 0)
+				{
+					::sendto(server, buffer, (std::size_t)size, 0, (sockaddr*)&from, fromSize);
+				}
+			}
+		});
+
+		auto config = Configuration::create("http://localhost:8081", "test", "test");
+		config->serverGamePort = ntohs(address.sin_port);
+		auto connections = std::make_shared<ConnectionsRepository>(_logger);
+		auto peer = std::make_shared<PeerConnection>();
+		connections->newConnection(peer);
+
+		auto tunnels = std::make_shared<P2PTunnels>(nullptr, connections, nullptr, config, _logger);
+		tunnels->createServer("gameServer", tunnels);
+		byte handle = tunnels->addClient("gameServer", peer->id());
+
+		std::vector<byte> datagram(1 + datagramSize);
+		datagram[0] = handle;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < datagramsCount; i++)
+		{
+			// Keep a bounded number of datagrams in flight, so the loopback doesn't drop them
+			peer->waitForReplies(i - maxInFlight);
+
+			int64 sentOn = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+			std::memcpy(datagram.data() + 1, &sentOn, sizeof(sentOn));
+			ibytestream stream(datagram.data(), (std::streamsize)datagram.size());
+			tunnels->receiveFrom(peer->id(), &stream);
+		}
+		peer->waitForReplies(datagramsCount);
+		auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+		stopServer = true;
+		serverThread.join();
+		::close(server);
+		tunnels->closeTunnel(handle, peer->id());
+
+		auto latencies = peer->latencies();
+		_logger->log(LogLevel::Info, "TestP2PTunnelThroughput", "Datagrams returned", std::to_string(latencies.size()) + "/" + std::to_string(datagramsCount));
+		_logger->log(LogLevel::Info, "TestP2PTunnelThroughput", "Datagrams/s", std::to_string(us > 0 ? (int64)latencies.size() * 1000000 / us : 0));
+		if (latencies.size() < (std::size_t)datagramsCount * 99 / 100)
+		{
+			set_error("Too many datagrams were lost in the tunnel");
+			return false;
+		}
+		if (peer->corrupted())
+		{
+			set_error("The tunnel sent invalid frames on the peer connection");
+			return false;
+		}
+		std::nth_element(latencies.begin(), latencies.begin() + latencies.size() / 2, latencies.end());
+		_logger->log(LogLevel::Info, "TestP2PTunnelThroughput", "Median round trip (us)", std::to_string(latencies[latencies.size() / 2] / 1000));
+#endif
+		return true;
+	}
+
+	virtual std::string get_name() override
+	{
+		return "TestP2PTunnelThroughput";
+	}
+
+private:
+
+	static const int datagramsCount = 50000;
+	static const int datagramSize = 256;
+	static const int maxInFlight = 32;
+
+	/// Connection to the remote peer, recording the frames sent by the tunnel.
+	class PeerConnection : public Stormancer::IConnection
+	{
+	public:
+
+		void send(const Stormancer::Writer& writer, int, PacketPriority, PacketReliability, const Stormancer::TransformMetadata&) override
+		{
+			using namespace Stormancer;
+
+			obytestream stream;
+			writer(&stream);
+			stream.flush();
+			int64 now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+			int64 sentOn = 0;
+			bool valid = stream.writtenBytesCount() == 2 + datagramSize && stream.startPtr()[0] == (byte)MessageIDTypes::ID_P2P_TUNNEL;
+			if (valid)
+			{
+				std::memcpy(&sentOn, stream.startPtr() + 2, sizeof(sentOn));
+			}
+
+			std::lock_guard<std::mutex> lg(_mutex);
+			_corrupted = _corrupted || !valid;
+			_latencies.push_back(now - sentOn);
+			_replied.notify_all();
+		}
+
+		/// Wait until the given number of replies was sent. The missing replies are counted as lost after a while.
+		void waitForReplies(int count)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			if (!_replied.wait_for(lock, std::chrono::milliseconds(200), [this, count]() {
+				return (int)_latencies.size() + _lost >= count;
+			}))
+			{
+				_lost = count - (int)_latencies.size();
+			}
+		}
+
+		std::vector<Stormancer::int64> latencies()
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			return _latencies;
+		}
+
+		bool corrupted()
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			return _corrupted;
+		}
+
+		void setApplication(std::string, std::string) override {}
+		void close(std::string) override {}
+		std::string ipAddress() const override { return "127.0.0.1"; }
+		int ping() const override { return 0; }
+		Stormancer::uint64 id() const override { return 1; }
+		time_t connectionDate() const override { return 0; }
+		const std::string& account() const override { return _empty; }
+		const std::string& application() const override { return _empty; }
+		const std::map<std::string, std::string>& metadata() const override { return _metadata; }
+		std::string metadata(const std::string&) const override { return std::string(); }
+		void setMetadata(const std::map<std::string, std::string>&) override {}
+		void setMetadata(const std::string&, const std::string&) override {}
+		Stormancer::DependencyResolver* dependencyResolver() override { return nullptr; }
+		Stormancer::ConnectionState getConnectionState() const override { return Stormancer::ConnectionState::Connected; }
+		rxcpp::observable<Stormancer::ConnectionState> getConnectionStateChangedObservable() const override { return _states.get_observable(); }
+		Stormancer::Action<std::string>::TIterator onClose(std::function<void(std::string)> callback) override { return _closeAction.push_back(callback); }
+		Stormancer::Action<std::string>& onCloseAction() override { return _closeAction; }
+
+	protected:
+
+		void setConnectionState(Stormancer::ConnectionState) override {}
+
+	private:
+
+		std::mutex _mutex;
+		std::condition_variable _replied;
+		std::vector<Stormancer::int64> _latencies;
+		bool _corrupted = false;
+		int _lost = 0;
+		std::string _empty;
+		std::map<std::string, std::string> _metadata;
+		rxcpp::subjects::subject<Stormancer::ConnectionState> _states;
+		Stormancer::Action<std::string> _closeAction;
+	};
+
+	Stormancer::ILogger_ptr _logger = std::make_shared<Stormancer::ConsoleLogger>();
+};
@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdio>
+#include "TestCase.h"
+#include "stormancer/stormancer.h"
+#include "stormancer/PacketCapture.h"
+#include "stormancer/PacketReplay.h"
+
+/// Captures synthetic inbound and outbound frames with PacketCapture, replays the capture through DefaultPacketDispatcher,
+/// and checks that every inbound frame reaches its handler in order. Measures the cost of record() and the replay throughput.
+class TestPacketCaptureReplay : public TestCase
+{
+public:
+
+	virtual void set_up() override
+	{
+		std::remove(capturePath);
+	}
+
+	virtual void tear_down() override
+	{
+		std::remove(capturePath);
+	}
+
+	virtual bool run() override
+	{
+		using namespace Stormancer;
+
+		int64 recordNs = 0;
+		uint64 dropped = 0;
+		{
+			PacketCapture capture(capturePath);
+			byte frame[64] = {};
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < framesCount; i++)
+			{
+				frame[0] = (byte)MessageIDTypes::ID_SCENES;
+				std::memcpy(frame + 1, &i, sizeof(i));
+				capture.record(PacketCapture::Direction::Inbound, 1, frame, sizeof(frame));
+				frame[0] = (byte)MessageIDTypes::ID_SYSTEM_REQUEST;
+				capture.record(PacketCapture::Direction::Outbound, 1, frame, sizeof(frame));
+			}
+			recordNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / (2 * framesCount);
+			capture.flush();
+			dropped = capture.droppedCount();
+		}
+		_logger->log(LogLevel::Info, "TestPacketCaptureReplay", "ns per record()", std::to_string(recordNs));
+		_logger->log(LogLevel::Info, "TestPacketCaptureReplay", "Dropped frames", std::to_string(dropped));
+
+		PacketReplay replay(capturePath);
+		if (replay.records().size() != 2 * framesCount - dropped)
+		{
+			set_error("The capture doesn't contain all the recorded frames");
+			return false;
+		}
+
+		auto received = std::make_shared<std::vector<int>>();
+		received->reserve(framesCount);
+		DefaultPacketDispatcher dispatcher(_logger, false);
+		dispatcher.addProcessor(std::make_shared<SceneProcessor>(received));
+
+		auto start = std::chrono::steady_clock::now();
+		std::size_t dispatched = replay.replay(dispatcher);
+		auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		_logger->log(LogLevel::Info, "TestPacketCaptureReplay", "Replayed packets/s", std::to_string(us > 0 ? (int64)dispatched * 1000000 / us : 0));
+
+		if (dispatched != received->size() || (dropped == 0 && dispatched != (std::size_t)framesCount))
+		{
+			set_error("Some inbound frames were not replayed");
+			return false;
+		}
+		for (std::size_t i = 1; i < received->size(); i++)
+		{
+			if ((*received)[i] <= (*received)[i - 1])
+			{
+				set_error("The frames were not replayed in order");
+				return false;
+			}
+		}
+		return true;
+	}
+
+	virtual std::string get_name() override
+	{
+		return "TestPacketCaptureReplay";
+	}
+
+private:
+
+	static const int framesCount = 200000;
+
+	const char* capturePath = "test_packetcapture.cap";
+
+	/// Handles the scene frames, like SceneDispatcher, and stores the frame numbers.
+	class SceneProcessor : public Stormancer::IPacketProcessor
+	{
+	public:
+
+		SceneProcessor(std::shared_ptr<std::vector<int>> received)
+			: _received(received)
+		{
+		}
+
+		void registerProcessor(Stormancer::PacketProcessorConfig& config) override
+		{
+			using namespace Stormancer;
+
+			auto received = _received;
+			config.addCatchAllProcessor(new processorFunction([received](byte msgId, Packet_ptr packet) {
+				if (msgId >= (byte)MessageIDTypes::ID_SCENES)
+				{
+					int i;
+					packet->stream->read((byte*)&i, sizeof(i));
+					received->push_back(i);
+					return true;
+				}
+				return false;
+			}));
+		}
+
+	private:
+
+		std::shared_ptr<std::vector<int>> _received;
+	};
+
+	Stormancer::ILogger_ptr _logger = std::make_shared<Stormancer::ConsoleLogger>();
+};
@@ -0,0 +1,140 @@
+#pragma once
+#include "TestCase.h"
+#include "stormancer/stormancer.h"
+#include "stormancer/DefaultPacketDispatcher.h"
+
+/// Measures the number of packets per second dispatched by DefaultPacketDispatcher,
+/// for synthetic system request, request response and scene packets,
+/// and for scene messages coalesced by the sender in ID_BATCH packets.
+class TestPacketDispatchThroughput : public TestCase
+{
+public:
+
+	virtual void set_up() override
+	{
+	}
+
+	virtual void tear_down() override
+	{
+	}
+
+	virtual bool run() override
+	{
+		using namespace Stormancer;
+
+		auto counters = std::make_shared<Counters>();
+		DefaultPacketDispatcher dispatcher(_logger, false);
+		dispatcher.addProcessor(std::make_shared<CountingProcessor>(counters));
+
+		const MessageIDTypes msgIds[] = { MessageIDTypes::ID_SYSTEM_REQUEST, MessageIDTypes::ID_REQUEST_RESPONSE_MSG, MessageIDTypes::ID_SCENES };
+		const char* names[] = { "ID_SYSTEM_REQUEST", "ID_REQUEST_RESPONSE_MSG", "scene" };
+		for (int i = 0; i < 3; i++)
+		{
+			byte data[16] = {};
+			data[0] = (byte)msgIds[i];
+			ibytestream stream(data, sizeof(data));
+			auto packet = std::make_shared<Packet<>>(nullptr, &stream);
+
+			auto start = std::chrono::steady_clock::now();
+			for (int j = 0; j < iterations; j++)
+			{
+				stream.clear();
+				stream.seekg(0);
+				dispatcher.dispatchPacket(packet);
+			}
+			auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+			_logger->log(LogLevel::Info, "TestPacketDispatchThroughput", std::string("Packets/s, ") + names[i], std::to_string(us > 0 ? (int64)iterations * 1000000 / us : 0));
+		}
+
+		{
+			// ID_BATCH: repeated (uint16 length, message)
+			std::vector<byte> data(1, (byte)MessageIDTypes::ID_BATCH);
+			for (int i = 0; i < messagesPerBatch; i++)
+			{
+				uint16 length = 3;
+				data.insert(data.end(), (byte*)&length, (byte*)&length + sizeof(uint16));
+				data.push_back((byte)MessageIDTypes::ID_SCENES);
+				data.push_back((byte)i);
+				data.push_back(0);
+			}
+			ibytestream stream(data.data(), (std::streamsize)data.size());
+			auto packet = std::make_shared<Packet<>>(nullptr, &stream);
+
+			auto start = std::chrono::steady_clock::now();
+			for (int j = 0; j < iterations / messagesPerBatch; j++)
+			{
+				stream.clear();
+				stream.seekg(0);
+				dispatcher.dispatchPacket(packet);
+			}
+			auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+			_logger->log(LogLevel::Info, "TestPacketDispatchThroughput", "Messages/s, scene in ID_BATCH", std::to_string(us > 0 ? (int64)iterations * 1000000 / us : 0));
+		}
+
+		if (counters->systemRequests != iterations || counters->responses != iterations || counters->scenes != 2 * iterations)
+		{
+			set_error("Some packets were not dispatched to their handler");
+			return false;
+		}
+		return true;
+	}
+
+	virtual std::string get_name() override
+	{
+		return "TestPacketDispatchThroughput";
+	}
+
+private:
+
+	static const int iterations = 1000000;
+	static const int messagesPerBatch = 8;
+
+	struct Counters
+	{
+		int systemRequests = 0;
+		int responses = 0;
+		int scenes = 0;
+	};
+
+	/// Registers handlers like RequestProcessor and SceneDispatcher, which only count the packets.
+	class CountingProcessor : public Stormancer::IPacketProcessor
+	{
+	public:
+
+		CountingProcessor(std::shared_ptr<Counters> counters)
+			: _counters(counters)
+		{
+		}
+
+		void registerProcessor(Stormancer::PacketProcessorConfig& config) override
+		{
+			using namespace Stormancer;
+
+			auto counters = _counters;
+			config.addProcessor((byte)MessageIDTypes::ID_SYSTEM_REQUEST, new handlerFunction([counters](Packet_ptr) {
+				counters->systemRequests++;
+				return true;
+			}));
+			config.addProcessor((byte)MessageIDTypes::ID_REQUEST_RESPONSE_MSG, new handlerFunction([counters](Packet_ptr) {
+				counters->responses++;
+				return true;
+			}));
+			config.addCatchAllProcessor(new processorFunction([counters](byte msgId, Packet_ptr) {
+				if (msgId >= (byte)MessageIDTypes::ID_SCENES)
+				{
+					counters->scenes++;
+					return true;
+				}
+				return false;
+			}));
+		}
+
+	private:
+
+		std::shared_ptr<Counters> _counters;
+	};
+
+	Stormancer::ILogger_ptr _logger = std::make_shared<Stormancer::ConsoleLogger>();
+};
@@ -0,0 +1,163 @@
+#pragma once
+#include "TestCase.h"
+#include "stormancer/stormancer.h"
+#include "stormancer/RakNet/RakNetTransport.h"
+#include "stormancer/P2P/ConnectionsRepository.h"
+#include "RakPeerInterface.h"
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#endif
+
+/// Connects a RakNet transport to several peers at once, on the loopback.
+/// A silent endpoint must not delay the connections to the other peers, and a peer refusing the connection must only
+/// fail its own request.
+class TestParallelConnections : public TestCase
+{
+public:
+
+	virtual void set_up() override
+	{
+	}
+
+	virtual void tear_down() override
+	{
+	}
+
+	virtual bool run() override
+	{
+#if defined(__linux__)
+		using namespace Stormancer;
+
+		// Endpoint which never answers: its connection attempt lasts several seconds
+		int silent = ::socket(AF_INET, SOCK_DGRAM, 0);
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t addressSize = sizeof(address);
+		if (::bind(silent, (sockaddr*)&address, addressSize) < 0 || getsockname(silent, (sockaddr*)&address, &addressSize) < 0)
+		{
+			::close(silent);
+			set_error("Can't open the silent socket");
+			return false;
+		}
+
+		// Peer without free incoming connections: refuses the connection right away
+		auto full = RakNet::RakPeerInterface::GetInstance();
+		RakNet::SocketDescriptor socketDescriptor;
+		socketDescriptor.socketFamily = AF_INET;
+		DataStructures::List<RakNet::SocketDescriptor> socketDescriptorsList;
+		socketDescriptorsList.Push(socketDescriptor, _FILE_AND_LINE_);
+		full->Startup(1, socketDescriptorsList, 1);
+		full->SetMaximumIncomingConnections(0);
+
+		pplx::cancellation_token_source cts;
+		auto server = create_transport("server", cts.get_token());
+		std::vector<std::shared_ptr<RakNetTransport>> peers;
+		for (int i = 0; i < peersCount; i++)
+		{
+			peers.push_back(create_transport("peer", cts.get_token()));
+		}
+		auto client = create_transport("client", cts.get_token());
+
+		bool success = true;
+		try
+		{
+			// The first accepted connection is the server connection
+			client->connect("127.0.0.1:" + std::to_string(server->port())).get();
+
+			pplx::cancellation_token_source silentCts;
+			auto silentTask = client->connect("127.0.0.1:" + std::to_string(ntohs(address.sin_port)), silentCts.get_token());
+			auto fullTask = client->connect("127.0.0.1:" + std::to_string(full->GetMyBoundAddress().GetPort()));
+
+			auto start = std::chrono::steady_clock::now();
+			std::vector<pplx::task<std::shared_ptr<IConnection>>> peerTasks;
+			for (auto& peer : peers)
+			{
+				peerTasks.push_back(client->connect("127.0.0.1:" + std::to_string(peer->port())));
+			}
+			for (auto& task : peerTasks)
+			{
+				task.get();
+			}
+			auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+			_logger->log(LogLevel::Info, "TestParallelConnections", "Peers connected (ms)", std::to_string(ms));
+
+			if (ms >= maxConnectionDelay)
+			{
+				set_error("The connections to the peers waited for the silent endpoint");
+				success = false;
+			}
+
+			try
+			{
+				fullTask.get();
+				set_error("The connection to the full peer succeeded");
+				success = false;
+			}
+			catch (const std::exception& ex)
+			{
+				_logger->log(LogLevel::Info, "TestParallelConnections", "Full peer refused the connection", ex.what());
+			}
+
+			silentCts.cancel();
+			try
+			{
+				silentTask.get();
+				set_error("The connection to the silent endpoint succeeded");
+				success = false;
+			}
+			catch (const pplx::task_canceled&)
+			{
+			}
+		}
+		catch (const std::exception& ex)
+		{
+			set_error(std::string("Connection failed: ") + ex.what());
+			success = false;
+		}
+
+		cts.cancel();
+		full->Shutdown(100);
+		RakNet::RakPeerInterface::DestroyInstance(full);
+		::close(silent);
+		return success;
+#else
+		return true;
+#endif
+	}
+
+	virtual std::string get_name() override
+	{
+		return "TestParallelConnections";
+	}
+
+private:
+
+	static const int peersCount = 4;
+	/// A single RakNet connection attempt to the silent endpoint lasts 6 s.
+	static const int maxConnectionDelay = 2000;
+
+	std::shared_ptr<Stormancer::RakNetTransport> create_transport(std::string type, pplx::cancellation_token ct)
+	{
+		using namespace Stormancer;
+
+		auto config = Configuration::create("http://localhost:8081", "test", "test");
+		config->logger = _logger;
+
+		auto resolver = std::make_shared<DependencyResolver>();
+		resolver->registerDependency<Configuration>(config);
+		resolver->registerDependency<ILogger>(_logger);
+		resolver->registerDependency<IScheduler>(config->scheduler);
+		_resolvers.push_back(resolver);
+
+		auto transport = std::make_shared<RakNetTransport>(resolver.get());
+		transport->start(type, std::make_shared<ConnectionsRepository>(_logger), ct, 0, 10);
+		return transport;
+	}
+
+	std::vector<std::shared_ptr<Stormancer::DependencyResolver>> _resolvers;
+	Stormancer::ILogger_ptr _logger = std::make_shared<Stormancer::ConsoleLogger>();
+};
@@ -0,0 +1,141 @@
+#pragma once
+#include <algorithm>
+#include <random>
+#include "TestCase.h"
+#include "stormancer/stormancer.h"
+#include "stormancer/RequestSlotTable.h"
+
+/// Reserves, looks up and completes thousands of concurrent in-flight requests in a RequestSlotTable from 8 threads,
+/// and checks that no request is lost or completed twice, and that the slots are only allocated as needed.
+class TestPendingRequestsStress : public TestCase
+{
+public:
+
+	virtual void set_up() override
+	{
+	}
+
+	virtual void tear_down() override
+	{
+	}
+
+	virtual bool run() override
+	{
+		Stormancer::RequestSlotTable<Request> table;
+		std::atomic<int> errors(0);
+
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadsCount; t++)
+		{
+			threads.emplace_back([&, t]() {
+				std::mt19937 random(t);
+				std::vector<std::shared_ptr<Request>> inFlight;
+				inFlight.reserve(inFlightPerThread);
+
+				for (int round = 0; round < roundsCount; round++)
+				{
+					for (int i = 0; i < inFlightPerThread; i++)
+					{
+						auto request = std::make_shared<Request>();
+						request->owner = t;
+						request->id = table.reserve(request);
+						inFlight.push_back(request);
+					}
+
+					// Responses come back out of order
+					std::shuffle(inFlight.begin(), inFlight.end(), random);
+
+					for (auto& request : inFlight)
+					{
+						if (table.get(request->id) != request)
+						{
+							errors++;
+						}
+						if (table.remove(request->id, nullptr))
+						{
+							errors++;
+						}
+						// The id can be reserved again by another thread as soon as it is taken: only remove this request
+						if (table.take(request->id) != request || table.remove(request->id, request.get()))
+						{
+							errors++;
+						}
+					}
+					inFlight.clear();
+				}
+			});
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		auto duration = std::chrono::steady_clock::now() - start;
+
+		if (errors != 0)
+		{
+			set_error(std::to_string(errors.load()) + " requests were lost or completed twice");
+			return false;
+		}
+		if (table.size() != 0)
+		{
+			set_error("The table is not empty after all the requests completed");
+			return false;
+		}
+
+		// The slots are allocated on demand: the ids in flight never needed the whole table
+		if (table.allocatedSlots() >= Stormancer::RequestSlotTable<Request>::capacity)
+		{
+			set_error("The table allocated more slots than the requests in flight needed");
+			return false;
+		}
+
+		// All the ids can be used at once, and one more request overflows
+		for (Stormancer::uint32 i = 0; i < Stormancer::RequestSlotTable<Request>::capacity; i++)
+		{
+			table.reserve(std::make_shared<Request>());
+		}
+		try
+		{
+			table.reserve(std::make_shared<Request>());
+			set_error("Reserving more than 65536 requests should throw");
+			return false;
+		}
+		catch (const std::overflow_error&)
+		{
+		}
+		if (table.takeAll().size() != Stormancer::RequestSlotTable<Request>::capacity || table.size() != 0)
+		{
+			set_error("takeAll didn't return all the pending requests");
+			return false;
+		}
+
+		auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+		auto requestsCount = (Stormancer::int64)threadsCount * roundsCount * inFlightPerThread;
+		_logger->log(Stormancer::LogLevel::Info, "TestPendingRequestsStress", "Requests in flight", std::to_string(threadsCount * inFlightPerThread));
+		_logger->log(Stormancer::LogLevel::Info, "TestPendingRequestsStress", "Requests/s", std::to_string(us > 0 ? requestsCount * 1000000 / us : 0));
+		return true;
+	}
+
+	virtual std::string get_name() override
+	{
+		return "TestPendingRequestsStress";
+	}
+
+private:
+
+	struct Request
+	{
+		Stormancer::uint16 id = 0;
+		int owner = 0;
+	};
+
+	static const int threadsCount = 8;
+	static const int inFlightPerThread = 4000;
+	static const int roundsCount = 50;
+
+	Stormancer::ILogger_ptr _logger = std::make_shared<Stormancer::ConsoleLogger>();
+};
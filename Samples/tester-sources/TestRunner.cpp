@@ -1,11 +1,37 @@
 #include "TestRunner.h"
 #include "TestPlayerDataPlugin.h"
+#include "TestTransportLatency.h"
+#include "TestAESThroughput.h"
+#include "TestActionDispatcherThroughput.h"
+#include "TestPacketDispatchThroughput.h"
+#include "TestPendingRequestsStress.h"
+#include "TestTimerThroughput.h"
+#include "TestAsyncFileLoggerThroughput.h"
+#include "TestPacketCaptureReplay.h"
+#include "TestTcpTransport.h"
+#include "TestP2PTunnelThroughput.h"
+#include "TestParallelConnections.h"
+#include "TestEndpointRace.h"
+#include "TestSceneEndpointCache.h"
 
 TestRunner::TestRunner(Stormancer::ILogger_ptr logger)
 	: _logger(logger)
 {
 	// I cannot list-initialize the vector as it requires a copy ctor for elements
 	_tests.emplace_back(new TestPlayerDataPlugin);
+	_tests.emplace_back(new TestTransportLatency);
+	_tests.emplace_back(new TestAESThroughput);
+	_tests.emplace_back(new TestActionDispatcherThroughput);
+	_tests.emplace_back(new TestPacketDispatchThroughput);
+	_tests.emplace_back(new TestPendingRequestsStress);
+	_tests.emplace_back(new TestTimerThroughput);
+	_tests.emplace_back(new TestAsyncFileLoggerThroughput);
+	_tests.emplace_back(new TestPacketCaptureReplay);
+	_tests.emplace_back(new TestTcpTransport);
+	_tests.emplace_back(new TestP2PTunnelThroughput);
+	_tests.emplace_back(new TestParallelConnections);
+	_tests.emplace_back(new TestEndpointRace);
+	_tests.emplace_back(new TestSceneEndpointCache);
 }
 
 bool TestRunner::run_tests()
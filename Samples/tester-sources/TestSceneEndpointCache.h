@@ -0,0 +1,142 @@
+#pragma once
+#include "TestCase.h"
+#include "stormancer/stormancer.h"
+#include "stormancer/SceneEndpointCache.h"
+
+/// Requests scene endpoints through the cache with a fake API: checks concurrent requests share one fetch, cached
+/// endpoints are reused until their token is about to expire, failures are not cached, and canceling a request
+/// doesn't cancel the fetch for the other ones.
+class TestSceneEndpointCache : public TestCase
+{
+public:
+
+	virtual void set_up() override
+	{
+	}
+
+	virtual void tear_down() override
+	{
+	}
+
+	virtual bool run() override
+	{
+		using namespace Stormancer;
+
+		auto cache = std::make_shared<SceneEndpointCache>(nullptr);
+
+		// Concurrent requests share the fetch
+		_fetches = 0;
+		auto fetch = fakeFetch("scene1", std::chrono::minutes(5), std::chrono::milliseconds(50));
+		auto t1 = cache->get("scene1", fetch);
+		auto t2 = cache->get("scene1", fetch);
+		if (t1.get().tokenData.SceneId != "scene1" || t2.get().tokenData.SceneId != "scene1" || _fetches != 1)
+		{
+			set_error("Concurrent requests didn't share the fetch (" + std::to_string(_fetches) + " fetches)");
+			return false;
+		}
+
+		// The endpoint is cached until its token expires
+		cache->get("scene1", fetch).get();
+		if (_fetches != 1)
+		{
+			set_error("The cached endpoint was fetched again");
+			return false;
+		}
+
+		// A token about to expire is not cached
+		auto expiring = fakeFetch("scene2", std::chrono::seconds(10));
+		cache->get("scene2", expiring).get();
+		cache->get("scene2", expiring).get();
+		if (_fetches != 3)
+		{
+			set_error("An endpoint with an expiring token was cached");
+			return false;
+		}
+
+		// Invalidating the endpoint fetches it again
+		cache->invalidate("scene1");
+		cache->get("scene1", fetch).get();
+		if (_fetches != 4)
+		{
+			set_error("The invalidated endpoint was not fetched again");
+			return false;
+		}
+
+		// Failures are not cached
+		auto failing = [this]() {
+			_fetches++;
+			return pplx::task_from_exception<SceneEndpoint>(std::runtime_error("API unreachable"));
+		};
+		for (int i = 0; i < 2; i++)
+		{
+			try
+			{
+				cache->get("scene3", failing).get();
+				set_error("The failed fetch succeeded");
+				return false;
+			}
+			catch (const std::exception&)
+			{
+			}
+		}
+		if (_fetches != 6)
+		{
+			set_error("A failed fetch was cached");
+			return false;
+		}
+
+		// Canceling a request doesn't cancel the fetch for the other requests
+		pplx::cancellation_token_source cts;
+		auto slow = fakeFetch("scene4", std::chrono::minutes(5), std::chrono::milliseconds(100));
+		auto canceled = cache->get("scene4", slow, cts.get_token());
+		auto other = cache->get("scene4", slow);
+		cts.cancel();
+		try
+		{
+			canceled.get();
+			set_error("The canceled request succeeded");
+			return false;
+		}
+		catch (const pplx::task_canceled&)
+		{
+		}
+		if (other.get().tokenData.SceneId != "scene4" || _fetches != 7)
+		{
+			set_error("Canceling a request canceled the shared fetch");
+			return false;
+		}
+
+		_logger->log(LogLevel::Info, "TestSceneEndpointCache", "Scene endpoints cached", std::to_string(cache->size()));
+		return true;
+	}
+
+	virtual std::string get_name() override
+	{
+		return "TestSceneEndpointCache";
+	}
+
+private:
+
+	/// Fake API request returning a protocol v1 endpoint whose token expires after the given duration.
+	std::function<pplx::task<Stormancer::SceneEndpoint>()> fakeFetch(std::string sceneId, std::chrono::milliseconds validity, std::chrono::milliseconds delay = std::chrono::milliseconds(0))
+	{
+		using namespace Stormancer;
+
+		return [this, sceneId, validity, delay]() {
+			_fetches++;
+			SceneEndpoint endpoint;
+			endpoint.version = 1;
+			endpoint.tokenData.SceneId = sceneId;
+			endpoint.tokenData.Expiration = std::chrono::duration_cast<std::chrono::milliseconds>((std::chrono::system_clock::now() + validity).time_since_epoch()).count();
+
+			pplx::task_completion_event<SceneEndpoint> tce;
+			TimerThread::getInstance().schedule([tce, endpoint]() {
+				tce.set(endpoint);
+			}, TimerThread::clock_type::now() + delay);
+			return pplx::task<SceneEndpoint>(tce);
+		};
+	}
+
+	std::atomic<int> _fetches;
+	Stormancer::ILogger_ptr _logger = std::make_shared<Stormancer::ConsoleLogger>();
+};
@@ -0,0 +1,219 @@
+#pragma once
+#include "TestCase.h"
+#include "stormancer/stormancer.h"
+#include "stormancer/TCP/TcpTransport.h"
+#include "stormancer/P2P/ConnectionsRepository.h"
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+/// Connects TcpTransport to a local TCP server, and checks that the frames sent by both sides are received in order,
+/// including frames larger than a receive block and frames split across reads. Measures the receive throughput.
+/// Checks that a connection announcing a frame bigger than the maximum frame size is closed.
+class TestTcpTransport : public TestCase
+{
+public:
+
+	virtual void set_up() override
+	{
+	}
+
+	virtual void tear_down() override
+	{
+	}
+
+	virtual bool run() override
+	{
+#if defined(__linux__)
+		using namespace Stormancer;
+
+		int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t addressSize = sizeof(address);
+		if (::bind(listener, (sockaddr*)&address, addressSize) < 0 || ::listen(listener, 1) < 0 || getsockname(listener, (sockaddr*)&address, &addressSize) < 0)
+		{
+			::close(listener);
+			set_error("Can't open the local server socket");
+			return false;
+		}
+
+		auto resolver = std::make_shared<DependencyResolver>();
+		resolver->registerDependency<ILogger>(_logger);
+
+		std::mutex receivedMutex;
+		std::condition_variable receivedChanged;
+		std::vector<int> received;
+		received.reserve(framesCount);
+		bool corrupted = false;
+
+		pplx::cancellation_token_source cts;
+		auto transport = std::make_shared<TcpTransport>(resolver.get());
+		transport->onPacketReceived([&](Packet_ptr packet) {
+			byte id;
+			int index;
+			packet->stream->read(&id, sizeof(id));
+			packet->stream->read((byte*)&index, sizeof(index));
+			std::size_t size = (std::size_t)packet->stream->rdbuf()->in_avail() + sizeof(id) + sizeof(index);
+			std::lock_guard<std::mutex> lg(receivedMutex);
+			corrupted = corrupted || id != (byte)MessageIDTypes::ID_SCENES || size != frameSize(index);
+			received.push_back(index);
+			receivedChanged.notify_all();
+		});
+		transport->start("client", std::make_shared<ConnectionsRepository>(_logger), cts.get_token());
+
+		auto connectTask = transport->connect("127.0.0.1:" + std::to_string(ntohs(address.sin_port)));
+		int server = ::accept(listener, nullptr, nullptr);
+		auto connection = connectTask.get();
+
+		// Server to client: the connection id, then frames of growing sizes, written in large chunks split at arbitrary offsets
+		std::vector<byte> stream;
+		int64 sid = 42;
+		appendFrame(stream, (byte)MessageIDTypes::ID_CONNECTION_RESULT, (const byte*)&sid, sizeof(sid));
+		for (int i = 0; i < framesCount; i++)
+		{
+			std::vector<byte> body(frameSize(i) - 1, (byte)i);
+			std::memcpy(body.data(), &i, sizeof(i));
+			appendFrame(stream, (byte)MessageIDTypes::ID_SCENES, body.data(), body.size());
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		std::size_t offset = 0;
+		while (offset < stream.size())
+		{
+			std::size_t chunk = std::min<std::size_t>(stream.size() - offset, 7919 + offset % 100000);
+			ssize_t written = ::send(server, stream.data() + offset, chunk, MSG_NOSIGNAL);
+			if (written <= 0)
+			{
+				break;
+			}
+			offset += (std::size_t)written;
+		}
+		{
+			std::unique_lock<std::mutex> lock(receivedMutex);
+			receivedChanged.wait_for(lock, std::chrono::seconds(10), [&]() {
+				return received.size() == (std::size_t)framesCount;
+			});
+		}
+		auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		_logger->log(LogLevel::Info, "TestTcpTransport", "Received MB/s", std::to_string(us > 0 ? (int64)stream.size() / us : 0));
+
+		// Client to server
+		for (int i = 0; i < framesCount; i++)
+		{
+			connection->send([i](obytestream* s) {
+				(*s) << (byte)MessageIDTypes::ID_SCENES;
+				s->write((const byte*)&i, sizeof(i));
+			}, 0);
+		}
+		bool sentInOrder = true;
+		for (int i = 0; i < framesCount && sentInOrder; i++)
+		{
+			int32_t length = 0;
+			byte body[5];
+			sentInOrder = ::recv(server, &length, sizeof(length), MSG_WAITALL) == sizeof(length) && length == sizeof(body)
+				&& ::recv(server, body, sizeof(body), MSG_WAITALL) == sizeof(body) && std::memcmp(body + 1, &i, sizeof(i)) == 0;
+		}
+
+		bool remoteClosed = false;
+		connection->onClose([&](std::string) {
+			remoteClosed = true;
+		});
+		::close(server);
+		for (int i = 0; i < 100 && connection->getConnectionState() != ConnectionState::Disconnected; i++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		// A frame bigger than the maximum frame size closes the connection before it is received
+		auto invalidConnectTask = transport->connect("127.0.0.1:" + std::to_string(ntohs(address.sin_port)));
+		server = ::accept(listener, nullptr, nullptr);
+		::close(listener);
+		auto invalidConnection = invalidConnectTask.get();
+		std::mutex invalidMutex;
+		std::string invalidReason;
+		invalidConnection->onClose([&](std::string reason) {
+			std::lock_guard<std::mutex> lg(invalidMutex);
+			invalidReason = reason;
+		});
+		int32_t invalidLength = std::numeric_limits<int32_t>::max();
+		::send(server, &invalidLength, sizeof(invalidLength), MSG_NOSIGNAL);
+		for (int i = 0; i < 100 && invalidConnection->getConnectionState() != ConnectionState::Disconnected; i++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		::close(server);
+
+		bool idReceived = transport->id() == (uint64)sid;
+		cts.cancel();
+		transport.reset();
+
+		std::lock_guard<std::mutex> lg(receivedMutex);
+		if (!idReceived)
+		{
+			set_error("The connection id was not received");
+			return false;
+		}
+		if (received.size() != (std::size_t)framesCount || corrupted)
+		{
+			set_error("Some frames were not received, or were corrupted");
+			return false;
+		}
+		for (int i = 0; i < framesCount; i++)
+		{
+			if (received[i] != i)
+			{
+				set_error("The frames were not received in order");
+				return false;
+			}
+		}
+		if (!sentInOrder)
+		{
+			set_error("The frames sent by the connection were not received by the server");
+			return false;
+		}
+		if (!remoteClosed)
+		{
+			set_error("The remote disconnection was not detected");
+			return false;
+		}
+		std::lock_guard<std::mutex> invalidLock(invalidMutex);
+		if (invalidReason.find("invalid frame") == std::string::npos)
+		{
+			set_error("The connection was not closed on a frame bigger than the maximum frame size");
+			return false;
+		}
+#endif
+		return true;
+	}
+
+	virtual std::string get_name() override
+	{
+		return "TestTcpTransport";
+	}
+
+private:
+
+	static const int framesCount = 20000;
+
+	/// Mostly small frames, and a frame larger than a receive block every 1000 frames.
+	static std::size_t frameSize(int index)
+	{
+		return index % 1000 == 999 ? 200000 : 5 + index % 200;
+	}
+
+	static void appendFrame(std::vector<Stormancer::byte>& stream, Stormancer::byte id, const Stormancer::byte* body, std::size_t size)
+	{
+		int32_t length = (int32_t)(size + 1);
+		stream.insert(stream.end(), (const Stormancer::byte*)&length, (const Stormancer::byte*)&length + sizeof(length));
+		stream.push_back(id);
+		stream.insert(stream.end(), body, body + size);
+	}
+
+	Stormancer::ILogger_ptr _logger = std::make_shared<Stormancer::ConsoleLogger>();
+};
@@ -0,0 +1,266 @@
+#pragma once
+#include <ctime>
+#include <queue>
+#include <random>
+#include "TestCase.h"
+#include "stormancer/stormancer.h"
+#include "stormancer/TimerThread.h"
+
+/// Schedules 10k and 100k timers on TimerThread, and on a timer thread using a std::priority_queue (the previous implementation).
+/// Measures the time to schedule the timers, and the CPU time used to schedule and run them.
+/// Also checks the cancellation of timers and the periodic timers.
+class TestTimerThroughput : public TestCase
+{
+public:
+
+	virtual void set_up() override
+	{
+	}
+
+	virtual void tear_down() override
+	{
+	}
+
+	virtual bool run() override
+	{
+		if (!checkCancel() || !checkPeriodic())
+		{
+			return false;
+		}
+
+		const int timersCounts[] = { 10000, 100000 };
+		for (auto timersCount : timersCounts)
+		{
+			Result wheelTask, wheelInline, priorityQueue;
+			{
+				Stormancer::TimerThread timer;
+				wheelTask = measure(timersCount, [&](std::function<void()> f, clock_type::time_point when) { timer.schedule(f, when); });
+				wheelInline = measure(timersCount, [&](std::function<void()> f, clock_type::time_point when) { timer.schedule(f, when, true); });
+			}
+			{
+				PriorityQueueTimerThread timer;
+				priorityQueue = measure(timersCount, [&](std::function<void()> f, clock_type::time_point when) { timer.schedule(f, when); });
+			}
+
+			if (wheelTask.scheduleNs < 0 || wheelInline.scheduleNs < 0 || priorityQueue.scheduleNs < 0)
+			{
+				set_error("Not all the timers fired");
+				return false;
+			}
+
+			auto timers = std::to_string(timersCount) + " timers";
+			log("timer wheel, tasks, " + timers, wheelTask);
+			log("timer wheel, inline, " + timers, wheelInline);
+			log("priority queue, " + timers, priorityQueue);
+		}
+		return true;
+	}
+
+	virtual std::string get_name() override
+	{
+		return "TestTimerThroughput";
+	}
+
+private:
+
+	using clock_type = Stormancer::TimerThread::clock_type;
+
+	struct Result
+	{
+		/// Average time to schedule a timer, or -1 if not all the timers fired.
+		Stormancer::int64 scheduleNs;
+
+		/// Average CPU time of the process to schedule and run a timer.
+		Stormancer::int64 cpuNs;
+	};
+
+	/// The previous TimerThread implementation.
+	class PriorityQueueTimerThread
+	{
+	public:
+
+		PriorityQueueTimerThread()
+			: _thread([this]() { threadLoop(); })
+		{
+		}
+
+		~PriorityQueueTimerThread()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stopRequested = true;
+			}
+			_cond.notify_one();
+			_thread.join();
+		}
+
+		void schedule(std::function<void()> func, clock_type::time_point when)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			bool notifyThread = (_queue.empty() || _queue.top().scheduledTime > when);
+			_queue.emplace(when, func);
+			if (notifyThread)
+			{
+				_cond.notify_one();
+			}
+		}
+
+	private:
+
+		struct QueueEntry
+		{
+			clock_type::time_point scheduledTime;
+			std::function<void()> function;
+
+			QueueEntry(clock_type::time_point t, std::function<void()> f)
+				: scheduledTime(t)
+				, function(f)
+			{
+			}
+
+			friend bool operator>(const QueueEntry& lhs, const QueueEntry& rhs)
+			{
+				return lhs.scheduledTime > rhs.scheduledTime;
+			}
+		};
+
+		void threadLoop()
+		{
+			while (true)
+			{
+				std::function<void()> function;
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					if (_stopRequested)
+					{
+						return;
+					}
+					if (_queue.empty())
+					{
+						_cond.wait(lock);
+						continue;
+					}
+					auto duration = _queue.top().scheduledTime - clock_type::now();
+					if (duration > std::chrono::milliseconds(1))
+					{
+						_cond.wait_for(lock, duration);
+						continue;
+					}
+					function = _queue.top().function;
+					_queue.pop();
+				}
+				pplx::task<void>(function).then([](pplx::task<void> result)
+				{
+					try
+					{
+						result.get();
+					}
+					catch (std::exception&)
+					{
+					}
+				});
+			}
+		}
+
+		std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> _queue;
+		std::mutex _mutex;
+		std::condition_variable _cond;
+		bool _stopRequested = false;
+		std::thread _thread;
+	};
+
+	/// Schedules the timers to fire between 200ms and 700ms, and waits for them to fire.
+	Result measure(int timersCount, std::function<void(std::function<void()>, clock_type::time_point)> schedule)
+	{
+		std::mt19937 random(timersCount);
+		std::uniform_int_distribution<int> delays(200, 700);
+		std::atomic<int> firedCount(0);
+
+		auto cpuStart = std::clock();
+		auto base = clock_type::now();
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < timersCount; i++)
+		{
+			schedule([&firedCount]() { firedCount++; }, base + std::chrono::milliseconds(delays(random)));
+		}
+		auto duration = std::chrono::steady_clock::now() - start;
+
+		auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+		while (firedCount < timersCount && std::chrono::steady_clock::now() < timeout)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		auto cpuDuration = std::clock() - cpuStart;
+		// Let the tasks of the last timers complete before the counter is released
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		if (firedCount != timersCount)
+		{
+			return Result{ -1, -1 };
+		}
+		auto scheduleNs = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / timersCount;
+		auto cpuNs = (Stormancer::int64)((double)cpuDuration / CLOCKS_PER_SEC * 1e9 / timersCount);
+		return Result{ scheduleNs, cpuNs };
+	}
+
+	void log(const std::string& name, const Result& result)
+	{
+		_logger->log(Stormancer::LogLevel::Info, "TestTimerThroughput", "Schedule ns/timer, " + name, std::to_string(result.scheduleNs));
+		_logger->log(Stormancer::LogLevel::Info, "TestTimerThroughput", "CPU ns/timer, " + name, std::to_string(result.cpuNs));
+	}
+
+	bool checkCancel()
+	{
+		Stormancer::TimerThread timer;
+		std::atomic<int> firedCount(0);
+		std::vector<Stormancer::TimerThread::TimerId> ids;
+		auto when = clock_type::now() + std::chrono::milliseconds(50);
+		for (int i = 0; i < 1000; i++)
+		{
+			ids.push_back(timer.schedule([&firedCount]() { firedCount++; }, when + std::chrono::milliseconds(i), true));
+		}
+		for (std::size_t i = 0; i < ids.size(); i += 2)
+		{
+			timer.cancel(ids[i]);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+
+		if (firedCount != 500 || timer.size() != 0)
+		{
+			set_error("Cancelled timers fired, or timers were not released");
+			return false;
+		}
+		return true;
+	}
+
+	bool checkPeriodic()
+	{
+		Stormancer::TimerThread timer;
+		pplx::cancellation_token_source cts;
+		std::atomic<int> taskRuns(0);
+		std::atomic<int> inlineRuns(0);
+		timer.schedulePeriodic([&taskRuns]() { taskRuns++; }, std::chrono::milliseconds(10), clock_type::now(), cts.get_token());
+		auto inlineId = timer.schedulePeriodic([&inlineRuns]() { inlineRuns++; }, std::chrono::milliseconds(10), clock_type::now(), pplx::cancellation_token::none(), true);
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		cts.cancel();
+		timer.cancel(inlineId);
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		int taskRunsAtCancel = taskRuns;
+		int inlineRunsAtCancel = inlineRuns;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		if (taskRunsAtCancel < 5 || inlineRunsAtCancel < 5)
+		{
+			set_error("Periodic timers did not run");
+			return false;
+		}
+		if (taskRuns != taskRunsAtCancel || inlineRuns != inlineRunsAtCancel || timer.size() != 0)
+		{
+			set_error("Periodic timers ran after being cancelled");
+			return false;
+		}
+		return true;
+	}
+
+	Stormancer::ILogger_ptr _logger = std::make_shared<Stormancer::ConsoleLogger>();
+};
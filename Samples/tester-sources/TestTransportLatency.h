@@ -0,0 +1,134 @@
+#pragma once
+#include <algorithm>
+#include "TestCase.h"
+#include "stormancer/stormancer.h"
+#include "stormancer/RakNet/RakNetTransport.h"
+#include "stormancer/P2P/ConnectionsRepository.h"
+#include "RakPeerInterface.h"
+#include "MessageIdentifiers.h"
+
+/// Measures the delay between a datagram reaching the local RakNet peer and the transport packet handler being called,
+/// with the event-driven receive thread and with the periodic poll.
+/// The medians are only logged: comparing wall-clock latencies would make the test depend on the load of the machine.
+class TestTransportLatency : public TestCase
+{
+public:
+
+	virtual void set_up() override
+	{
+	}
+
+	virtual void tear_down() override
+	{
+	}
+
+	virtual bool run() override
+	{
+		Stormancer::int64 pollMedian = measure_median_latency(Stormancer::TransportReceiveMode::PERIODIC_POLL);
+		Stormancer::int64 eventMedian = measure_median_latency(Stormancer::TransportReceiveMode::EVENT_DRIVEN);
+
+		_logger->log(Stormancer::LogLevel::Info, "TestTransportLatency", "Median receive-to-handler latency (us), PERIODIC_POLL", std::to_string(pollMedian));
+		_logger->log(Stormancer::LogLevel::Info, "TestTransportLatency", "Median receive-to-handler latency (us), EVENT_DRIVEN", std::to_string(eventMedian));
+
+		if (pollMedian < 0 || eventMedian < 0)
+		{
+			set_error("No packet received by the transport");
+			return false;
+		}
+		return true;
+	}
+
+	virtual std::string get_name() override
+	{
+		return "TestTransportLatency";
+	}
+
+private:
+
+	static const int messagesCount = 200;
+
+	Stormancer::int64 measure_median_latency(Stormancer::TransportReceiveMode mode)
+	{
+		using namespace Stormancer;
+
+		auto config = Configuration::create("http://localhost:8081", "test", "test");
+		config->transportReceiveMode = mode;
+		config->logger = _logger;
+
+		auto resolver = std::make_shared<DependencyResolver>();
+		resolver->registerDependency<Configuration>(config);
+		resolver->registerDependency<ILogger>(_logger);
+		resolver->registerDependency<IScheduler>(config->scheduler);
+
+		std::mutex latenciesMutex;
+		std::vector<int64> latencies;
+		latencies.reserve(messagesCount);
+
+		pplx::cancellation_token_source cts;
+		auto transport = std::make_shared<RakNetTransport>(resolver.get());
+		transport->onPacketReceived([&](Packet_ptr packet) {
+			byte id;
+			int64 sentOn;
+			packet->stream->read((char*)&id, sizeof(id));
+			packet->stream->read((char*)&sentOn, sizeof(sentOn));
+			auto now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+			std::lock_guard<std::mutex> lg(latenciesMutex);
+			latencies.push_back(now - sentOn);
+		});
+		transport->start("server", std::make_shared<ConnectionsRepository>(_logger), cts.get_token(), 0, 2);
+
+		auto sender = RakNet::RakPeerInterface::GetInstance();
+		RakNet::SocketDescriptor socketDescriptor;
+		socketDescriptor.socketFamily = AF_INET;
+		DataStructures::List<RakNet::SocketDescriptor> socketDescriptorsList;
+		socketDescriptorsList.Push(socketDescriptor, _FILE_AND_LINE_);
+		sender->Startup(1, socketDescriptorsList, 1);
+		sender->Connect("127.0.0.1", transport->port(), nullptr, 0);
+
+		RakNet::RakNetGUID serverGuid;
+		bool connected = false;
+		for (int i = 0; i < 200 && !connected; i++)
+		{
+			for (auto p = sender->Receive(); p; p = sender->Receive())
+			{
+				if (p->data[0] == ID_CONNECTION_REQUEST_ACCEPTED)
+				{
+					serverGuid = p->guid;
+					connected = true;
+				}
+				sender->DeallocatePacket(p);
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		if (connected)
+		{
+			for (int i = 0; i < messagesCount; i++)
+			{
+				byte data[1 + sizeof(int64)];
+				data[0] = (byte)MessageIDTypes::ID_SCENES;
+				int64 sentOn = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+				std::memcpy(data + 1, &sentOn, sizeof(sentOn));
+				sender->Send((const char*)data, sizeof(data), PacketPriority::IMMEDIATE_PRIORITY, PacketReliability::RELIABLE_ORDERED, 0, serverGuid, false);
+				// Spread the sends over the poll interval so the poll phase does not bias the measure
+				std::this_thread::sleep_for(std::chrono::milliseconds(3));
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+
+		sender->Shutdown(100);
+		RakNet::RakPeerInterface::DestroyInstance(sender);
+		cts.cancel();
+		transport.reset();
+
+		std::lock_guard<std::mutex> lg(latenciesMutex);
+		if (latencies.empty())
+		{
+			return -1;
+		}
+		std::nth_element(latencies.begin(), latencies.begin() + latencies.size() / 2, latencies.end());
+		return latencies[latencies.size() / 2];
+	}
+
+	Stormancer::ILogger_ptr _logger = std::make_shared<Stormancer::ConsoleLogger>();
+};
@@ -325,6 +325,69 @@ namespace Stormancer
 		//});
 	}
 
+	void Tester::test_rpc_server_batch()
+	{
+		_logger->log(LogLevel::Info, "test_rpc_server_batch", "RPC SERVER BATCH");
+
+		auto scene = _sceneMain.lock();
+		if (!scene)
+		{
+			_logger->log(LogLevel::Error, "StormancerWrapper", "scene deleted");
+			return;
+		}
+
+		auto rpcService = scene->dependencyResolver()->resolve<RpcService>();
+		auto batch = rpcService->batch();
+
+		// A call cancelled while it is queued is not sent with the batch
+		auto cancelled = batch.rpc<std::string>("rpc", "stormancer");
+		rpcService->cancelAll("Cancelled before the batch was sent");
+		if (batch.size() != 0)
+		{
+			_logger->log(LogLevel::Error, "test_rpc_server_batch", "RPC SERVER BATCH FAILED", "A cancelled call is still queued");
+			return;
+		}
+
+		// Each call of the batch completes with its own response
+		std::vector<pplx::task<std::string>> tasks;
+		for (int i = 0; i < 3; i++)
+		{
+			tasks.push_back(batch.rpc<std::string>("rpc", "stormancer"));
+		}
+		batch.send();
+
+		pplx::when_all(tasks.begin(), tasks.end())
+			.then([this, cancelled](pplx::task<std::vector<std::string>> t)
+		{
+			try
+			{
+				auto responses = t.get();
+				if (responses.size() != 3 || std::any_of(responses.begin(), responses.end(), [](const std::string& response) { return response != "stormancer"; }))
+				{
+					_logger->log(LogLevel::Error, "test_rpc_server_batch", "RPC SERVER BATCH FAILED", "Bad RPC response");
+					return;
+				}
+
+				try
+				{
+					cancelled.get();
+					_logger->log(LogLevel::Error, "test_rpc_server_batch", "RPC SERVER BATCH FAILED", "The cancelled call completed");
+					return;
+				}
+				catch (const std::exception&)
+				{
+				}
+
+				_logger->log(LogLevel::Debug, "test_rpc_server_batch", "RPC SERVER BATCH OK");
+				execNextTest();
+			}
+			catch (const std::exception& ex)
+			{
+				_logger->log(LogLevel::Error, "test_rpc_server_batch", "RPC SERVER BATCH failed", ex.what());
+			}
+		});
+	}
+
 	void Tester::test_rpc_server_cancel()
 	{
 		_logger->log(LogLevel::Info, "test_rpc_server_cancel", "RPC SERVER CANCEL");
@@ -566,6 +629,7 @@ namespace Stormancer
 		_tests.push_back([this]() { test_connect(); });
 		_tests.push_back([this]() { test_echo(); });
 		_tests.push_back([this]() { test_rpc_server(); });
+		_tests.push_back([this]() { test_rpc_server_batch(); });
 		_tests.push_back([this]() { test_rpc_server_cancel(); });
 		_tests.push_back([this]() { test_rpc_server_exception(); });
 		_tests.push_back([this]() { test_rpc_server_clientException(); });
@@ -48,6 +48,7 @@ namespace Stormancer
 		void test_connect();
 		void test_echo();
 		void test_rpc_server();
+		void test_rpc_server_batch();
 		void test_rpc_server_cancel();
 		void test_rpc_server_exception();
 		void test_rpc_server_clientException();
@@ -4,6 +4,8 @@
 
 #if defined(_WIN32)
 #include "stormancer/Windows/AES/AES_Windows.h"
+#elif defined(__linux__) && !defined(__ANDROID__)
+#include "stormancer/Linux/AES/AES_OpenSSL.h"
 
 
 
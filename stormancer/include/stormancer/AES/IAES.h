@@ -19,6 +19,9 @@ namespace Stormancer
 		
 		virtual uint16 ivSize();
 
+		/// Size of the authentication tag appended to the encrypted data.
+		virtual uint16 tagSize();
+
 		virtual void encrypt(byte* dataPtr, std::streamsize dataSize, byte* ivPtr, std::streamsize ivSize, obytestream* outputStream, uint64 keyId) = 0;
 
 		virtual void decrypt(byte* dataPtr, std::streamsize dataSize, byte* ivPtr, std::streamsize ivSize, obytestream* outputStream, uint64 keyId) = 0;
@@ -27,6 +30,16 @@ namespace Stormancer
 
 		virtual std::streamsize getBlockSize() = 0;
 
+		/// True if encryptInPlace is supported. Otherwise, encrypt must be used.
+		virtual bool canEncryptInPlace();
+
+		/// Encrypt the data in its own buffer and write the authentication tag (tagSize() bytes) at tagPtr.
+		virtual void encryptInPlace(byte* dataPtr, std::streamsize dataSize, byte* ivPtr, std::streamsize ivSize, byte* tagPtr, uint64 keyId);
+
+		/// Decrypt the data (followed by its authentication tag) in its own buffer.
+		/// \return The size of the decrypted data, written at dataPtr.
+		virtual std::streamsize decryptInPlace(byte* dataPtr, std::streamsize dataSize, byte* ivPtr, std::streamsize ivSize, uint64 keyId);
+
 #pragma endregion
 	};
 }
@@ -4,6 +4,7 @@
 #include "stormancer/Configuration.h"
 #include "stormancer/SceneEndpoint.h"
 #include "stormancer/ITokenHandler.h"
+#include "stormancer/SceneEndpointCache.h"
 
 namespace Stormancer
 {
@@ -19,6 +20,11 @@ namespace Stormancer
 		ApiClient(std::shared_ptr<ILogger> logger, std::shared_ptr<Configuration> config, std::shared_ptr<ITokenHandler> tokenHandler);
 		~ApiClient();
 		pplx::task<SceneEndpoint> getSceneEndpoint(std::string accountId, std::string applicationName, std::string sceneId, pplx::cancellation_token ct = pplx::cancellation_token::none());
+		/// Request the endpoints of several scenes concurrently and cache them, so that connecting to these scenes later doesn't wait for the API.
+		/// Does nothing if Configuration::cacheSceneEndpoints is disabled. Failures are logged and don't fail the returned task.
+		pplx::task<void> prefetchSceneEndpoints(std::string accountId, std::string applicationName, std::vector<std::string> sceneIds, pplx::cancellation_token ct = pplx::cancellation_token::none());
+		/// Drop the cached endpoint of a scene, so that the next connection requests a new token.
+		void invalidateSceneEndpoint(std::string accountId, std::string applicationName, std::string sceneId);
 		//Sends a request to the API server, and retries according to the active policy. Parameter is a requestFactory, that provides the targets API endpoint as parameter.
 		pplx::task<web::http::http_response> requestWithRetries(std::function<web::http::http_request(std::string)> requestFactory, pplx::cancellation_token ct = pplx::cancellation_token::none());
 		pplx::task<ServerEndpoints> GetServerEndpoints();
@@ -26,9 +32,17 @@ namespace Stormancer
 	private:
 		
 		std::shared_ptr<ILogger> _logger;
+		pplx::task<SceneEndpoint> fetchSceneEndpoint(std::string accountId, std::string applicationName, std::string sceneId, pplx::cancellation_token ct = pplx::cancellation_token::none());
 		pplx::task<SceneEndpoint> getSceneEndpointImpl(std::vector<std::string>  endpoints, std::shared_ptr<std::vector<std::string>> errors, std::string accountId, std::string applicationName, std::string sceneId, pplx::cancellation_token ct = pplx::cancellation_token::none());
+		/// Request the scene endpoint to a single API endpoint. Fails if the endpoint can't be reached or returns an error.
+		pplx::task<SceneEndpoint> requestSceneEndpoint(std::string baseUri, std::string accountId, std::string applicationName, std::string sceneId, pplx::cancellation_token ct = pplx::cancellation_token::none());
+		/// Http client kept alive between the requests to an API endpoint, so that they reuse its connection.
+		std::shared_ptr<web::http::client::http_client> getHttpClient(const std::string& baseUri);
 		pplx::task<web::http::http_response> requestWithRetriesImpl(std::function<web::http::http_request(std::string)> requestFactory, std::vector<std::string> baseUris, std::shared_ptr<std::vector<std::string>> errors, pplx::cancellation_token ct = pplx::cancellation_token::none());
 		std::shared_ptr<Configuration> _config;
 		std::shared_ptr<ITokenHandler> _tokenHandler;
+		std::shared_ptr<SceneEndpointCache> _sceneEndpoints;
+		std::mutex _httpClientsMutex;
+		std::unordered_map<std::string, std::shared_ptr<web::http::client::http_client>> _httpClients;
 	};
 };
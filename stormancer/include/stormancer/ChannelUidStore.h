@@ -4,6 +4,9 @@
 
 namespace Stormancer
 {
+	/// Assigns the ordering channels of a connection to channel identifiers.
+	/// When all the channels are assigned, the least recently used one is reassigned.
+	/// Looking up an assigned identifier and marking a channel as used don't lock.
 	class ChannelUidStore
 	{
 	public:
@@ -12,8 +15,13 @@ namespace Stormancer
 
 		ChannelUidStore();
 
+		/// Returns the channel assigned to an identifier, and marks it as used.
+		/// Callers sending often on the same identifier should keep the channel, and call touch instead.
 		int getChannelUid(const std::string& channelIdentifier);
 
+		/// Marks a channel as used, so it is not the next to be reassigned.
+		void touch(int channelUid);
+
 #pragma endregion
 
 	private:
@@ -22,17 +30,27 @@ namespace Stormancer
 
 		struct ChannelInfos
 		{
-			std::string channelIdentifier;
-			std::chrono::steady_clock::time_point lastUsed;
+			/// Hash of the channel identifier, or 0 if the channel is not assigned.
+			std::atomic<uint64> identifierHash;
+			/// Value of the use counter when the channel was last used.
+			std::atomic<uint64> lastUsed;
+
+			ChannelInfos()
+				: identifierHash(0)
+				, lastUsed(0)
+			{
+			}
 		};
 
 #pragma endregion
 
 #pragma region private_methods
 
-		int getReservedChannel(const std::string& channelIdentifier);
+		static uint64 hash(const std::string& channelIdentifier);
+
+		int getReservedChannel(uint64 identifierHash) const;
 
-		int getOlderChannel();
+		int getOlderChannel() const;
 
 #pragma endregion
 
@@ -40,6 +58,8 @@ namespace Stormancer
 
 		static const int channelUidsCount = 16;
 		ChannelInfos _channelsInfos[channelUidsCount];
+		std::atomic<uint64> _useCounter;
+		/// Serializes the assignments of the channels.
 		std::mutex _channelsInfosMutex;
 
 #pragma endregion
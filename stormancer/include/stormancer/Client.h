@@ -37,6 +37,10 @@ namespace Stormancer
 
 		pplx::task<Scene_ptr> getPrivateScene(const std::string& sceneToken, pplx::cancellation_token ct = pplx::cancellation_token::none());
 
+		/// Request the connection tokens of several public scenes concurrently, so that getPublicScene doesn't wait for the API when connecting to them.
+		/// The tokens are kept until they expire, only if Configuration::cacheSceneEndpoints is enabled. Failures are logged and don't fail the returned task.
+		pplx::task<void> prefetchPublicScenes(const std::vector<std::string>& sceneIds, pplx::cancellation_token ct = pplx::cancellation_token::none());
+
 		pplx::task<Scene_ptr> connectToPublicScene(const std::string& sceneId, const SceneInitializer& initializer = SceneInitializer(), pplx::cancellation_token ct = pplx::cancellation_token::none());
 
 		pplx::task<Scene_ptr> connectToPrivateScene(const std::string& sceneToken, const SceneInitializer& initializer = SceneInitializer(), pplx::cancellation_token ct = pplx::cancellation_token::none());
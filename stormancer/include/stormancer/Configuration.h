@@ -8,13 +8,25 @@
 #include "stormancer/IActionDispatcher.h"
 #include "stormancer/ITransport.h"
 #include "stormancer/Logger/NullLogger.h"
+#include "stormancer/EndpointRace.h"
 
 namespace Stormancer
 {
 	enum class EndpointSelectionMode
 	{
 		FALLBACK = 0,
-		RANDOM = 1
+		RANDOM = 1,
+		/// Try the endpoints concurrently, fastest known first, and keep the first one answering (see endpointRaceDelay).
+		RACE = 2
+	};
+
+	/// How the transport drains the packets received by the network library.
+	enum class TransportReceiveMode
+	{
+		/// A dedicated thread blocks until a packet arrives and dispatches it immediately.
+		EVENT_DRIVEN = 0,
+		/// The transport is run periodically by the scheduler, every transportPollInterval milliseconds.
+		PERIODIC_POLL = 1
 	};
 
 	class Configuration;
@@ -78,12 +90,37 @@ namespace Stormancer
 		/// Enable or disable the asynchrounous dispatch of received messages. Enabled by default.
 		bool asynchronousDispatch = true;
 
+		/// How received messages are dispatched when asynchronousDispatch is enabled. Defaults to TASK.
+		PacketDispatchMode packetDispatchMode = PacketDispatchMode::TASK;
+
+		/// Number of dispatch threads in WORKER_POOL mode.
+		int dispatchWorkersCount = 4;
+
 		///Size of the threadpool. Defaults to 5. Less than 3 can provoke deadlocks.
 		int threadpoolSize = 10;
 
 		/// The scheduler used by the client to run the transport and other repeated tasks.
 		std::shared_ptr<IScheduler> scheduler;
 
+		/// How received packets are drained by the transport. Defaults to EVENT_DRIVEN.
+		TransportReceiveMode transportReceiveMode = TransportReceiveMode::EVENT_DRIVEN;
+
+		/// Poll interval of the transport in PERIODIC_POLL mode, in milliseconds.
+		/// In EVENT_DRIVEN mode, maximum time the receive thread waits before running the transport anyway.
+		int transportPollInterval = 15;
+
+		/// Maximum size in bytes of the datagrams grouping the small messages sent on a connection, or 0 to send each message in its own datagram.
+		/// Consecutive messages with the same ordering channel, priority and reliability are coalesced until the next run of the transport (see transportPollInterval).
+		/// Messages sent with IMMEDIATE_PRIORITY, or bigger than the half of this size, are sent immediately.
+		/// The server must support the ID_BATCH message. Values above 65535 are clamped. Disabled by default.
+		int sendCoalescingSize = 0;
+
+		/// Maximum size in bytes of the frames received by the TCP transport. The connection is closed when the server announces a bigger frame.
+		int maxFrameSize = 16 * 1024 * 1024;
+
+		/// Path of a file where the transport records the frames it receives and sends (see PacketCapture), or empty to disable the capture.
+		std::string packetCapturePath;
+
 		/// Gets or sets the transport to be used by the client.
 		std::function<std::shared_ptr<ITransport>(DependencyResolver*)> transportFactory;
 
@@ -116,6 +153,17 @@ namespace Stormancer
 
 		EndpointSelectionMode endpointSelectionMode = EndpointSelectionMode::FALLBACK;
 
+		/// In RACE endpoint selection mode, delay in milliseconds before trying the next endpoint while the previous ones didn't answer yet.
+		int endpointRaceDelay = 250;
+
+		/// Latencies of the API and transport endpoints, measured in RACE endpoint selection mode.
+		/// Share it between configurations to keep preferring the fastest endpoints across clients.
+		std::shared_ptr<EndpointLatencies> endpointLatencies = std::make_shared<EndpointLatencies>();
+
+		/// Keep the scene endpoints returned by the API until their connection token expires, instead of requesting a new token for each connection.
+		/// The token expiration (ConnectionData::Expiration) is read as milliseconds since the Unix epoch. Disabled by default.
+		bool cacheSceneEndpoints = false;
+
 		ILogger_ptr logger = std::make_shared<NullLogger>();
 
 		std::string endpointRootCertificate;
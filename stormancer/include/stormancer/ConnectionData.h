@@ -14,6 +14,7 @@ namespace Stormancer
 		std::string ContentType;
 		std::string DeploymentId;
 		std::map<std::string, std::string> Endpoints;
+		/// Expiration of the token, in milliseconds since the Unix epoch.
 		int64 Expiration;
 		int64 Issued;
 		std::string Routing;
@@ -4,26 +4,76 @@
 #include "stormancer/IPacketDispatcher.h"
 #include "stormancer/IPacketProcessor.h"
 #include "stormancer/Logger/ILogger.h"
+#include "stormancer/PacketPool.h"
 
 namespace Stormancer
 {
+	/// How the packets are dispatched when the dispatch is asynchronous.
+	enum class PacketDispatchMode
+	{
+		/// Each packet is dispatched by a pplx task. Packets of a connection may be dispatched out of order.
+		TASK = 0,
+		/// Packets are dispatched by a fixed set of worker threads. The packets of a connection are always dispatched by the same worker, in order.
+		WORKER_POOL = 1
+	};
+
 	/// Dispatch the packets to the handlers based on their id.
+	/// The processors must be added before the first packet is dispatched: the handlers table is then frozen.
 	class DefaultPacketDispatcher : public IPacketDispatcher
 	{
 	public:
-		DefaultPacketDispatcher(ILogger_ptr logger, bool asyncDispatch = true);
+		DefaultPacketDispatcher(ILogger_ptr logger, bool asyncDispatch = true, PacketDispatchMode mode = PacketDispatchMode::TASK, int workersCount = 4);
 		virtual ~DefaultPacketDispatcher();
 
 		void dispatchPacket(Packet_ptr packet);
 		void addProcessor(std::shared_ptr<IPacketProcessor> processor);
 
+		/// Number of packets waiting or being dispatched, for each worker. Empty if the mode is not WORKER_POOL.
+		std::vector<std::size_t> queueDepths() const;
+
 	private:
-		void dispatchImpl(Packet_ptr packet);
+
+		/// Handlers of the dispatcher. Shared with the workers and the dispatch tasks, so that a handler can destroy the dispatcher.
+		struct HandlersState
+		{
+			HandlersTable handlers;
+			std::vector<processorFunction*> defaultProcessors;
+			ILogger_ptr logger;
+			/// Packets of the messages of the ID_BATCH frames.
+			std::shared_ptr<PacketPool<>> batchPacketPool = std::make_shared<PacketPool<>>();
+
+			HandlersState(ILogger_ptr logger);
+			~HandlersState();
+
+			void dispatch(Packet_ptr packet);
+			void dispatchBatch(Packet_ptr packet);
+		};
+
+		/// Dispatch worker thread, with the packets it has to dispatch.
+		struct Worker
+		{
+			std::thread thread;
+			std::mutex mutex;
+			std::condition_variable condition;
+			std::vector<Packet_ptr> pending;
+			std::atomic<std::size_t> depth;
+			std::atomic<bool> stopping;
+
+			Worker()
+				: depth(0)
+				, stopping(false)
+			{
+			}
+		};
+
+		static void runWorker(std::shared_ptr<HandlersState> state, std::shared_ptr<Worker> worker);
+		void stopWorkers();
 
 	private:
-		std::map<byte, handlerFunction*> _handlers;
-		std::vector<processorFunction*> _defaultProcessors;
+		std::shared_ptr<HandlersState> _state;
+		std::atomic<bool> _frozen;
 		bool _asyncDispatch = true;
-		ILogger_ptr _logger;
+		PacketDispatchMode _mode = PacketDispatchMode::TASK;
+		std::vector<std::shared_ptr<Worker>> _workers;
 	};
 };
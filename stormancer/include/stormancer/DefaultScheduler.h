@@ -22,8 +22,6 @@ namespace Stormancer
 		STORMANCER_DLL_API void schedule(clock_type::time_point when, std::function<void()> work) override;
 
 	private:
-		
-		static void periodicFunc(std::function<void()> work, pplx::cancellation_token ct, std::weak_ptr<TimerThread> weakTimer, std::chrono::milliseconds delay);
 
 		std::shared_ptr<TimerThread> _timer = std::make_shared<TimerThread>();
 	};
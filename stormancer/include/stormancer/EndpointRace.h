@@ -0,0 +1,248 @@
+#pragma once
+
+#include "stormancer/headers.h"
+#include "stormancer/TimerThread.h"
+
+namespace Stormancer
+{
+	/// Remembers how fast each endpoint answered, so that the next connections try the fastest endpoints first.
+	class STORMANCER_DLL_API EndpointLatencies
+	{
+	public:
+
+#pragma region public_methods
+
+		/// Record a successful attempt. The latency is smoothed over the successive attempts.
+		void recordSuccess(const std::string& endpoint, std::chrono::milliseconds latency);
+
+		/// Record a failed attempt. The endpoint is tried last until it succeeds again.
+		void recordFailure(const std::string& endpoint);
+
+		/// Smoothed latency of an endpoint, or -1 if it never succeeded or failed last.
+		int64 latency(const std::string& endpoint) const;
+
+		/// Order endpoints from the fastest to the slowest.
+		/// The endpoints without measure keep their relative order, after the measured ones and before the failed ones.
+		std::vector<std::string> sort(std::vector<std::string> endpoints) const;
+
+#pragma endregion
+
+	private:
+
+#pragma region private_classes
+
+		struct Entry
+		{
+			int64 latency = -1;
+			bool failed = false;
+		};
+
+#pragma endregion
+
+#pragma region private_members
+
+		mutable std::mutex _mutex;
+		std::unordered_map<std::string, Entry> _entries;
+
+#pragma endregion
+	};
+
+	namespace details
+	{
+		template<typename T>
+		struct EndpointRace : public std::enable_shared_from_this<EndpointRace<T>>
+		{
+			std::vector<std::string> endpoints;
+			std::function<pplx::task<T>(const std::string&, pplx::cancellation_token)> attempt;
+			std::function<void(T)> discard;
+			std::chrono::milliseconds delay;
+			std::shared_ptr<EndpointLatencies> latencies;
+			pplx::cancellation_token_source cts;
+			pplx::task_completion_event<T> tce;
+			std::mutex mutex;
+			std::size_t started = 0;
+			std::size_t failed = 0;
+			bool done = false;
+			std::string errors;
+			/// Timer starting the next attempt, canceled when the race is over.
+			TimerThread::TimerId nextTimer = 0;
+			bool nextScheduled = false;
+
+			/// Start the attempt to the next endpoint, and schedule the one after it.
+			void startNext()
+			{
+				std::string endpoint;
+				bool hasNext;
+				{
+					std::lock_guard<std::mutex> lg(mutex);
+					// Once canceled by the caller, the remaining endpoints are not tried
+					if (done || started == endpoints.size() || cts.get_token().is_canceled())
+					{
+						return;
+					}
+					endpoint = endpoints[started++];
+					hasNext = started < endpoints.size();
+				}
+
+				auto self = this->shared_from_this();
+				auto start = std::chrono::steady_clock::now();
+				pplx::task<T> task;
+				try
+				{
+					task = attempt(endpoint, cts.get_token());
+				}
+				catch (...)
+				{
+					task = pplx::task_from_exception<T>(std::current_exception());
+				}
+
+				task.then([self, endpoint, start](pplx::task<T> t)
+				{
+					try
+					{
+						auto result = t.get();
+						auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+						if (self->latencies)
+						{
+							self->latencies->recordSuccess(endpoint, latency);
+						}
+
+						bool won;
+						{
+							std::lock_guard<std::mutex> lg(self->mutex);
+							won = !self->done;
+							self->done = true;
+						}
+						if (won)
+						{
+							self->cancelNext();
+							self->tce.set(result);
+							self->cts.cancel();
+						}
+						else if (self->discard)
+						{
+							self->discard(result);
+						}
+					}
+					catch (const pplx::task_canceled&)
+					{
+						self->onFailure(endpoint, "canceled", true);
+					}
+					catch (const std::exception& ex)
+					{
+						self->onFailure(endpoint, ex.what(), false);
+					}
+				});
+
+				if (hasNext)
+				{
+					// Happy eyeballs: don't wait for a slow endpoint longer than the delay before trying the next one
+					auto timer = TimerThread::getInstance().schedule([self]() {
+						self->startNext();
+					}, TimerThread::clock_type::now() + delay);
+
+					bool over;
+					{
+						std::lock_guard<std::mutex> lg(mutex);
+						over = done;
+						if (!over)
+						{
+							nextTimer = timer;
+							nextScheduled = true;
+						}
+					}
+					if (over)
+					{
+						TimerThread::getInstance().cancel(timer);
+					}
+				}
+			}
+
+			/// Don't keep the race alive until the next attempt timer fires once it is over.
+			void cancelNext()
+			{
+				TimerThread::TimerId timer;
+				{
+					std::lock_guard<std::mutex> lg(mutex);
+					if (!nextScheduled)
+					{
+						return;
+					}
+					timer = nextTimer;
+					nextScheduled = false;
+				}
+				TimerThread::getInstance().cancel(timer);
+			}
+
+			void onFailure(const std::string& endpoint, const std::string& error, bool canceled)
+			{
+				bool last;
+				bool abandoned;
+				{
+					std::lock_guard<std::mutex> lg(mutex);
+					if (!canceled || !done)
+					{
+						errors += "[" + endpoint + ": " + error + "]";
+					}
+					failed++;
+					// Canceled by the caller: the race is over, whatever the number of endpoints left
+					abandoned = !done && cts.get_token().is_canceled();
+					last = !done && failed == endpoints.size();
+					if (last || abandoned)
+					{
+						done = true;
+					}
+				}
+
+				if (!canceled && latencies)
+				{
+					latencies->recordFailure(endpoint);
+				}
+
+				if (abandoned)
+				{
+					cancelNext();
+					tce.set_exception(pplx::task_canceled());
+				}
+				else if (last)
+				{
+					tce.set_exception(std::runtime_error("All the endpoints failed: " + errors));
+				}
+				else
+				{
+					startNext();
+				}
+			}
+		};
+	}
+
+	/// Try several endpoints, starting the attempt to the next endpoint when the previous attempt fails or after a delay.
+	/// \param endpoints The endpoints, in the order they should be tried.
+	/// \param attempt Starts an attempt to an endpoint. The attempt should stop when its cancellation token is canceled.
+	/// \param delay Delay before trying the next endpoint while the previous attempts are still running.
+	/// \param latencies Records the latency of each endpoint. Can be null.
+	/// \param ct Cancels all the attempts.
+	/// \param discard Called with the results of the attempts succeeding after the first one. Can be null.
+	/// \returns The result of the first successful attempt. The other attempts are canceled.
+	template<typename T>
+	pplx::task<T> raceEndpoints(std::vector<std::string> endpoints, std::function<pplx::task<T>(const std::string&, pplx::cancellation_token)> attempt, std::chrono::milliseconds delay, std::shared_ptr<EndpointLatencies> latencies, pplx::cancellation_token ct = pplx::cancellation_token::none(), std::function<void(T)> discard = nullptr)
+	{
+		if (endpoints.empty())
+		{
+			return pplx::task_from_exception<T>(std::invalid_argument("No endpoint to connect to"));
+		}
+
+		auto race = std::make_shared<details::EndpointRace<T>>();
+		race->endpoints = endpoints;
+		race->attempt = attempt;
+		race->discard = discard;
+		race->delay = delay;
+		race->latencies = latencies;
+		if (ct.is_cancelable())
+		{
+			race->cts = pplx::cancellation_token_source::create_linked_source(ct);
+		}
+		race->startNext();
+		return pplx::task<T>(race->tce, ct);
+	}
+}
@@ -361,7 +361,7 @@ namespace Stormancer
 
 		TimerThread::getInstance().schedule([cts]() {
 			cts.cancel();
-		}, TimerThread::clock_type::now() + duration);
+		}, TimerThread::clock_type::now() + duration, true);
 
 		return cts.get_token();
 	}
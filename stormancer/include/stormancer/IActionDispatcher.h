@@ -50,12 +50,14 @@ namespace Stormancer
 #pragma endregion
 	};
 
+	//Posting is lock-free: network threads push the actions on an atomic list, which update() takes in one step.
 	class MainThreadActionDispatcher :public IActionDispatcher
 	{
 	public:
 
 #pragma region public_methods
 
+		virtual ~MainThreadActionDispatcher();
 		virtual void post(const std::function<void(void)>& action) override;
 		virtual void start() override;
 		virtual pplx::task<void> stop() override;
@@ -75,11 +77,37 @@ namespace Stormancer
 
 #pragma endregion
 
+#pragma region private_classes
+
+		struct ActionNode
+		{
+			std::function<void(void)> action;
+			ActionNode* next;
+		};
+
+#pragma endregion
+
+#pragma region private_methods
+
+		//Moves all the posted actions at the end of the pending actions, in posting order. Only called by the updating thread.
+		void takePostedActions();
+
+		//Marker set as the posted list when the dispatcher stopped, rejecting the posted actions.
+		static ActionNode* closedList();
+
+		static void deleteNodes(ActionNode* node);
+
+#pragma endregion
+
 #pragma region private_members
 
-		bool _isRunning;
-		bool _stopRequested;
-		std::queue<std::function<void(void)>> _actions;
+		std::atomic<bool> _isRunning{ false };
+		std::atomic<bool> _stopRequested{ false };
+		//Actions posted since the last update, most recent first, or closedList() when stopped.
+		std::atomic<ActionNode*> _posted{ nullptr };
+		//Actions taken by update and not run yet, oldest first. Only accessed by the updating thread.
+		ActionNode* _pendingHead = nullptr;
+		ActionNode* _pendingTail = nullptr;
 		std::mutex _mutex;
 		pplx::task_completion_event<void> _stopTce;
 
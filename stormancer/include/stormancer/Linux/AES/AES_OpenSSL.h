@@ -0,0 +1,87 @@
+#pragma once
+
+#include <openssl/evp.h>
+#include "stormancer/headers.h"
+#include "stormancer/AES/IAES.h"
+
+namespace Stormancer
+{
+	class KeyStore;
+
+	/// AES-256-GCM implementation using the OpenSSL EVP interface (AES-NI accelerated when available).
+	/// Encrypted data is the cipher text followed by a tag of tagSize() bytes.
+	class AESOpenSSL : public IAES
+	{
+	public:
+
+#pragma region public_methods
+
+		AESOpenSSL(std::shared_ptr<KeyStore> keyStore);
+
+		~AESOpenSSL();
+
+		void encrypt(byte* dataPtr, std::streamsize dataSize, byte* ivPtr, std::streamsize ivSize, obytestream* outputStream, uint64 keyId) override;
+
+		void decrypt(byte* dataPtr, std::streamsize dataSize, byte* ivPtr, std::streamsize ivSize, obytestream* outputStream, uint64 keyId) override;
+
+		void generateRandomIV(byte* ivPtr) override;
+
+		virtual std::streamsize getBlockSize() override;
+
+		bool canEncryptInPlace() override;
+
+		void encryptInPlace(byte* dataPtr, std::streamsize dataSize, byte* ivPtr, std::streamsize ivSize, byte* tagPtr, uint64 keyId) override;
+
+		std::streamsize decryptInPlace(byte* dataPtr, std::streamsize dataSize, byte* ivPtr, std::streamsize ivSize, uint64 keyId) override;
+
+#pragma endregion
+
+	private:
+
+#pragma region private_classes
+
+		/// Cipher contexts of one direction, by key id.
+		struct ContextCache
+		{
+			std::unordered_map<uint64, EVP_CIPHER_CTX*> contexts;
+			/// Key the contexts were initialized with. They are released when the key store key is replaced.
+			byte key[256 / 8] = {};
+		};
+
+#pragma endregion
+
+#pragma region private_methods
+
+		/// Get the cipher context of a key, initialized with the key on first use.
+		/// The contexts are released when the key is replaced, or when the cache is full.
+		EVP_CIPHER_CTX* getContext(ContextCache& cache, uint64 keyId, bool encrypt);
+
+		static void clearContexts(ContextCache& cache);
+
+		/// Get the encryption context of a key, ready to encrypt a packet with the IV. _encryptMutex must be locked.
+		EVP_CIPHER_CTX* beginEncrypt(byte* ivPtr, std::streamsize ivSize, uint64 keyId);
+
+		/// Get the decryption context of a key, ready to decrypt a packet with the IV. _decryptMutex must be locked.
+		EVP_CIPHER_CTX* beginDecrypt(byte* ivPtr, std::streamsize ivSize, uint64 keyId);
+
+		void endEncrypt(EVP_CIPHER_CTX* ctx, byte* tagPtr);
+
+		void endDecrypt(EVP_CIPHER_CTX* ctx, byte* tagPtr);
+
+		void cleanAES();
+
+#pragma endregion
+
+#pragma region private_members
+
+		std::shared_ptr<KeyStore> _key;
+
+		ContextCache _encryptContexts;
+		ContextCache _decryptContexts;
+
+		std::mutex _encryptMutex;
+		std::mutex _decryptMutex;
+
+#pragma endregion
+	};
+}
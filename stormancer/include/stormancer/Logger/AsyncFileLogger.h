@@ -0,0 +1,140 @@
+#pragma once
+
+#include "stormancer/headers.h"
+#include "stormancer/Logger/ILogger.h"
+
+namespace Stormancer
+{
+	/// Logger writing in a file from a background thread.
+	/// log() only copies the record in a preallocated slot of a lock-free ring buffer: it never formats, writes or locks.
+	/// The background thread formats the records and writes them in batches, flushing the file once per batch.
+	/// When the file exceeds maxFileSize, it is renamed with the suffix .1 (the previous .1 becoming .2, and so on) and a new file is started.
+	class AsyncFileLogger : public ILogger
+	{
+	public:
+
+		/// What log() does when the ring buffer is full.
+		enum class OverflowPolicy
+		{
+			/// The record is dropped and counted. The number of dropped records is written in the file.
+			Drop = 0,
+			/// log() waits for a free slot. The callers can be stalled by the disk.
+			Wait = 1
+		};
+
+#pragma region public_methods
+
+		/// Constructor.
+		/// \param filepath Path of the log file. By default, stormancer_<date>.log.
+		/// \param capacity Number of slots of the ring buffer, rounded up to a power of 2.
+		/// \param policy What log() does when the ring buffer is full.
+		/// \param maxFileSize Size in bytes above which the file is rotated, or 0 to never rotate it.
+		/// \param maxFiles Number of rotated files kept, in addition to the current file.
+		STORMANCER_DLL_API AsyncFileLogger(const char* filepath = "", std::size_t capacity = 8192, OverflowPolicy policy = OverflowPolicy::Drop, uint64 maxFileSize = 0, int maxFiles = 5);
+
+		/// Writes the pending records and stops the background thread.
+		STORMANCER_DLL_API virtual ~AsyncFileLogger();
+
+		AsyncFileLogger(const AsyncFileLogger&) = delete;
+
+		AsyncFileLogger& operator=(const AsyncFileLogger&) = delete;
+
+		/// A basic message log.
+		/// \message The message to log.
+		void log(const std::string& message) override;
+
+		/// A detailed message log.
+		/// \param level The level.
+		/// \param category The category (typically the source).
+		/// \param message The message.
+		/// \param data Some extra data.
+		void log(LogLevel level, const std::string& category, const std::string& message, const std::string& data) override;
+
+		/// Log details about an exception.
+		/// \param e The exception.
+		void log(const std::exception& ex) override;
+
+		/// Number of records dropped because the ring buffer was full.
+		STORMANCER_DLL_API uint64 droppedCount() const;
+
+		/// Wait until the records logged before the call are written to the file.
+		STORMANCER_DLL_API void flush();
+
+#pragma endregion
+
+	private:
+
+#pragma region private_classes
+
+		struct Record
+		{
+			/// false for the messages logged without level, written as is.
+			bool detailed = false;
+			LogLevel level = LogLevel::Info;
+			std::time_t time = 0;
+			std::string category;
+			std::string message;
+			std::string data;
+		};
+
+		/// A slot of the ring buffer. The sequence tells whether the slot is free or holds a record for the writer (Vyukov's bounded queue).
+		struct Slot
+		{
+			std::atomic<std::size_t> sequence;
+			Record record;
+		};
+
+#pragma endregion
+
+#pragma region private_methods
+
+		/// Claim a slot, fill it and publish it.
+		template<typename TFill>
+		void enqueue(TFill fill);
+
+		bool dequeue(Record& record);
+
+		void writerLoop();
+
+		void append(std::string& buffer, const Record& record);
+
+		void write(const std::string& buffer);
+
+		void rotate();
+
+		bool tryOpenFile();
+
+#pragma endregion
+
+#pragma region private_members
+
+		std::string _fileName;
+		std::ofstream _file;
+		uint64 _fileSize = 0;
+		uint64 _maxFileSize;
+		int _maxFiles;
+		OverflowPolicy _policy;
+
+		std::unique_ptr<Slot[]> _slots;
+		std::size_t _mask;
+		std::atomic<std::size_t> _enqueuePos;
+		std::size_t _dequeuePos = 0;
+		std::atomic<uint64> _droppedCount;
+		uint64 _reportedDroppedCount = 0;
+
+		/// Number of records written, compared by flush to the number of enqueued records.
+		std::atomic<std::size_t> _writtenCount;
+		std::atomic<bool> _writerSleeping;
+		std::atomic<bool> _stopRequested;
+		std::mutex _mutex;
+		std::condition_variable _wakeUp;
+		std::condition_variable _written;
+		std::thread _writer;
+
+		/// Timestamp of the last written record, formatted once per second.
+		std::time_t _lastTime = -1;
+		std::string _lastTimeStr;
+
+#pragma endregion
+	};
+};
@@ -20,6 +20,7 @@ namespace Stormancer
 		void log(const std::string& message) override;
 		void log(LogLevel level, const std::string& category, const std::string& message, const std::string& data = "") override;
 		void log(const std::exception& e) override;
+		bool isEnabled(LogLevel level, const char* category) override;
 
 #pragma endregion
 
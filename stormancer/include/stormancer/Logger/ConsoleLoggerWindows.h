@@ -18,6 +18,7 @@ namespace Stormancer
 		void log(const std::string& message) override;
 		void log(LogLevel level, const std::string& category, const std::string& message, const std::string& data = "") override;
 		void log(const std::exception& ex) override;
+		bool isEnabled(LogLevel level, const char* category) override;
 
 		void setConsoleColor(WORD color);
 		void resetColor();
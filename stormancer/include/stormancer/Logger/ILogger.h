@@ -2,6 +2,32 @@
 
 #include "stormancer/headers.h"
 
+/// Most verbose log level compiled by STORMANCER_LOG (0: Fatal ... 5: Trace).
+/// Defaults to Info in release builds, which strips the Debug and Trace calls.
+#ifndef STORMANCER_LOG_LEVEL
+#if defined(NDEBUG)
+#define STORMANCER_LOG_LEVEL 3
+#else
+#define STORMANCER_LOG_LEVEL 5
+#endif
+#endif
+
+/// Logs a full message, evaluating the message and data arguments only if the level is compiled and enabled by the logger.
+/// The logger expression is evaluated once, and only if the level is compiled.
+/// STORMANCER_LOG(logger, level, category, message[, data])
+#define STORMANCER_LOG(logger, level, category, ...) \
+	do \
+	{ \
+		if ((int)(level) <= STORMANCER_LOG_LEVEL) \
+		{ \
+			auto&& _strmLogger = (logger); \
+			if (_strmLogger->isEnabled((level), (category))) \
+			{ \
+				_strmLogger->log((level), (category), __VA_ARGS__); \
+			} \
+		} \
+	} while (false)
+
 namespace Stormancer
 {
 	/// Available log levels.
@@ -40,6 +66,10 @@ namespace Stormancer
 		/// Logs an exception
 		virtual void log(const std::exception& e) = 0;
 
+		/// Returns false if the messages of this level and category are discarded, so the caller can skip building them.
+		/// Called by STORMANCER_LOG for every message: must be cheap.
+		virtual bool isEnabled(LogLevel level, const char* category);
+
 		/// A basic format of the log message.
 		/// \param level The log level.
 		/// \param category The category of the log (the source).
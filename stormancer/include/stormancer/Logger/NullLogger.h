@@ -26,5 +26,7 @@ namespace Stormancer
 		
 		/// Empty implementation.
 		void log(const std::exception& ex);
+
+		bool isEnabled(LogLevel level, const char* category) override;
 	};
 };
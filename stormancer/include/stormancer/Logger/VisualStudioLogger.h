@@ -14,6 +14,7 @@ namespace Stormancer
 		virtual void log(const std::string& message) override;
 		virtual void log(Stormancer::LogLevel level, const std::string& category, const std::string& message, const std::string& data = "") override;
 		virtual void log(const std::exception& e) override;
+		virtual bool isEnabled(Stormancer::LogLevel level, const char* category) override;
 
 	private:
 		std::mutex _mutex;
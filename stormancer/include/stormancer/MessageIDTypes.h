@@ -18,6 +18,9 @@ namespace Stormancer
 
 		ID_ENCRYPTED = 135,
 
+		/// Several messages coalesced in one datagram by the sender (see Configuration::sendCoalescingSize)
+		ID_BATCH = 136,
+
 		/// Reponse to a system request
 		ID_REQUEST_RESPONSE_MSG = 137,
 
@@ -3,14 +3,20 @@
 #include "RakPeerInterface.h"
 #include "stormancer/headers.h"
 #include "stormancer/RequestProcessor.h"
+#include "stormancer/IConnection.h"
 
 namespace Stormancer
 {
 	class P2PTunnelClient;
+	class P2PTunnelReactor;
 
+	/// Receives the datagrams of a tunnel socket read by its own polling thread.
+	/// The receive structs are recycled once the datagram is forwarded.
 	class P2PTunnelRNS2EventHandler : public RakNet::RNS2EventHandler
 	{
 	public:
+		~P2PTunnelRNS2EventHandler();
+
 		// Inherited via RNS2EventHandler
 		virtual void OnRNS2Recv(RakNet::RNS2RecvStruct * recvStruct) override;
 		virtual void DeallocRNS2RecvStruct(RakNet::RNS2RecvStruct * s, const char * file, unsigned int line) override;
@@ -18,6 +24,10 @@ namespace Stormancer
 
 	public:
 		P2PTunnelClient * innerClient = nullptr;
+
+	private:
+		std::vector<RakNet::RNS2RecvStruct*> _freeStructs;
+		std::mutex _freeStructsMutex;
 	};
 
 	class P2PTunnelClient
@@ -28,11 +38,24 @@ namespace Stormancer
 
 #pragma region public_methods
 		
+		/// Constructor.
+		/// \param reactor Reactor receiving the datagrams of the socket. If null, the socket gets its own polling thread.
 		P2PTunnelClient(std::function<void(P2PTunnelClient*, RakNet::RNS2RecvStruct*)> onMsgRecv,
 			std::shared_ptr<RequestProcessor> sysCall,
-			ILogger_ptr logger);
+			ILogger_ptr logger,
+			std::shared_ptr<P2PTunnelReactor> reactor = nullptr);
 		~P2PTunnelClient();
 
+		/// Local port of the tunnel socket.
+		unsigned short boundPort() const;
+
+		/// Set the local port of the game host, and resolve its loopback address once for all the forwarded datagrams.
+		void setHostPort(unsigned short port);
+
+		/// Send a datagram to the game host, directly from the given buffer.
+		/// The datagram is dropped if the host port is not known yet.
+		void sendToHost(const byte* data, std::size_t size);
+
 #pragma endregion
 
 #pragma region public_members
@@ -45,6 +68,11 @@ namespace Stormancer
 		bool serverSide;
 		unsigned short hostPort;
 
+		/// Connection to the remote peer, cached by the tunnel. Only used by the receive thread of the socket.
+		std::weak_ptr<IConnection> connection;
+		/// Channel of the tunnel on the cached connection, or -1 if not resolved yet.
+		int channelUid = -1;
+
 #pragma endregion
 
 	private:
@@ -61,6 +89,11 @@ namespace Stormancer
 		std::shared_ptr<RequestProcessor> _sysCall;
 		ILogger_ptr _logger;
 		P2PTunnelRNS2EventHandler* _handler;
+		std::shared_ptr<P2PTunnelReactor> _reactor;
+		unsigned short _boundPort = 0;
+		RakNet::SystemAddress _hostAddress;
+		/// Set once _hostAddress is resolved, so it can be read from the transport thread.
+		std::atomic<bool> _hostResolved;
 
 #pragma endregion
 	};
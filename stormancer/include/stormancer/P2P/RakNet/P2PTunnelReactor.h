@@ -0,0 +1,76 @@
+#pragma once
+
+#include "RakNetSocket2.h"
+#include "stormancer/headers.h"
+#include "stormancer/Logger/ILogger.h"
+
+#if defined(__linux__)
+
+namespace Stormancer
+{
+	class EpollReactor;
+
+	/// Receives the datagrams of all the tunnel sockets on a single thread, with epoll.
+	/// The datagrams are read in batches with recvmmsg, in receive structs reused for every batch.
+	class P2PTunnelReactor
+	{
+	public:
+
+		/// Called on the reactor thread for each received datagram. The struct is reused once the call returns.
+		using Handler = std::function<void(RakNet::RNS2RecvStruct*)>;
+
+#pragma region public_methods
+
+		P2PTunnelReactor(ILogger_ptr logger);
+
+		/// Stops the reactor. Can be called by a handler: no handler is called once it returns.
+		~P2PTunnelReactor();
+
+		/// Starts receiving the datagrams of a non-blocking socket.
+		void add(RakNet::RNS2Socket socket, Handler handler);
+
+		/// Stops receiving the datagrams of a socket. The handler won't be called anymore when the call returns.
+		/// When called by the handler of the socket, the remaining datagrams of the batch are dropped; otherwise the handler is not running anymore.
+		void remove(RakNet::RNS2Socket socket);
+
+#pragma endregion
+
+	private:
+
+#pragma region private_classes
+
+		struct ReceiveBatch;
+
+		/// Handler of a socket, shared with the reactor thread which can still be calling it when the socket is removed.
+		struct Registration
+		{
+			Handler handler;
+			/// Set on the reactor thread when the socket is removed or the reactor destroyed: the batch being dispatched is dropped.
+			bool removed = false;
+		};
+
+#pragma endregion
+
+#pragma region private_methods
+
+		void removeOnReactorThread(RakNet::RNS2Socket socket);
+
+		/// Doesn't use the P2PTunnelReactor, which can be destroyed by the handler.
+		static void receive(RakNet::RNS2Socket socket, Registration& registration, ReceiveBatch& batch, const ILogger_ptr& logger);
+
+#pragma endregion
+
+#pragma region private_members
+
+		ILogger_ptr _logger;
+		std::shared_ptr<EpollReactor> _reactor;
+		/// Only used on the reactor thread. Shared with the socket handlers, which keep it alive while they run.
+		std::shared_ptr<ReceiveBatch> _batch;
+		std::mutex _registrationsMutex;
+		std::unordered_map<RakNet::RNS2Socket, std::shared_ptr<Registration>> _registrations;
+
+#pragma endregion
+	};
+}
+
+#endif
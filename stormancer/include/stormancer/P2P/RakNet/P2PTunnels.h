@@ -19,6 +19,7 @@ namespace Stormancer
 	using peerHandle = std::tuple<uint64, byte>;
 
 	class P2PTunnelClient;
+	class P2PTunnelReactor;
 
 	struct PeerHandle_hash : public std::unary_function<peerHandle, std::size_t>
 	{
@@ -50,6 +51,13 @@ namespace Stormancer
 
 	private:
 
+#pragma region private_methods
+
+		/// Reactor shared by the sockets of all the tunnels, started with the first tunnel. Null if the platform has none.
+		std::shared_ptr<P2PTunnelReactor> reactor();
+
+#pragma endregion
+
 #pragma region private_members
 
 		std::shared_ptr<RequestProcessor> _sysClient;
@@ -60,6 +68,8 @@ namespace Stormancer
 		std::unordered_map<std::string, ServerDescriptor> _servers;
 		//Tunnel targeting the key [remotePeerId,handle]
 		std::unordered_map < peerHandle, std::shared_ptr<P2PTunnelClient>,  PeerHandle_hash, PeerHandle_equal> _tunnels;
+		std::shared_ptr<P2PTunnelReactor> _reactor;
+		std::mutex _reactorMutex;
 
 #pragma endregion
 	};
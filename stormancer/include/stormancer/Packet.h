@@ -9,6 +9,8 @@
 
 namespace Stormancer
 {
+	class Route;
+
 	/// Expose a stream for reading data received from the network.
 	template<typename T = IConnection>
 	class Packet
@@ -65,6 +67,26 @@ namespace Stormancer
 			serializer.deserialize(stream, args...);
 		}
 
+		/// Read a serialized object, using the provided msgpack zone.
+		/// Reuse the same zone on hot routes to amortize allocations across messages.
+		template<typename TOut>
+		TOut readObject(msgpack::zone& zone)
+		{
+			Serializer serializer;
+			TOut result;
+			serializer.deserialize(zone, stream, result);
+			return result;
+		}
+
+		/// Read many serialized objects, using the provided msgpack zone.
+		/// Reuse the same zone on hot routes to amortize allocations across messages.
+		template<typename... Args>
+		void readObjects(msgpack::zone& zone, Args&... args)
+		{
+			Serializer serializer;
+			serializer.deserialize(zone, stream, args...);
+		}
+
 #pragma endregion
 
 #pragma region public_members
@@ -81,6 +103,9 @@ namespace Stormancer
 		/// Metadata
 		std::map<std::string, std::string> metadata;
 
+		/// Scene route the packet was received on, if any.
+		std::shared_ptr<Route> route;
+
 #pragma endregion
 
 	private:
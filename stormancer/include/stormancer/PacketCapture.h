@@ -0,0 +1,103 @@
+#pragma once
+
+#include "stormancer/headers.h"
+
+namespace Stormancer
+{
+	/// Records the frames received and sent by the transport in a binary file, to replay them with PacketReplay.
+	/// record() copies the frame in a memory buffer. A background thread appends the full buffers to the file,
+	/// so the network threads never wait for the disk. When both buffers are full, the frames are dropped and counted.
+	///
+	/// File format (integers in the byte order of the machine which captured the file):
+	///   header: 8 bytes "STRMPCAP", uint32 version (1), uint32 reserved, int64 start time (milliseconds since epoch)
+	///   records: uint32 length, byte direction (0: inbound, 1: outbound), byte message id, uint16 reserved,
+	///            uint64 connection id, int64 time since the start of the capture in nanoseconds, length bytes of frame.
+	/// The frames are captured as they are on the network: encrypted frames can only be replayed with the same key.
+	class PacketCapture
+	{
+	public:
+
+		enum class Direction : byte
+		{
+			Inbound = 0,
+			Outbound = 1
+		};
+
+		/// A frame read from a capture file.
+		struct Record
+		{
+			Direction direction;
+			byte messageId;
+			uint64 connectionId;
+			/// Time since the start of the capture.
+			std::chrono::nanoseconds time;
+			std::vector<byte> data;
+		};
+
+#pragma region public_methods
+
+		/// Creates the capture file, replacing an existing file.
+		/// \param path Path of the capture file.
+		/// \param bufferSize Size of each of the two memory buffers, in bytes.
+		PacketCapture(const std::string& path, std::size_t bufferSize = 1024 * 1024);
+
+		/// Writes the buffered frames and closes the file.
+		~PacketCapture();
+
+		PacketCapture(const PacketCapture&) = delete;
+
+		PacketCapture& operator=(const PacketCapture&) = delete;
+
+		/// Records a frame.
+		/// \param direction Whether the frame was received or sent.
+		/// \param connectionId Id of the connection of the frame.
+		/// \param data The frame, starting with its message id.
+		/// \param size Size of the frame.
+		void record(Direction direction, uint64 connectionId, const byte* data, std::size_t size);
+
+		/// Wait until the frames recorded before the call are written to the file.
+		void flush();
+
+		/// Number of frames dropped because the buffers were full.
+		uint64 droppedCount() const;
+
+		/// Reads all the frames of a capture file.
+		/// Throws std::runtime_error if the file can't be read or is not a capture file.
+		static std::vector<Record> read(const std::string& path);
+
+#pragma endregion
+
+	private:
+
+#pragma region private_methods
+
+		void writerLoop();
+
+#pragma endregion
+
+#pragma region private_members
+
+		static const std::size_t recordHeaderSize = 24;
+
+		std::ofstream _file;
+		std::size_t _bufferSize;
+		std::chrono::steady_clock::time_point _start;
+
+		std::mutex _mutex;
+		std::condition_variable _wakeUp;
+		std::condition_variable _written;
+		/// Buffer in which the frames are recorded.
+		std::vector<byte> _current;
+		/// Full buffer waiting for the writer thread when _spareFull, or empty buffer to swap with the current one.
+		std::vector<byte> _spare;
+		bool _spareFull = false;
+		bool _writing = false;
+		bool _flushRequested = false;
+		bool _stopRequested = false;
+		uint64 _writeGeneration = 0;
+		std::atomic<uint64> _droppedCount;
+		std::thread _writer;
+
+#pragma endregion
+	};
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "stormancer/headers.h"
+#include "stormancer/Packet.h"
+
+namespace Stormancer
+{
+	/// Recycles the packets and streams allocated for the received messages.
+	/// A packet returns to the pool when its last shared pointer is released.
+	template<typename T = IConnection>
+	class PacketPool : public std::enable_shared_from_this<PacketPool<T>>
+	{
+	private:
+
+#pragma region private_classes
+
+		struct Entry
+		{
+			Entry()
+				: packet(nullptr, &stream)
+			{
+			}
+
+			ibytestream stream;
+			Packet<T> packet;
+			void* bufferHandle = nullptr;
+			std::shared_ptr<void> bufferOwner;
+			std::shared_ptr<void> parent;
+		};
+
+		struct Recycler
+		{
+			std::shared_ptr<PacketPool<T>> pool;
+			Entry* entry;
+
+			void operator()(Packet<T>*)
+			{
+				pool->release(entry);
+			}
+		};
+
+#pragma endregion
+
+	public:
+
+#pragma region public_methods
+
+		/// Constructor.
+		/// \param capacity Maximum number of free packets kept by the pool.
+		PacketPool(std::size_t capacity = 256)
+			: _capacity(capacity)
+			, _hits(0)
+			, _misses(0)
+		{
+			_free.reserve(capacity);
+		}
+
+		~PacketPool()
+		{
+			for (auto entry : _free)
+			{
+				delete entry;
+			}
+		}
+
+		/// Get a packet reading an external buffer.
+		/// \param source Source of the packet.
+		/// \param data Buffer read by the packet stream.
+		/// \param size Size of the buffer.
+		/// \param bufferHandle Passed to the buffer releaser when the packet is released.
+		/// \param bufferOwner Kept alive until the buffer releaser returns, and passed to it.
+		std::shared_ptr<Packet<T>> acquire(std::shared_ptr<T> source, byte* data, std::streamsize size, void* bufferHandle = nullptr, std::shared_ptr<void> bufferOwner = nullptr)
+		{
+			auto entry = take();
+			entry->stream.rdbuf()->pubsetbuf(data, size);
+			entry->stream.clear();
+			entry->packet.stream = &entry->stream;
+			entry->packet.connection = source;
+			entry->bufferHandle = bufferHandle;
+			entry->bufferOwner = std::move(bufferOwner);
+			return std::shared_ptr<Packet<T>>(&entry->packet, Recycler{ this->shared_from_this(), entry });
+		}
+
+		/// Get a packet reading a part of the buffer of another packet.
+		/// The parent packet is kept alive until the returned packet is released.
+		/// \param source Source of the packet.
+		/// \param data Part of the parent buffer read by the packet stream.
+		/// \param size Size of the part.
+		/// \param parent Packet owning the buffer.
+		template<typename TParent>
+		std::shared_ptr<Packet<T>> acquire(std::shared_ptr<T> source, byte* data, std::streamsize size, std::shared_ptr<Packet<TParent>> parent)
+		{
+			auto entry = take();
+			entry->stream.rdbuf()->pubsetbuf(data, size);
+			entry->stream.clear();
+			entry->packet.stream = &entry->stream;
+			entry->packet.connection = source;
+			entry->packet.metadata = parent->metadata;
+			entry->parent = parent;
+			return std::shared_ptr<Packet<T>>(&entry->packet, Recycler{ this->shared_from_this(), entry });
+		}
+
+		/// Get a packet reading the stream of another packet.
+		/// The parent packet is kept alive until the returned packet is released, and its metadata is moved to the returned packet.
+		/// \param source Source of the packet.
+		/// \param parent Packet owning the stream.
+		template<typename TParent>
+		std::shared_ptr<Packet<T>> acquire(std::shared_ptr<T> source, std::shared_ptr<Packet<TParent>> parent)
+		{
+			auto entry = take();
+			entry->packet.stream = parent->stream;
+			entry->packet.connection = source;
+			entry->packet.metadata = std::move(parent->metadata);
+			entry->packet.route = parent->route;
+			entry->parent = parent;
+			return std::shared_ptr<Packet<T>>(&entry->packet, Recycler{ this->shared_from_this(), entry });
+		}
+
+		/// Set the function releasing the external buffers passed to acquire. It gets the buffer handle and the buffer owner.
+		void setBufferReleaser(std::function<void(void*, void*)> releaser)
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			_bufferReleaser = releaser;
+		}
+
+		/// Number of packets served from the pool.
+		uint64 hits() const
+		{
+			return _hits;
+		}
+
+		/// Number of packets allocated because the pool was empty.
+		uint64 misses() const
+		{
+			return _misses;
+		}
+
+#pragma endregion
+
+	private:
+
+#pragma region private_methods
+
+		Entry* take()
+		{
+			{
+				std::lock_guard<std::mutex> lg(_mutex);
+				if (!_free.empty())
+				{
+					auto entry = _free.back();
+					_free.pop_back();
+					_hits++;
+					return entry;
+				}
+			}
+			_misses++;
+			return new Entry();
+		}
+
+		void release(Entry* entry)
+		{
+			entry->packet.clean();
+			entry->packet.connection.reset();
+			entry->packet.metadata.clear();
+			entry->packet.route.reset();
+			entry->parent.reset();
+			entry->stream.rdbuf()->pubsetbuf(nullptr, 0);
+
+			if (entry->bufferHandle)
+			{
+				std::function<void(void*, void*)> releaser;
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					releaser = _bufferReleaser;
+				}
+				if (releaser)
+				{
+					releaser(entry->bufferHandle, entry->bufferOwner.get());
+				}
+			}
+			entry->bufferHandle = nullptr;
+			entry->bufferOwner.reset();
+
+			{
+				std::lock_guard<std::mutex> lg(_mutex);
+				if (_free.size() < _capacity)
+				{
+					_free.push_back(entry);
+					return;
+				}
+			}
+			delete entry;
+		}
+
+#pragma endregion
+
+#pragma region private_members
+
+		std::size_t _capacity;
+		std::vector<Entry*> _free;
+		std::function<void(void*, void*)> _bufferReleaser;
+		std::atomic<uint64> _hits;
+		std::atomic<uint64> _misses;
+		std::mutex _mutex;
+
+#pragma endregion
+	};
+};
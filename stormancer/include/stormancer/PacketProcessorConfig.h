@@ -5,20 +5,23 @@
 
 namespace Stormancer
 {
+	/// Message handlers, indexed by message id.
+	using HandlersTable = std::array<handlerFunction*, 256>;
+
 	/// Contains methods to register messages handlers based on message type.
 	/// Pass it to the IPacketProcessor::RegisterProcessor method.
 	class PacketProcessorConfig
 	{
 	public:
 
-		PacketProcessorConfig(std::map<byte, handlerFunction*>& handlers, std::vector<processorFunction*>& defaultProcessors);
+		PacketProcessorConfig(HandlersTable& handlers, std::vector<processorFunction*>& defaultProcessors);
 		virtual ~PacketProcessorConfig();
 		void addProcessor(byte msgId, handlerFunction* handler);     
 		void addCatchAllProcessor(processorFunction* processor);
 
 	private:
 
-		std::map<byte, handlerFunction*>& _handlers;
+		HandlersTable& _handlers;
 		std::vector<processorFunction*>& _defaultProcessors;
 	};
 };
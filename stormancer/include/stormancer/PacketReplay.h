@@ -0,0 +1,47 @@
+#pragma once
+
+#include "stormancer/headers.h"
+#include "stormancer/PacketCapture.h"
+#include "stormancer/IPacketDispatcher.h"
+#include "stormancer/IConnection.h"
+
+namespace Stormancer
+{
+	/// Feeds the inbound frames of a capture file to a packet dispatcher, without network.
+	/// Used to reproduce a sequence of messages, or to benchmark the dispatch with real traffic.
+	/// The dispatcher must be set up like the one of the client which captured the file (processors, scenes, encryption key).
+	class PacketReplay
+	{
+	public:
+
+#pragma region public_methods
+
+		/// Loads a capture file.
+		/// Throws std::runtime_error if the file can't be read.
+		PacketReplay(const std::string& path);
+
+		/// Creates a replay from records already in memory.
+		PacketReplay(std::vector<PacketCapture::Record> records);
+
+		/// All the frames of the capture, inbound and outbound.
+		const std::vector<PacketCapture::Record>& records() const;
+
+		/// Dispatch the inbound frames, in order.
+		/// \param dispatcher The dispatcher receiving the frames.
+		/// \param connectionResolver Returns the connection set on the packets of a captured connection id. If empty, the packets have no connection.
+		/// \param speed 0 to dispatch the frames as fast as possible, 1 to reproduce the captured timing, 2 to go twice faster...
+		/// \return The number of dispatched frames.
+		std::size_t replay(IPacketDispatcher& dispatcher, std::function<std::shared_ptr<IConnection>(uint64)> connectionResolver = std::function<std::shared_ptr<IConnection>(uint64)>(), double speed = 0);
+
+#pragma endregion
+
+	private:
+
+#pragma region private_members
+
+		/// Kept alive by the packets, which read the frames without copying them.
+		std::shared_ptr<std::vector<PacketCapture::Record>> _records;
+
+#pragma endregion
+	};
+};
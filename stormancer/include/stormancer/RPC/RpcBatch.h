@@ -0,0 +1,119 @@
+#pragma once
+
+#include "stormancer/headers.h"
+#include "stormancer/RPC/RpcService.h"
+
+namespace Stormancer
+{
+	/// Coalesces RPCs to the same scene into one frame, sent by send().
+	/// Each RPC still has its own request id and task, completed when its own response arrives.
+	///
+	/// Request frame, sent on the remote route RpcPlugin::batchRouteName:
+	///   uint16 count
+	///   count times: uint16 route handle, uint16 request id, uint32 length, length bytes of arguments.
+	/// The server processes each call in order, as if it was received on its route with its request id.
+	///
+	/// Response frame, sent by the server on the local route RpcPlugin::batchResponsesRouteName:
+	///   uint16 count
+	///   count times: byte kind (0: next, 1: error, 2: complete), uint32 length, length bytes of message.
+	/// The message of each response is the content of the message the server would send on the next, error or completed route.
+	/// The server may answer the calls of a batch individually, in several response frames, or both.
+	///
+	/// If the scene doesn't expose RpcPlugin::batchRouteName, the calls are sent individually as soon as they are added.
+	/// The batch must not outlive the RpcService that created it.
+	class RpcBatch
+	{
+		friend class RpcService;
+
+	public:
+
+#pragma region public_methods
+
+		RpcBatch(RpcBatch&& other) = default;
+
+		/// Fails the calls that were not sent.
+		~RpcBatch();
+
+		/// Add an RPC with writer and deserializer functions to the batch.
+		template<typename TOutput>
+		pplx::task<TOutput> rpcWriter(const RpcStub& stub, const Writer& writer, const Unwriter<TOutput>& unwriter)
+		{
+			if (!_batchRoute)
+			{
+				return _service->rpcWriter<TOutput>(stub, writer, unwriter);
+			}
+			return _service->rpcWriterImpl<TOutput>(RpcService::BatchedCall{ this, stub }, writer, unwriter);
+		}
+
+		/// Add an RPC with writer function to the batch.
+		pplx::task<void> rpcWriter(const RpcStub& stub, const Writer& writer);
+
+		/// Add an RPC with auto-serialization to the batch.
+		/// The arguments are serialized immediately.
+		template<typename TOutput, typename... TInputs>
+		pplx::task<TOutput> rpc(const RpcStub& stub, TInputs const&... args)
+		{
+			auto& serializer = _service->_serializer;
+			return rpcWriter<TOutput>(stub, [&serializer, &args...](obytestream* stream) {
+				serializer.serialize(stream, args...);
+			}, [&serializer](ibytestream* stream) {
+				return serializer.deserializeOne<TOutput>(stream);
+			});
+		}
+
+		/// Add an RPC with auto-serialization to the batch.
+		/// Throws if the route is not a valid RPC route (see RpcService::bind).
+		template<typename TOutput, typename... TInputs>
+		pplx::task<TOutput> rpc(const std::string& procedure, TInputs const&... args)
+		{
+			return rpc<TOutput>(_service->bind(procedure), args...);
+		}
+
+		/// Number of calls waiting to be sent.
+		std::size_t size() const;
+
+		/// Send the calls added since the last send in one frame.
+		/// \param priority Priority of the frame on the network.
+		void send(PacketPriority priority = PacketPriority::MEDIUM_PRIORITY);
+
+#pragma endregion
+
+	private:
+
+#pragma region private_classes
+
+		struct Call
+		{
+			uint16 routeHandle;
+			RpcRequest_ptr request;
+			std::vector<byte> arguments;
+		};
+
+#pragma endregion
+
+#pragma region private_methods
+
+		RpcBatch(RpcService* service, Route_ptr batchRoute, int channelUid);
+
+		RpcBatch(const RpcBatch&) = delete;
+
+		RpcBatch& operator=(const RpcBatch&) = delete;
+
+		RpcBatch& operator=(RpcBatch&&) = delete;
+
+		void append(const RpcStub& stub, RpcRequest_ptr request, const Writer& writer);
+
+		void fail(std::vector<Call>& calls, const std::string& reason);
+
+#pragma endregion
+
+#pragma region private_members
+
+		RpcService* _service;
+		Route_ptr _batchRoute;
+		int _channelUid;
+		std::vector<Call> _calls;
+
+#pragma endregion
+	};
+};
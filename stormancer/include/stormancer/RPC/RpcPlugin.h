@@ -23,5 +23,7 @@ namespace Stormancer
 		STORMANCER_DLL_API static const std::string errorRouteName;
 		STORMANCER_DLL_API static const std::string completeRouteName;
 		STORMANCER_DLL_API static const std::string cancellationRouteName;
+		STORMANCER_DLL_API static const std::string batchRouteName;
+		STORMANCER_DLL_API static const std::string batchResponsesRouteName;
 	};
 };
@@ -17,6 +17,8 @@ namespace Stormancer
 		pplx::task_completion_event<void> tce;
 		pplx::task<void> task;
 		bool hasCompleted = false;
+		/// The request is queued in an RpcBatch and was not sent yet.
+		bool queued = false;
 	};
 
 	using RpcRequest_ptr = std::shared_ptr<RpcRequest>;
@@ -3,6 +3,7 @@
 #include "stormancer/headers.h"
 #include "stormancer/RPC/RpcRequestContext.h"
 #include "stormancer/RPC/RpcRequest.h"
+#include "stormancer/RequestSlotTable.h"
 #include "stormancer/Scene.h"
 #include "stormancer/IActionDispatcher.h"
 #include "stormancer/PacketPriority.h"
@@ -10,10 +11,47 @@
 namespace Stormancer
 {
 	class RpcPlugin;
+	class RpcService;
+	class RpcBatch;
+
+	/// RPC route resolved and validated once by RpcService::bind.
+	/// Reuse it to send RPCs on a hot route without looking up the route and the channel on each call.
+	class RpcStub
+	{
+		friend class RpcService;
+		friend class RpcBatch;
+
+	public:
+
+		/// The procedure name.
+		const std::string& route() const
+		{
+			return _route->name();
+		}
+
+	private:
+
+		Route_ptr _route;
+		int _channelUid = 0;
+	};
 
 	class RpcService
 	{
 		friend class RpcPlugin;
+		friend class RpcBatch;
+
+	private:
+
+#pragma region private_classes
+
+		/// RPC queued in a batch.
+		struct BatchedCall
+		{
+			RpcBatch* batch;
+			RpcStub stub;
+		};
+
+#pragma endregion
 
 	public:
 
@@ -33,9 +71,21 @@ namespace Stormancer
 
 		std::shared_ptr<IActionDispatcher> getDispatcher();
 
+		/// Resolve and validate an RPC route, and reserve its channel.
+		/// Throws if the route doesn't exist on the scene or is not a compatible RPC route.
+		/// \param route The procedure name.
+		/// \return A stub to pass to the RPC methods instead of the procedure name.
+		RpcStub bind(const std::string& route);
+
+		/// Create a batch coalescing RPCs into one frame. Include "stormancer/RPC/RpcBatch.h" to use it.
+		RpcBatch batch();
+
 		/// Send an RPC and returns an observable
 		rxcpp::observable<Packetisp_ptr> rpc_observable(const std::string& route, const Writer& writer, PacketPriority priority = PacketPriority::MEDIUM_PRIORITY);
 
+		/// Send an RPC on a bound route and returns an observable
+		rxcpp::observable<Packetisp_ptr> rpc_observable(const RpcStub& stub, const Writer& writer, PacketPriority priority = PacketPriority::MEDIUM_PRIORITY);
+
 		/// RPC with writer and deserializer functions.
 		/// \param procedure The procedure name.
 		/// \param writer User function for serializing data to send. Use function (or lambda) of type Writer.
@@ -44,6 +94,62 @@ namespace Stormancer
 		/// \return pplx::task<TOutput> A task which exposes the success of the operation and the server response.
 		template<typename TOutput>
 		pplx::task<TOutput> rpcWriter(const std::string& procedure, const Writer& writer, const Unwriter<TOutput>& unwriter)
+		{
+			return rpcWriterImpl<TOutput>(procedure, writer, unwriter);
+		}
+
+		/// RPC on a bound route with writer and deserializer functions.
+		template<typename TOutput>
+		pplx::task<TOutput> rpcWriter(const RpcStub& stub, const Writer& writer, const Unwriter<TOutput>& unwriter)
+		{
+			return rpcWriterImpl<TOutput>(stub, writer, unwriter);
+		}
+
+		/// RPC with writer function.
+		/// \param procedure The procedure name.
+		/// \param writer User function for serializing data to send. Use function (or lambda) of type : Writer.
+		/// Call an operation on the server and get the success.
+		/// \return pplx::task<TOutput> A task which exposes the success of the operation.
+		virtual pplx::task<void> rpcWriter(const std::string& procedure, const Writer& writer);
+
+		/// RPC on a bound route with writer function.
+		pplx::task<void> rpcWriter(const RpcStub& stub, const Writer& writer);
+
+		/// RPC with auto-serialization.
+		/// \param procedure The procedure name.
+		/// \param args Variable number of serializable arguments to send, or Writer and Unwriter<TOutput>.
+		/// Call an operation on the server and get the success and the response.
+		/// \return pplx::task<TOutput> A task which exposes the success of the operation and the server response.
+		template<typename TOutput, typename... TInputs>
+		pplx::task<TOutput> rpc(const std::string& procedure, TInputs const&... args)
+		{
+			return rpcWriter<TOutput>(procedure, [=, &args...](obytestream* stream) {
+				_serializer.serialize(stream, args...);
+			}, [=](ibytestream* stream) {
+				return _serializer.deserializeOne<TOutput>(stream);
+			});
+		}
+
+		/// RPC on a bound route with auto-serialization.
+		template<typename TOutput, typename... TInputs>
+		pplx::task<TOutput> rpc(const RpcStub& stub, TInputs const&... args)
+		{
+			return rpcWriter<TOutput>(stub, [=, &args...](obytestream* stream) {
+				_serializer.serialize(stream, args...);
+			}, [=](ibytestream* stream) {
+				return _serializer.deserializeOne<TOutput>(stream);
+			});
+		}
+
+#pragma endregion
+
+	private:
+
+#pragma region private_methods
+
+		/// \param procedure The procedure name, or a bound route.
+		template<typename TOutput, typename TProcedure>
+		pplx::task<TOutput> rpcWriterImpl(const TProcedure& procedure, const Writer& writer, const Unwriter<TOutput>& unwriter)
 		{
 			pplx::task_completion_event<TOutput> tce;
 
@@ -56,13 +162,13 @@ namespace Stormancer
 				}
 				catch (const std::exception& ex)
 				{
-					_logger->log(LogLevel::Trace, "RpcHelpers", "An exception occurred during the rpc response deserialization " + procedure);
+					_logger->log(LogLevel::Trace, "RpcHelpers", "An exception occurred during the rpc response deserialization " + procedureName(procedure));
 					tce.set_exception(ex);
 				}
 			};
 
 			auto onError = [=](std::exception_ptr error) {
-				_logger->log(LogLevel::Trace, "RpcHelpers", "An exception occurred during the rpc " + procedure);
+				_logger->log(LogLevel::Trace, "RpcHelpers", "An exception occurred during the rpc " + procedureName(procedure));
 				tce.set_exception(error);
 			};
 
@@ -75,33 +181,66 @@ namespace Stormancer
 			return pplx::create_task(tce, pplx::task_options(getDispatcher()));
 		}
 
-		/// RPC with writer function.
-		/// \param procedure The procedure name.
-		/// \param writer User function for serializing data to send. Use function (or lambda) of type : Writer.
-		/// Call an operation on the server and get the success.
-		/// \return pplx::task<TOutput> A task which exposes the success of the operation.
-		virtual pplx::task<void> rpcWriter(const std::string& procedure, const Writer& writer);
-
-		/// RPC with auto-serialization.
-		/// \param procedure The procedure name.
-		/// \param args Variable number of serializable arguments to send, or Writer and Unwriter<TOutput>.
-		/// Call an operation on the server and get the success and the response.
-		/// \return pplx::task<TOutput> A task which exposes the success of the operation and the server response.
-		template<typename TOutput, typename... TInputs>
-		pplx::task<TOutput> rpc(const std::string& procedure, TInputs const&... args)
+		/// \param procedure The procedure name, or a bound route.
+		template<typename TProcedure>
+		pplx::task<void> rpcWriterImpl(const TProcedure& procedure, const Writer& writer)
 		{
-			return rpcWriter<TOutput>(procedure, [=, &args...](obytestream* stream) {
-				_serializer.serialize(stream, args...);
-			}, [=](ibytestream* stream) {
-				return _serializer.deserializeOne<TOutput>(stream);
+			pplx::task_completion_event<void> tce;
+
+			auto observable = rpc_observable(procedure, writer, PacketPriority::MEDIUM_PRIORITY);
+
+			auto logger = _logger;
+			auto name = procedureName(procedure);
+			observable.subscribe([](Packetisp_ptr) {
+				// On next
+			}, [=](std::exception_ptr exptr) {
+				// On error
+				try
+				{
+					std::rethrow_exception(exptr);
+				}
+				catch (const std::exception& ex)
+				{
+					logger->log(LogLevel::Warn, "RpcHelpers", "An exception occurred during the rpc '" + name + "'", ex.what());
+					tce.set_exception(ex);
+				}
+			}, [=]() {
+				// On complete
+				tce.set();
 			});
+
+			return pplx::create_task(tce, pplx::task_options(getDispatcher()));
 		}
 
-#pragma endregion
+		static const std::string& procedureName(const std::string& procedure)
+		{
+			return procedure;
+		}
 
-	private:
+		static const std::string& procedureName(const RpcStub& stub)
+		{
+			return stub.route();
+		}
 
-#pragma region private_methods
+		static const std::string& procedureName(const BatchedCall& call)
+		{
+			return call.stub.route();
+		}
+
+		/// Queue the RPC in a batch instead of sending it.
+		rxcpp::observable<Packetisp_ptr> rpc_observable(const BatchedCall& call, const Writer& writer, PacketPriority priority);
+
+		/// Send the RPC request on a bound route, and register it to complete the subscriber.
+		void sendRpc(const RpcStub& stub, rxcpp::subscriber<Packetisp_ptr> subscriber, const Writer& writer, PacketPriority priority);
+
+		/// Register a request completing the subscriber.
+		RpcRequest_ptr reserveRequest(rxcpp::subscriber<Packetisp_ptr> subscriber);
+
+		/// Send a cancellation to the server if the subscriber unsubscribes before the request completes.
+		void addCancellation(rxcpp::subscriber<Packetisp_ptr> subscriber, RpcRequest_ptr request);
+
+		/// Complete the requests answered in a batch response frame.
+		void batchResponses(Packetisp_ptr packet);
 
 		void next(Packetisp_ptr packet);
 		void error(Packetisp_ptr packet);
@@ -121,17 +260,15 @@ namespace Stormancer
 			// Do nothing
 		}
 
-		uint16 reserveId();
 		RpcRequest_ptr getPendingRequest(Packetisp_ptr packet);
-		void eraseRequest(uint16 requestId);
+		void eraseRequest(const RpcRequest_ptr& request);
 
 #pragma endregion
 
 #pragma region private_members
 
 		std::shared_ptr<IActionDispatcher> _dispatcher;
-		std::map<uint16, RpcRequest_ptr> _pendingRequests;
-		std::mutex _pendingRequestsMutex;
+		RequestSlotTable<RpcRequest> _pendingRequests;
 		std::map<uint16, pplx::cancellation_token_source> _runningRequests;
 		std::mutex _runningRequestsMutex;
 		Scene* _scene;
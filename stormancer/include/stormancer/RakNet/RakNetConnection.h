@@ -5,6 +5,8 @@
 #include "stormancer/IConnection.h"
 #include "stormancer/PacketPriority.h"
 #include "stormancer/Logger/ILogger.h"
+#include "stormancer/IPacketTransform.h"
+#include "stormancer/PacketCapture.h"
 
 namespace Stormancer
 {
@@ -77,6 +79,31 @@ namespace Stormancer
 
 	private:
 
+#pragma region private_classes
+
+		/// Messages of an ordering channel waiting to be sent in one datagram, with the same priority and reliability.
+		struct Batch
+		{
+			char orderingChannel;
+			PacketPriority priority;
+			PacketReliability reliability;
+			std::vector<byte> data;
+			int count = 0;
+		};
+
+#pragma endregion
+
+#pragma region private_methods
+
+		/// Send the coalesced messages. Called by the transport on each run.
+		void flushBatches();
+
+		void sendBatch(RakNet::RakPeerInterface* peer, Batch& batch);
+
+		void sendDatagram(RakNet::RakPeerInterface* peer, const byte* data, std::streamsize size, PacketPriority priority, PacketReliability reliability, char orderingChannel);
+
+#pragma endregion
+
 #pragma region private_members
 
 		std::map<std::string, std::string> _metadata;
@@ -93,6 +120,14 @@ namespace Stormancer
 		rxcpp::subjects::subject<ConnectionState> _connectionStateObservable;
 		Action<std::string> _closeAction;
 		ILogger_ptr _logger;
+		/// Transforms applied to the sent packets, built once for the connection.
+		std::vector<std::shared_ptr<IPacketTransform>> _packetTransforms;
+		/// Maximum size of a datagram of coalesced messages, or 0 if send coalescing is disabled.
+		std::size_t _coalescingSize = 0;
+		std::mutex _batchesMutex;
+		std::vector<Batch> _batches;
+		/// Records the sent frames, if the capture is enabled.
+		std::shared_ptr<PacketCapture> _capture;
 		
 #pragma endregion
 	};
@@ -7,6 +7,8 @@
 #include "stormancer/RakNet/RaknetConnection.h"
 #include "stormancer/DependencyResolver.h"
 #include "stormancer/IScheduler.h"
+#include "stormancer/Configuration.h"
+#include "stormancer/PacketPool.h"
 
 namespace Stormancer
 {
@@ -42,6 +44,9 @@ namespace Stormancer
 		/// both local and external (if the peer is already connected to the server).
 		std::vector<std::string> externalAddresses() const override;
 
+		/// Pool recycling the received packets. Exposes the pool hits and misses counters.
+		std::shared_ptr<PacketPool<>> packetPool() const;
+
 	private:
 
 #pragma endregion
@@ -51,6 +56,7 @@ namespace Stormancer
 		void stop();
 		void initialize(uint16 maxConnections, uint16 serverPort = 0);
 		void run();
+		void receiveLoop();
 		void onConnectionIdReceived(uint64 p);
 		std::shared_ptr<RakNetConnection> onConnection(RakNet::SystemAddress systemAddress, RakNet::RakNetGUID guid, uint64 peerId);
 		void onDisconnection(RakNet::Packet* packet, std::string reason);
@@ -63,7 +69,12 @@ namespace Stormancer
 		pplx::task<int> sendPing(const std::string& address, const int nb, pplx::cancellation_token ct = pplx::cancellation_token::none()) override;
 		void openNat(const std::string& address) override;
 		std::vector<std::string> getAvailableEndpoints() const override;
-		void startNextPendingConnections();
+		/// Removes the connection requests pending for an address. Must be called with _pendingConnection_mtx locked.
+		std::vector<ConnectionRequest> takePendingConnections(const RakNet::SystemAddress& address);
+		/// Stops the connection attempt to an address if all the requests waiting for it are canceled.
+		void cancelPendingConnections(const RakNet::SystemAddress& address);
+		/// Fails the connection requests pending for an address.
+		void failPendingConnections(const RakNet::SystemAddress& address, const std::string& reason);
 
 #pragma endregion
 
@@ -77,8 +88,16 @@ namespace Stormancer
 		std::string _type;
 		std::map<uint64, std::shared_ptr<RakNetConnection>> _connections;
 		std::mutex _pendingConnection_mtx;
-		std::queue<ConnectionRequest> _pendingConnections;
+		/// Connection requests waiting for a result, by target address (ip:port). The connection attempts to different
+		/// addresses run concurrently, the requests to the same address share a single attempt.
+		std::unordered_map<std::string, std::vector<ConnectionRequest>> _pendingConnections;
 		std::shared_ptr<IScheduler> _scheduler;
+		TransportReceiveMode _receiveMode = TransportReceiveMode::EVENT_DRIVEN;
+		int _pollInterval = 15;
+		int _sendCoalescingSize = 0;
+		std::shared_ptr<PacketCapture> _capture;
+		std::thread _receiveThread;
+		std::shared_ptr<PacketPool<>> _packetPool = std::make_shared<PacketPool<>>();
 		std::shared_ptr<RakNet::SocketDescriptor> _socketDescriptor;
 		std::mutex _mutex;
 		std::string _name = "raknet";
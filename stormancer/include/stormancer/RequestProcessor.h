@@ -5,6 +5,7 @@
 #include "stormancer/Logger/ILogger.h"
 #include "stormancer/IRequestModule.h"
 #include "stormancer/SystemRequest.h"
+#include "stormancer/RequestSlotTable.h"
 #include "stormancer/PacketPriority.h"
 #include "stormancer/Serializer.h"
 
@@ -80,8 +81,7 @@ namespace Stormancer
 
 #pragma region private_members
 
-		std::map<uint16, SystemRequest_ptr> _pendingRequests;
-		std::mutex _mutexPendingRequests;
+		RequestSlotTable<SystemRequest> _pendingRequests;
 		std::shared_ptr<ILogger> _logger;
 		bool _isRegistered = false;
 		std::map<byte, std::function<pplx::task<void>(RequestContext*)>> _handlers;
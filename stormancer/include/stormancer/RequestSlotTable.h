@@ -0,0 +1,363 @@
+#pragma once
+
+#include "stormancer/headers.h"
+
+namespace Stormancer
+{
+	/// Table of the pending requests, indexed by their 16 bits request id.
+	/// The free ids are kept in a lock-free FIFO queue threaded through the slots, so reserving an id is O(1)
+	/// and a released id is reused as late as possible.
+	/// The slots are allocated by chunks of chunkSize, when all the allocated slots are used.
+	/// Each slot is guarded by its own spin lock: completing a request only contends with operations on the same id.
+	template<typename T>
+	class RequestSlotTable
+	{
+	public:
+
+#pragma region public_methods
+
+		RequestSlotTable()
+			: _allocatedSlots(0)
+			, _head(makeLink(sentinel, 0))
+			, _tail(makeLink(sentinel, 0))
+			, _size(0)
+		{
+			for (auto& chunk : _chunks)
+			{
+				chunk.store(nullptr, std::memory_order_relaxed);
+			}
+		}
+
+		~RequestSlotTable()
+		{
+			for (auto& chunk : _chunks)
+			{
+				delete[] chunk.load(std::memory_order_relaxed);
+			}
+		}
+
+		RequestSlotTable(const RequestSlotTable<T>&) = delete;
+		RequestSlotTable<T>& operator=(const RequestSlotTable<T>&) = delete;
+
+		/// Store a request in a free slot.
+		/// \param request The request to store.
+		/// \return The id of the slot. Throws std::overflow_error if all the slots are used.
+		uint16 reserve(std::shared_ptr<T> request)
+		{
+			while (true)
+			{
+				uint32 allocatedSlots = _allocatedSlots.load(std::memory_order_acquire);
+				uint32 index = popFree();
+				if (index == sentinel)
+				{
+					// The sentinel only keeps the queue non-empty: put it back at the end
+					pushFree(sentinel);
+					continue;
+				}
+				if (index != nullIndex)
+				{
+					Slot& slot = *findSlot(index);
+					{
+						SlotLock lock(slot);
+						slot.request = std::move(request);
+						slot.used.store(true, std::memory_order_relaxed);
+					}
+					_size.fetch_add(1, std::memory_order_relaxed);
+					return (uint16)index;
+				}
+
+				// The queue is empty, but another thread may be putting the sentinel back or counting the id it just reserved
+				if (_size.load(std::memory_order_relaxed) < allocatedSlots)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+				if (!grow(allocatedSlots))
+				{
+					throw std::overflow_error("Too many pending requests.");
+				}
+			}
+		}
+
+		/// Get the request stored in a slot.
+		/// \return The request, or nullptr if the slot is free.
+		std::shared_ptr<T> get(uint16 id) const
+		{
+			Slot* slot = findSlot(id);
+			if (!slot)
+			{
+				return nullptr;
+			}
+			SlotLock lock(*slot);
+			return slot->request;
+		}
+
+		/// Remove the request stored in a slot, and free the slot.
+		/// \return The request, or nullptr if the slot was already free.
+		std::shared_ptr<T> take(uint16 id)
+		{
+			std::shared_ptr<T> request;
+			Slot* slot = findSlot(id);
+			if (!slot)
+			{
+				return request;
+			}
+			{
+				SlotLock lock(*slot);
+				if (!slot->used.load(std::memory_order_relaxed))
+				{
+					return request;
+				}
+				request = std::move(slot->request);
+				slot->request.reset();
+				slot->used.store(false, std::memory_order_relaxed);
+			}
+			pushFree(id);
+			_size.fetch_sub(1, std::memory_order_relaxed);
+			return request;
+		}
+
+		/// Free a slot if it still stores a given request.
+		/// Use it when the id may have been released and reserved again by another request.
+		/// \return true if the slot was freed.
+		bool remove(uint16 id, const T* request)
+		{
+			Slot* slot = findSlot(id);
+			if (!slot)
+			{
+				return false;
+			}
+			{
+				SlotLock lock(*slot);
+				if (!slot->used.load(std::memory_order_relaxed) || slot->request.get() != request)
+				{
+					return false;
+				}
+				slot->request.reset();
+				slot->used.store(false, std::memory_order_relaxed);
+			}
+			pushFree(id);
+			_size.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		/// Remove all the requests, and free all the slots.
+		std::vector<std::shared_ptr<T>> takeAll()
+		{
+			std::vector<std::shared_ptr<T>> requests;
+			uint32 allocatedSlots = _allocatedSlots.load(std::memory_order_acquire);
+			for (uint32 id = 0; id < allocatedSlots; id++)
+			{
+				if (findSlot((uint16)id)->used.load(std::memory_order_relaxed))
+				{
+					auto request = take((uint16)id);
+					if (request)
+					{
+						requests.push_back(std::move(request));
+					}
+				}
+			}
+			return requests;
+		}
+
+		/// Number of used slots.
+		std::size_t size() const
+		{
+			return _size.load(std::memory_order_relaxed);
+		}
+
+		/// Number of allocated slots.
+		std::size_t allocatedSlots() const
+		{
+			return _allocatedSlots.load(std::memory_order_relaxed);
+		}
+
+		static const uint32 capacity = 0x10000;
+
+		static const uint32 chunkSize = 0x100;
+
+#pragma endregion
+
+	private:
+
+#pragma region private_classes
+
+		struct Slot
+		{
+			Slot()
+				: used(false)
+				, next(makeLink(nullIndex, 0))
+			{
+				lock.clear();
+			}
+
+			std::atomic_flag lock;
+			std::atomic<bool> used;
+			std::shared_ptr<T> request;
+
+			/// Next free slot in the queue, tagged with a modification count (see makeLink).
+			std::atomic<uint64> next;
+		};
+
+		class SlotLock
+		{
+		public:
+
+			SlotLock(Slot& slot)
+				: _slot(slot)
+			{
+				while (_slot.lock.test_and_set(std::memory_order_acquire))
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			~SlotLock()
+			{
+				_slot.lock.clear(std::memory_order_release);
+			}
+
+		private:
+
+			Slot& _slot;
+		};
+
+#pragma endregion
+
+#pragma region private_methods
+
+		/// Get a slot, or nullptr if its chunk is not allocated.
+		Slot* findSlot(uint16 id) const
+		{
+			Slot* chunk = _chunks[id / chunkSize].load(std::memory_order_acquire);
+			return (chunk ? &chunk[id % chunkSize] : nullptr);
+		}
+
+		/// Get a node of the free queue: an allocated slot, or the sentinel.
+		Slot& node(uint32 index)
+		{
+			return (index == sentinel ? _sentinel : *findSlot((uint16)index));
+		}
+
+		/// A link of the free queue: a node index in the low 32 bits, and a count in the high 32 bits.
+		/// The count is incremented on each update, so a CAS fails if the node was dequeued and queued again since it was read (ABA).
+		static uint64 makeLink(uint32 index, uint32 count)
+		{
+			return ((uint64)(count & 0xFFFFFFFF) << 32) | (index & 0xFFFFFFFF);
+		}
+
+		static uint32 linkIndex(uint64 link)
+		{
+			return (uint32)(link & 0xFFFFFFFF);
+		}
+
+		static uint32 linkCount(uint64 link)
+		{
+			return (uint32)(link >> 32);
+		}
+
+		/// Append a node to the free queue (Michael & Scott queue, with counted links).
+		/// The nodes are never deallocated before the table, so a stale index can always be dereferenced.
+		void pushFree(uint32 index)
+		{
+			Slot& pushed = node(index);
+			uint64 next = pushed.next.load(std::memory_order_relaxed);
+			pushed.next.store(makeLink(nullIndex, linkCount(next) + 1), std::memory_order_relaxed);
+
+			uint64 tail;
+			while (true)
+			{
+				tail = _tail.load(std::memory_order_acquire);
+				next = node(linkIndex(tail)).next.load(std::memory_order_acquire);
+				if (tail != _tail.load(std::memory_order_acquire))
+				{
+					continue;
+				}
+				if (linkIndex(next) == nullIndex)
+				{
+					if (node(linkIndex(tail)).next.compare_exchange_weak(next, makeLink(index, linkCount(next) + 1), std::memory_order_acq_rel, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else
+				{
+					// The tail is lagging behind: help the other thread move it
+					_tail.compare_exchange_weak(tail, makeLink(linkIndex(next), linkCount(tail) + 1), std::memory_order_acq_rel, std::memory_order_relaxed);
+				}
+			}
+			_tail.compare_exchange_strong(tail, makeLink(index, linkCount(tail) + 1), std::memory_order_acq_rel, std::memory_order_relaxed);
+		}
+
+		/// Remove the oldest node from the free queue.
+		/// The head node is a dummy: popping it makes its successor the new dummy. The queue always keeps one node,
+		/// so an extra sentinel node is queued with the slots, and reserve() puts it back when it pops it.
+		/// \return The index of the node, or nullIndex if only one node is queued.
+		uint32 popFree()
+		{
+			while (true)
+			{
+				uint64 head = _head.load(std::memory_order_acquire);
+				uint64 tail = _tail.load(std::memory_order_acquire);
+				uint64 next = node(linkIndex(head)).next.load(std::memory_order_acquire);
+				if (head != _head.load(std::memory_order_acquire))
+				{
+					continue;
+				}
+				if (linkIndex(head) == linkIndex(tail))
+				{
+					if (linkIndex(next) == nullIndex)
+					{
+						return nullIndex;
+					}
+					_tail.compare_exchange_weak(tail, makeLink(linkIndex(next), linkCount(tail) + 1), std::memory_order_acq_rel, std::memory_order_relaxed);
+				}
+				else if (_head.compare_exchange_weak(head, makeLink(linkIndex(next), linkCount(head) + 1), std::memory_order_acq_rel, std::memory_order_relaxed))
+				{
+					return linkIndex(head);
+				}
+			}
+		}
+
+		/// Allocate the next chunk, unless another thread did since allocatedSlots was read.
+		/// \return false if all the chunks are allocated.
+		bool grow(uint32 allocatedSlots)
+		{
+			std::lock_guard<std::mutex> lg(_growMutex);
+			if (_allocatedSlots.load(std::memory_order_relaxed) != allocatedSlots)
+			{
+				return true;
+			}
+			if (allocatedSlots >= capacity)
+			{
+				return false;
+			}
+			_chunks[allocatedSlots / chunkSize].store(new Slot[chunkSize], std::memory_order_release);
+			for (uint32 id = allocatedSlots; id < allocatedSlots + chunkSize; id++)
+			{
+				pushFree(id);
+			}
+			_allocatedSlots.store(allocatedSlots + chunkSize, std::memory_order_release);
+			return true;
+		}
+
+#pragma endregion
+
+#pragma region private_members
+
+		/// Index of the extra node of the free queue, which is not a slot.
+		static const uint32 sentinel = capacity;
+
+		static const uint32 nullIndex = 0xFFFFFFFF;
+
+		std::array<std::atomic<Slot*>, capacity / chunkSize> _chunks;
+		std::atomic<uint32> _allocatedSlots;
+		std::mutex _growMutex;
+		Slot _sentinel;
+		std::atomic<uint64> _head;
+		std::atomic<uint64> _tail;
+		std::atomic<std::size_t> _size;
+
+#pragma endregion
+	};
+};
@@ -29,16 +29,23 @@ namespace Stormancer
 		STORMANCER_DLL_API const std::map<std::string, std::string>& metadata() const;
 		void setHandle(uint16 newHandle);
 		MessageOriginFilter filter() const;
+		bool encrypted() const;
+		void setEncrypted(bool encrypted);
+		/// Channel of the route on the connection to the scene host, or -1 if not assigned yet.
+		int channelUid() const;
+		void setChannelUid(int channelUid);
 
 	public:
-		std::list<std::function<void(Packet_ptr)>> handlers;
+		std::list<std::function<void(Packetisp_ptr)>> handlers;
 
 	private:
 		uint16 _handle;
 		std::weak_ptr<Scene> _scene;
 		MessageOriginFilter _filter;
+		bool _encrypted = false;
 		std::string _name;
 		std::map<std::string, std::string> _metadata;
+		std::atomic<int> _channelUid;
 	};
 
 	using Route_ptr = std::shared_ptr<Route>;
@@ -8,6 +8,7 @@
 #include "stormancer/Route.h"
 #include "stormancer/IScenePeer.h"
 #include "stormancer/Packet.h"
+#include "stormancer/PacketPool.h"
 #include "stormancer/PeerFilter.h"
 #include "stormancer/P2P/P2PTunnel.h"
 #include "stormancer/P2P/P2PScenePeer.h"
@@ -73,6 +74,25 @@ namespace Stormancer
 		/// \param reliability Message reliability behavior.
 		void send(const std::string& routeName, const Writer& writer, PacketPriority priority = PacketPriority::MEDIUM_PRIORITY, PacketReliability reliability = PacketReliability::RELIABLE_ORDERED, const std::string& channelIdentifier = "");
 
+		/// Send a packet to a route resolved once, without looking up the route and the channel.
+		/// \param route Remote route returned by remoteRoute.
+		/// \param writer Function where we write the data in the byte stream.
+		/// \param channelUid Channel returned by getChannelUid.
+		/// \param priority Message priority on the network.
+		/// \param reliability Message reliability behavior.
+		void send(const Route_ptr& route, const Writer& writer, int channelUid, PacketPriority priority = PacketPriority::MEDIUM_PRIORITY, PacketReliability reliability = PacketReliability::RELIABLE_ORDERED);
+
+		/// Returns a remote route. Throws if the route doesn't exist on the scene.
+		Route_ptr remoteRoute(const std::string& routeName) const;
+
+		/// Returns the channel reserved on the scene connection for a channel identifier.
+		/// \param channelIdentifier Channel identifier. If empty, the channel of the route.
+		/// \param routeName Route name.
+		int getChannelUid(const std::string& channelIdentifier, const std::string& routeName = "");
+
+		/// Returns the channel of a remote route, reserved on the scene connection on the first call.
+		int getChannelUid(const Route_ptr& route);
+
 		/// Returns the connection state to the the scene.
 		ConnectionState getCurrentConnectionState() const;
 
@@ -125,6 +145,9 @@ namespace Stormancer
 
 		pplx::task<std::shared_ptr<P2PScenePeer>> openP2PConnection(const std::string& p2pToken, pplx::cancellation_token ct = pplx::cancellation_token::none());
 
+		/// Pool recycling the packets passed to the route handlers. Exposes the pool hits and misses counters.
+		std::shared_ptr<PacketPool<IScenePeer>> packetPool() const;
+
 #pragma endregion
 
 	private:
@@ -163,6 +186,17 @@ namespace Stormancer
 
 #pragma endregion
 
+#pragma region private_classes
+
+		/// Local route and its handlers, set for a route handle.
+		struct RouteHandlers
+		{
+			Route_ptr route;
+			std::list<std::function<void(Packetisp_ptr)>> handlers;
+		};
+
+#pragma endregion
+
 #pragma region private_members
 
 		std::shared_ptr<DependencyResolver> _dependencyResolver;
@@ -191,8 +225,8 @@ namespace Stormancer
 		/// The remote routes.
 		std::map<std::string, Route_ptr> _remoteRoutesMap;
 
-		/// Route handlers.
-		std::map<uint16, std::list<std::function<void(Packet_ptr)>>> _handlers;
+		/// Local routes indexed by their handle, built when the scene is connected.
+		std::vector<RouteHandlers> _routesByHandle;
 
 		/// Owner client.
 		std::weak_ptr<Client> _client;
@@ -218,6 +252,9 @@ namespace Stormancer
 
 		Action<Packet_ptr> _onPacketReceived;
 
+		/// Recycles the packets passed to the route handlers.
+		std::shared_ptr<PacketPool<IScenePeer>> _packetPool = std::make_shared<PacketPool<IScenePeer>>();
+
 		/// Scene connected state.
 		ConnectionState _connectionState = ConnectionState::Disconnected;
 		bool _connectionStateObservableCompleted = false;
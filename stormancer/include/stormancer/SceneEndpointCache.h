@@ -0,0 +1,70 @@
+#pragma once
+
+#include "stormancer/headers.h"
+#include "stormancer/SceneEndpoint.h"
+#include "stormancer/ITokenHandler.h"
+
+namespace Stormancer
+{
+	/// Keeps the scene endpoints returned by the API until their token expires.
+	/// Concurrent requests for the same scene share a single fetch.
+	class STORMANCER_DLL_API SceneEndpointCache : public std::enable_shared_from_this<SceneEndpointCache>
+	{
+	public:
+
+		using Fetch = std::function<pplx::task<SceneEndpoint>()>;
+
+#pragma region public_methods
+
+		/// Constructor.
+		/// \param tokenHandler Decodes the protocol v2 tokens to read their expiration. If null, the v2 endpoints are not kept.
+		SceneEndpointCache(std::shared_ptr<ITokenHandler> tokenHandler);
+
+		/// Get the cached endpoint of a scene, or fetch it if it is missing or expired.
+		/// \param key Identifies the scene.
+		/// \param fetch Requests the endpoint to the API. Not called if the endpoint is cached or being fetched.
+		/// \param ct Cancels the returned task, not the fetch shared with the other requests.
+		pplx::task<SceneEndpoint> get(const std::string& key, Fetch fetch, pplx::cancellation_token ct = pplx::cancellation_token::none());
+
+		/// Drop the endpoint of a scene, for instance when the server rejected its token.
+		void invalidate(const std::string& key);
+
+		/// Number of endpoints cached or being fetched.
+		std::size_t size() const;
+
+#pragma endregion
+
+	private:
+
+#pragma region private_classes
+
+		struct Entry
+		{
+			pplx::task<SceneEndpoint> task;
+			uint64 generation = 0;
+			/// False while the endpoint is being fetched.
+			bool fetched = false;
+			std::chrono::steady_clock::time_point expiration;
+		};
+
+#pragma endregion
+
+#pragma region private_methods
+
+		void onFetched(const std::string& key, uint64 generation, const SceneEndpoint& endpoint);
+		void onFetchFailed(const std::string& key, uint64 generation);
+		/// Token expiration, in milliseconds since the Unix epoch, or -1 if unknown.
+		int64 expiration(const SceneEndpoint& endpoint) const;
+
+#pragma endregion
+
+#pragma region private_members
+
+		std::shared_ptr<ITokenHandler> _tokenHandler;
+		mutable std::mutex _mutex;
+		std::unordered_map<std::string, Entry> _entries;
+		uint64 _generation = 0;
+
+#pragma endregion
+	};
+}
@@ -53,13 +53,32 @@ namespace Stormancer
 		template<typename... Args>
 		void deserialize(ibytestream* stream, Args&... args) const
 		{
+			msgpack::zone zone;
+			deserialize(zone, stream, args...);
+		}
+
+		/// Try to deserialize a type from the provided stream and advances the stream.
+		/// The data is unpacked in place from the stream buffer, using the provided zone for the intermediate msgpack objects.
+		/// The zone is cleared before unpacking, so reusing the same zone across calls amortizes allocations across messages.
+		/// \param zone msgpack zone holding the intermediate objects
+		/// \param s Source stream
+		template<typename... Args>
+		void deserialize(msgpack::zone& zone, ibytestream* stream, Args&... args) const
+		{
+			zone.clear();
+
 			auto g = stream->tellg();
 
-			std::vector<byte> buffer;
-			(*stream) >> buffer;
+			const byte* data = stream->currentPtr();
+			std::streamsize dataSize = 0;
+			auto buf = stream->rdbuf();
+			if (buf)
+			{
+				dataSize = std::max<std::streamsize>(buf->in_avail(), 0);
+			}
 
-			uint64 readOffset = 0;
-			UnstackAndDeserialize<Args...>(buffer.data(), buffer.size(), &readOffset, args...);
+			std::size_t readOffset = 0;
+			UnstackAndDeserialize(zone, data, (std::size_t)dataSize, readOffset, args...);
 
 			g += readOffset;
 			stream->seekg(g);
@@ -87,15 +106,18 @@ namespace Stormancer
 #pragma region private_methods
 
 		template<typename T, typename... Args>
-		void UnstackAndDeserialize(const byte* data, const uint64 dataSize, uint64* readOffset, T& value, Args&... args) const
+		void UnstackAndDeserialize(msgpack::zone& zone, const byte* data, const std::size_t dataSize, std::size_t& readOffset, T& value, Args&... args) const
 		{
-			const byte* data2 = data + (*readOffset);
-			uint64 dataSize2 = dataSize - (*readOffset);
-			deserialize<T>(data2, dataSize2, value, readOffset);
-			UnstackAndDeserialize(data, dataSize, readOffset, args...);
+			msgpack::object object = msgpack::unpack(zone, (const char*)data, dataSize, readOffset, &Serializer::referenceBuffer);
+			object.convert(&value);
+			UnstackAndDeserialize(zone, data, dataSize, readOffset, args...);
 		}
 
-		void UnstackAndDeserialize(const byte*, const uint64, uint64*) const;
+		void UnstackAndDeserialize(msgpack::zone&, const byte*, const std::size_t, std::size_t&) const;
+
+		// Strings, binaries and extensions point into the source buffer instead of being copied to the zone.
+		// This is safe because the objects are converted before the source buffer can be released.
+		static bool referenceBuffer(msgpack::type::object_type, std::size_t, void*);
 
 #pragma endregion
 	};
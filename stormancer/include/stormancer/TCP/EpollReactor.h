@@ -0,0 +1,101 @@
+#pragma once
+
+#include "stormancer/headers.h"
+#include "stormancer/Logger/ILogger.h"
+
+#if defined(__linux__)
+
+namespace Stormancer
+{
+	/// Waits for the events of non-blocking sockets with epoll, and runs their handlers on a single thread.
+	/// Also runs the actions posted from other threads, so the state of the sockets is only modified by the reactor thread.
+	class EpollReactor
+	{
+	public:
+
+		/// Called on the reactor thread with the epoll events of the socket.
+		using Handler = std::function<void(uint32_t events)>;
+
+#pragma region public_methods
+
+		EpollReactor(ILogger_ptr logger);
+
+		/// Stops the reactor thread. Can be called by a handler: the reactor thread then exits when the handler returns.
+		~EpollReactor();
+
+		EpollReactor(const EpollReactor&) = delete;
+
+		EpollReactor& operator=(const EpollReactor&) = delete;
+
+		/// Starts the reactor thread.
+		void start();
+
+		/// Stops the reactor thread. The handlers are not called anymore, and the actions not run yet are dropped.
+		void stop();
+
+		/// Starts watching a socket.
+		/// \param fd The socket, in non-blocking mode.
+		/// \param events The epoll events to watch (EPOLLIN, EPOLLOUT...).
+		/// \param handler Called on the reactor thread when an event occurs.
+		void add(int fd, uint32_t events, Handler handler);
+
+		/// Changes the events watched on a socket.
+		void modify(int fd, uint32_t events);
+
+		/// Stops watching a socket. Its handler is not called anymore once the call returns on the reactor thread.
+		void remove(int fd);
+
+		/// Runs an action on the reactor thread. The action is dropped if the reactor is stopped before running it.
+		void post(std::function<void()> action);
+
+		/// Returns true if the calling thread is the reactor thread.
+		bool isReactorThread() const;
+
+#pragma endregion
+
+	private:
+
+#pragma region private_classes
+
+		/// State shared with the reactor thread, which keeps it alive when the reactor is destroyed by a handler.
+		struct State
+		{
+			~State();
+
+			ILogger_ptr logger;
+			int epollFd = -1;
+			/// eventfd waking the reactor thread up when an action is posted or the reactor is stopped.
+			int wakeFd = -1;
+			/// Set by the reactor thread, read by isReactorThread on any thread.
+			std::atomic<std::thread::id> threadId{ std::thread::id() };
+			std::atomic<bool> stopRequested{ false };
+			/// Set once the loop exited: the posted actions are dropped.
+			bool stopped = false;
+			std::mutex mutex;
+			std::unordered_map<int, std::shared_ptr<Handler>> handlers;
+			std::vector<std::function<void()>> postedActions;
+		};
+
+#pragma endregion
+
+#pragma region private_methods
+
+		static void loop(std::shared_ptr<State> state);
+
+		static void runPostedActions(State& state);
+
+		/// Drops the actions not run yet, so the callers waiting for them are released.
+		static void dropPostedActions(State& state);
+
+#pragma endregion
+
+#pragma region private_members
+
+		std::shared_ptr<State> _state;
+		std::thread _thread;
+
+#pragma endregion
+	};
+}
+
+#endif
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <deque>
 #include "SocketDefines.h"
 #include "SocketIncludes.h"
 #include "stormancer/headers.h"
@@ -8,6 +9,8 @@
 
 namespace Stormancer
 {
+	class EpollReactor;
+
 	class TcpConnection : public IConnection
 	{
 		friend class TcpTransport;
@@ -16,7 +19,12 @@ namespace Stormancer
 
 #pragma region public_methods
 
-		TcpConnection(std::shared_ptr<SOCKET> socketId, uint64 connectionId, std::string ip);
+		/// Constructor.
+		/// \param socketId Non-blocking socket of the connection, closed with the connection.
+		/// \param connectionId Id of the connection.
+		/// \param ip Address of the remote peer.
+		/// \param reactor Reactor watching the socket.
+		TcpConnection(SOCKET socketId, uint64 connectionId, std::string ip, std::shared_ptr<EpollReactor> reactor);
 		~TcpConnection();
 		void send(const Writer& writer, int channelUid, PacketPriority priority = PacketPriority::MEDIUM_PRIORITY, PacketReliability reliability = PacketReliability::RELIABLE_ORDERED, const TransformMetadata& transformMetadata = TransformMetadata()) override;
 		void setApplication(std::string account, std::string application) override;
@@ -51,14 +59,20 @@ namespace Stormancer
 
 #pragma region private_methods
 
-		void sendRaw(const Writer& writer, PacketPriority priority, PacketReliability reliability);
+		/// Writes the queued frames. Called on the reactor thread when the socket is writable.
+		/// Returns false if the socket failed.
+		bool flushSendQueue();
+
+		/// Unregisters the socket from the reactor and closes it. Called on the reactor thread.
+		void closeSocket();
 
 #pragma endregion
 
 #pragma region private_members
 
 		Action<std::string> _closeAction;
-		std::weak_ptr<SOCKET> _socketId;
+		SOCKET _socketId;
+		std::shared_ptr<EpollReactor> _reactor;
 		uint64 _id;
 		std::string _account;
 		std::string _application;
@@ -67,10 +81,16 @@ namespace Stormancer
 		time_t _connectionDate = nowTime_t();
 		std::map<std::string, std::string> _metadata;
 		rxcpp::subjects::subject<ConnectionState> _connectionStateObservable;
+		/// Reason passed to close(), reported when the reactor closes the socket.
+		std::string _closeReason;
 
-#pragma endregion
+		/// Protects the socket id and the send queue. Never held while calling user code.
+		std::mutex _sendMutex;
+		/// Length prefixed frames waiting for the socket to be writable.
+		std::deque<std::vector<byte>> _sendQueue;
+		/// Bytes of the first queued frame already written.
+		std::size_t _sendOffset = 0;
 
-		// Inherited via IConnection
-		
+#pragma endregion
 	};
 }
@@ -1,15 +1,18 @@
 #pragma once
 
-#include <thread>
 #include "SocketDefines.h"
 #include "stormancer/headers.h"
 #include "stormancer/ITransport.h"
+#include "stormancer/PacketPool.h"
 #include "stormancer/TCP/TcpConnection.h"
-#include "stormancer/IScheduler.h"
 #include "stormancer/Logger/ILogger.h"
 
 namespace Stormancer
 {
+	class EpollReactor;
+
+	/// Client TCP transport. The sockets are non-blocking and watched by a single reactor thread (epoll, Linux only),
+	/// which parses the length prefixed frames and dispatches the packets as soon as they are received.
 	class TcpTransport : public ITransport
 	{
 	public:
@@ -30,22 +33,74 @@ namespace Stormancer
 		std::vector<std::string> externalAddresses() const override;
 		//P2P (Not implemented)
 		pplx::task<int> sendPing(const std::string& address, pplx::cancellation_token ct = pplx::cancellation_token::none()) override;
+		pplx::task<int> sendPing(const std::string& address, const int nb, pplx::cancellation_token ct = pplx::cancellation_token::none()) override;
 		void openNat(const std::string& address) override;
 		std::vector<std::string> getAvailableEndpoints() const override;
 
+		/// Pool of the received packets.
+		std::shared_ptr<PacketPool<>> packetPool() const;
+
 #pragma endregion
 
 	private:
 
+#pragma region private_classes
+
+		/// Block of received bytes. The packets read their message directly in the block, which is recycled when
+		/// the connection and all the packets are done with it.
+		struct ReceiveBlock
+		{
+			std::atomic<int> references;
+			std::vector<byte> data;
+			/// Start of the bytes not parsed yet.
+			std::size_t begin = 0;
+			/// End of the received bytes.
+			std::size_t end = 0;
+		};
+
+		/// Recycles the receive blocks. Shared with the buffer releaser of the packet pool, which can outlive the transport.
+		class ReceiveBlockPool
+		{
+		public:
+
+			ReceiveBlockPool(std::size_t blockSize, std::size_t capacity);
+			~ReceiveBlockPool();
+
+			/// Get a block of at least minSize bytes, with one reference.
+			ReceiveBlock* take(std::size_t minSize);
+
+			/// Drop a reference to a block.
+			void release(ReceiveBlock* block);
+
+		private:
+
+			std::size_t _blockSize;
+			std::size_t _capacity;
+			std::vector<ReceiveBlock*> _free;
+			std::mutex _mutex;
+		};
+
+		/// State of a socket, only accessed on the reactor thread once the socket is registered.
+		struct SocketState
+		{
+			std::shared_ptr<TcpConnection> connection;
+			std::string endpoint;
+			pplx::task_completion_event<std::shared_ptr<IConnection>> connected;
+			ReceiveBlock* block = nullptr;
+		};
+
+#pragma endregion
+
 #pragma region private_methods
 
 		void stop();
-		void initialize();
-		void run();
 		void onConnectionIdReceived(int64 id);
-		void listen(std::string endpoint);
-		std::shared_ptr<TcpConnection> createNewConnection(std::string endpoint);
-		void onDisconnection(std::string endpoint, std::string reason);
+		void onSocketEvent(SOCKET socketId, uint32_t events);
+		void onConnected(SocketState& state);
+		void receive(SocketState& state);
+		/// Dispatches the complete frames of the block. Returns false if a frame is invalid.
+		bool parseFrames(SocketState& state);
+		void onDisconnection(SOCKET socketId, std::string reason);
 
 #pragma endregion
 
@@ -55,23 +110,19 @@ namespace Stormancer
 		DependencyResolver* _dependencyResolver = nullptr;
 		std::shared_ptr<IConnectionManager> _handler;
 		std::shared_ptr<ILogger> _logger;
-		std::shared_ptr<TcpConnection> _connection;
-		std::unordered_map<std::string, pplx::task_completion_event<std::weak_ptr<IConnection>>> _pendingConnections;
-		std::shared_ptr<IScheduler> _scheduler;
+		std::shared_ptr<EpollReactor> _reactor;
+		std::unordered_map<SOCKET, SocketState> _sockets;
+		std::shared_ptr<ReceiveBlockPool> _blockPool;
+		std::size_t _maxFrameSize;
+		std::shared_ptr<PacketPool<>> _packetPool = std::make_shared<PacketPool<>>();
 		std::mutex _mutex;
-		std::mutex _packetQueueMutex;
-		std::queue<Packet_ptr> _pendingPackets;
 		std::string _name;
 		std::string _type;
-		std::shared_ptr<SOCKET> _socketId;
 		Action<Packet_ptr> _onPacketReceived;
-		uint64 _id = 0;
+		std::atomic<uint64> _id;
 		std::string _host;
 		uint16 _port = 0;
-		std::shared_ptr<std::thread> _listeningThread;
-		std::mutex _actionQueueMutex;
-		std::queue<std::function<void()>> _actionQueue; 
 
 #pragma endregion
 	};
-}
\ No newline at end of file
+}
@@ -3,19 +3,22 @@
 #include <thread>
 #include <condition_variable>
 #include <mutex>
-#include <queue>
 #include <chrono>
 #include <functional>
+#include <limits>
 #include <memory>
+#include "stormancer/TimerWheel.h"
 
 namespace Stormancer
 {
 
+	/// Runs scheduled functions, with a resolution of 1 millisecond.
 	class TimerThread
 	{
 	public:
 
 		using clock_type = std::chrono::steady_clock;
+		using TimerId = TimerWheel::TimerId;
 
 #pragma region public_methods
 
@@ -27,33 +30,71 @@ namespace Stormancer
 
 		TimerThread(const TimerThread&) = delete;
 
-		void schedule(std::function<void()> func, clock_type::time_point when);
+		/// Schedule a function to run once.
+		/// \param func The function to run.
+		/// \param when When to run the function.
+		/// \param runInline Run the function on the timer thread instead of a new task. Only for short functions that don't block.
+		/// \return The id of the timer, to pass to cancel.
+		TimerId schedule(std::function<void()> func, clock_type::time_point when, bool runInline = false);
+
+		/// Schedule a function to run periodically.
+		/// The function is kept by the timer, and not copied between runs.
+		/// The next run is scheduled one period after the end of the previous one.
+		/// \param func The function to run.
+		/// \param period Delay between the end of a run and the start of the next one.
+		/// \param firstRun When to run the function for the first time.
+		/// \param ct Stops the timer when canceled.
+		/// \param runInline Run the function on the timer thread instead of a new task. Only for short functions that don't block.
+		/// \return The id of the timer, to pass to cancel.
+		TimerId schedulePeriodic(std::function<void()> func, std::chrono::milliseconds period, clock_type::time_point firstRun, pplx::cancellation_token ct = pplx::cancellation_token::none(), bool runInline = false);
+
+		/// Cancel a timer.
+		/// A run that already started is not interrupted.
+		/// \return false if the timer already completed or was already canceled.
+		bool cancel(TimerId id);
+
+		/// Number of scheduled timers.
+		std::size_t size();
 
 #pragma endregion
 
 	private:
 
-		struct QueueEntry
-		{
-			clock_type::time_point scheduledTime;
-			std::function<void()> function;
+#pragma region private_classes
 
-			QueueEntry(clock_type::time_point t, std::function<void()> f) :
-				scheduledTime(t),
-				function(f)
-			{}
+		/// State shared with the tasks running the functions, which can outlive the TimerThread.
+		struct State
+		{
+			std::mutex mutex;
+			std::condition_variable cond;
+			TimerWheel wheel;
+			clock_type::time_point start = clock_type::now();
+			uint64 wakeTick = std::numeric_limits<uint64>::max();
+			bool stopRequested = false;
+
+			uint64 toTick(clock_type::time_point time) const;
+		};
 
-			friend bool operator>(const QueueEntry& lhs, const QueueEntry& rhs)
-			{
-				return lhs.scheduledTime > rhs.scheduledTime;
-			}
+		/// An expired timer to run.
+		struct Run
+		{
+			TimerId id;
+			std::function<void()> function;
+			TimerWheel::Timer* periodicTimer;
+			bool runInline;
 		};
 
-		using func_queue_type = std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>>;
+#pragma endregion
 
 #pragma region private_methods
 
-		void _threadLoop();
+		TimerId add(TimerWheel::Timer&& timer);
+
+		static void _threadLoop(std::shared_ptr<State> state);
+
+		static void _runTask(std::shared_ptr<State> state, Run run);
+
+		static void _completePeriodic(State& state, TimerId id);
 
 		void _stop(bool immediate = false);
 
@@ -63,10 +104,7 @@ namespace Stormancer
 
 		static std::unique_ptr<TimerThread> _sInstance;
 
-		std::mutex _mutex;
-		std::condition_variable _cond;
-		func_queue_type _taskQueue;
-		bool _stopRequested = false;
+		std::shared_ptr<State> _state;
 		std::thread _thread;
 
 #pragma endregion
@@ -74,4 +112,4 @@ namespace Stormancer
 
 
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <vector>
+#include "pplx/pplxtasks.h"
+#include "stormancer/stormancerTypes.h"
+
+namespace Stormancer
+{
+	/// Hierarchical timer wheel, counting time in ticks.
+	/// Adding and cancelling a timer is O(1). The timers are stored in pooled nodes, reused by the next timers.
+	/// The first level has 256 slots of one tick, and the next 4 levels have 64 slots each, of 256, 16384, 2^20 and 2^26 ticks.
+	/// The timers of a slot are moved to the lower level when the wheel reaches it.
+	/// This class is not thread-safe.
+	class TimerWheel
+	{
+	public:
+
+		/// Identifies a timer. 0 is never a valid id.
+		using TimerId = uint64;
+
+		/// A timer, as passed to add.
+		struct Timer
+		{
+			/// The function to run when the timer expires.
+			std::function<void()> function;
+
+			/// The tick at which the timer expires.
+			uint64 expiry = 0;
+
+			/// Number of ticks between two runs, or 0 for a single-shot timer.
+			uint64 period = 0;
+
+			/// Run the function on the timer thread, instead of a new task.
+			bool runInline = false;
+
+			/// Stops the timer when canceled.
+			pplx::cancellation_token token = pplx::cancellation_token::none();
+		};
+
+#pragma region public_methods
+
+		TimerWheel();
+
+		~TimerWheel();
+
+		TimerWheel(const TimerWheel&) = delete;
+
+		TimerWheel& operator=(const TimerWheel&) = delete;
+
+		/// Add a timer to the wheel.
+		/// A timer expiring before the current tick expires on the current tick.
+		/// \return The id of the timer.
+		TimerId add(Timer&& timer);
+
+		/// Remove a timer.
+		/// If the timer has expired and was not completed yet, it will be released by complete.
+		/// \return false if the timer doesn't exist anymore.
+		bool cancel(TimerId id);
+
+		/// Process the ticks until and including a tick, and return the expired timers.
+		/// The expired timers stay allocated until complete is called.
+		void advance(uint64 tick, std::vector<TimerId>& expired);
+
+		/// Get an expired timer, or nullptr if the timer doesn't exist anymore.
+		/// The returned timer stays valid until complete is called.
+		Timer* get(TimerId id);
+
+		/// Release an expired timer, or add it back to the wheel if it is periodic.
+		/// \param id The expired timer.
+		/// \param nextExpiry Tick at which a periodic timer runs again.
+		/// \param release Release the timer even if it is periodic.
+		void complete(TimerId id, uint64 nextExpiry, bool release = false);
+
+		/// Get the next tick that advance must process, if timers are pending.
+		/// \return false if no timer is pending.
+		bool nextTick(uint64& tick) const;
+
+		/// The next tick that advance will process.
+		uint64 currentTick() const;
+
+		/// Number of allocated timers, pending or expired.
+		std::size_t size() const;
+
+		/// Number of timers waiting in the wheel.
+		std::size_t pendingCount() const;
+
+		/// Release all the pending timers.
+		/// The expired timers are released when they are completed.
+		void clear();
+
+#pragma endregion
+
+	private:
+
+#pragma region private_classes
+
+		enum class NodeState
+		{
+			Free,
+			Pending,
+			Expired,
+			Cancelled
+		};
+
+		struct Node
+		{
+			Timer timer;
+			Node* prev = nullptr;
+			Node* next = nullptr;
+			Node** slot = nullptr;
+			uint32 index = 0;
+			uint32 generation = 0;
+			NodeState state = NodeState::Free;
+		};
+
+#pragma endregion
+
+#pragma region private_methods
+
+		Node* find(TimerId id);
+
+		void insert(Node* node);
+
+		void unlink(Node* node);
+
+		void release(Node* node);
+
+		void cascade(int level, uint32 index);
+
+#pragma endregion
+
+#pragma region private_members
+
+		static const int rootBits = 8;
+		static const int levelBits = 6;
+		static const int levelsCount = 4;
+		static const uint32 rootSize = 1 << rootBits;
+		static const uint32 levelSize = 1 << levelBits;
+
+		Node* _root[rootSize];
+		Node* _levels[levelsCount][levelSize];
+		std::deque<Node> _nodes;
+		std::vector<uint32> _freeNodes;
+		uint64 _currentTick = 0;
+		std::size_t _pendingCount = 0;
+
+#pragma endregion
+	};
+};
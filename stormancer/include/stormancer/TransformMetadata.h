@@ -6,10 +6,12 @@ namespace Stormancer
 {
 	struct TransformMetadata
 	{
-		const std::map<std::string, std::string> sceneMetadata;
+		const std::map<std::string, std::string>* sceneMetadata = nullptr;
 		std::string sceneId;
 		std::string routeName;
-		int sceneHandle;
-		int routeHandle;
+		int sceneHandle = 0;
+		int routeHandle = 0;
+		/// The message must be encrypted. Precomputed from the scene "crypt" metadata.
+		bool encrypted = false;
 	};
 }
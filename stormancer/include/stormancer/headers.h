@@ -91,6 +91,8 @@
 
 // standard libs
 #include <mutex>
+#include <atomic>
+#include <array>
 #include <condition_variable>
 #include <algorithm>
 #include <chrono>
@@ -24,6 +24,7 @@
 #include "stormancer/Logger/NullLogger.h"
 #include "stormancer/Logger/ConsoleLogger.h"
 #include "stormancer/Logger/FileLogger.h"
+#include "stormancer/Logger/AsyncFileLogger.h"
 #include "stormancer/DefaultPacketDispatcher.h"
 #include "stormancer/IConnection.h"
 #include "stormancer/IConnectionManager.h"
@@ -34,6 +35,8 @@
 #include "stormancer/SystemRequestIDTypes.h"
 #include "stormancer/Packet.h"
 #include "stormancer/PacketProcessorConfig.h"
+#include "stormancer/PacketCapture.h"
+#include "stormancer/PacketReplay.h"
 #include "stormancer/PeerFilter.h"
 #include "stormancer/RequestContext.h"
 #include "stormancer/RequestModuleBuilder.h"
@@ -56,5 +59,6 @@
 
 #include "stormancer/RPC/RpcPlugin.h"
 #include "stormancer/RPC/RpcService.h"
+#include "stormancer/RPC/RpcBatch.h"
 #include "stormancer/RPC/RpcRequest.h"
 #include "stormancer/RPC/RpcRequestContext.h"
@@ -35,28 +35,18 @@ namespace Stormancer
 			std::streamsize dataSize = rdbuf()->in_avail();
 			if (dataPtr != nullptr && dataSize > 0)
 			{
-				ibytestream ibs(dataPtr, dataSize);
-
 				auto ivSize = _aes->ivSize();
-
-				byte* ivPtr = nullptr;
-				if (ivSize > 0)
+				if (dataSize < ivSize)
 				{
-					ivPtr = new byte[ivSize];
-					ibs.read(ivPtr, ivSize);
+					throw std::runtime_error("Encrypted data is smaller than the IV");
 				}
 
-
-				std::streamsize dataLeft = ibs.rdbuf()->in_avail();
+				// The IV is read in place, at the start of the encrypted data
+				byte* ivPtr = (ivSize > 0 ? dataPtr : nullptr);
+				std::streamsize dataLeft = dataSize - ivSize;
 				byte* encryptedPtr = dataPtr + ivSize;
 
 				_aes->decrypt(encryptedPtr, dataLeft, ivPtr, ivSize, stream,_keyId);
-
-
-				if (ivPtr)
-				{
-					delete[] ivPtr;
-				}
 			}
 		}
 	}
@@ -34,19 +34,12 @@ namespace Stormancer
 			{
 				std::streamsize ivSize = _aes->ivSize();
 
-				byte* ivPtr = nullptr;
-
-				ivPtr = new byte[(std::size_t)ivSize];
+				// Large enough for the IV of any IAES implementation, avoids a heap allocation per packet
+				byte ivPtr[256 / 8];
 				_aes->generateRandomIV(ivPtr);
 				stream->write(ivPtr, ivSize);
 
-
 				_aes->encrypt(dataPtr, dataSize, ivPtr, ivSize, stream,_keyId);
-
-				if (ivPtr)
-				{
-					delete[] ivPtr;
-				}
 			}
 		}
 	}
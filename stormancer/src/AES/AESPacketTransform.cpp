@@ -15,17 +15,45 @@ namespace Stormancer
 
 	void AESPacketTransform::onSend(Writer& writer, uint64 peerId, const TransformMetadata& transformMetadata)
 	{
-		std::string str("crypt");
-		if (mapContains(transformMetadata.sceneMetadata, str))
+		if (transformMetadata.encrypted)
 		{
-			auto& cryptedRoutes = transformMetadata.sceneMetadata.at(str);
-			if (cryptedRoutes.find(";ALL;") != std::string::npos || cryptedRoutes.find(";+" + transformMetadata.routeName + ";") != std::string::npos)
+			if (!_aes)
+			{
+				throw std::runtime_error("Can't encrypt the message of route '" + transformMetadata.routeName + "': no AES implementation is available on this platform");
+			}
+
+			auto writerCopy = writer;
+			if (_aes->canEncryptInPlace())
 			{
-				auto writerCopy = writer;
 				writer = [=](obytestream* stream) {
 					(*stream) << (byte)MessageIDTypes::ID_ENCRYPTED;
 
+					// Reserve the IV and the tag around the clear data, which is then encrypted in the send buffer
+					std::streamsize ivSize = _aes->ivSize();
+					std::streamsize tagSize = _aes->tagSize();
+					byte iv[256 / 8];
+					_aes->generateRandomIV(iv);
+					std::streamsize ivOffset = stream->writtenBytesCount();
+					stream->write(iv, ivSize);
+
+					std::streamsize dataOffset = stream->writtenBytesCount();
+					if (writerCopy)
+					{
+						writerCopy(stream);
+					}
+					std::streamsize tagOffset = stream->writtenBytesCount();
+					std::memset(iv, 0, (std::size_t)tagSize);
+					stream->write(iv, tagSize);
 
+					// Get the buffer once everything is written, as it may have been reallocated
+					byte* startPtr = stream->startPtr();
+					_aes->encryptInPlace(startPtr + dataOffset, tagOffset - dataOffset, startPtr + ivOffset, ivSize, startPtr + tagOffset, peerId);
+				};
+			}
+			else
+			{
+				writer = [=](obytestream* stream) {
+					(*stream) << (byte)MessageIDTypes::ID_ENCRYPTED;
 
 					AESEncryptStream aesStream(_aes, peerId);
 					if (writerCopy)
@@ -43,24 +71,25 @@ namespace Stormancer
 		auto bc = stream->rdbuf()->sgetc();
 		if (bc != bytestreambuf::traits_type::eof())
 		{
-
-			//stream->rdbuf()->sbumpc();
-
-
+			if (!_aes)
+			{
+				throw std::runtime_error("Can't decrypt the received message: no AES implementation is available on this platform");
+			}
 
 			byte* dataPtr = stream->startPtr()+1;
 			std::streamsize dataSize = stream->rdbuf()->in_avail();
 
-			AESDecryptStream aesStream(_aes, dataPtr, dataSize, peerId);
-			obytestream os;
-			aesStream.decrypt(&os);
-
-			byte* decryptedPtr = os.startPtr();
-			std::streamsize decryptedSize = os.writtenBytesCount();
+			std::streamsize ivSize = _aes->ivSize();
+			if (dataSize < ivSize)
+			{
+				throw std::runtime_error("Encrypted data is smaller than the IV");
+			}
 
-			std::memcpy(dataPtr, decryptedPtr, (std::size_t)decryptedSize);
-			stream->rdbuf()->pubsetbuf(dataPtr, decryptedSize);
+			// Decrypt in the packet buffer, the IV is read in place
+			byte* encryptedPtr = dataPtr + ivSize;
+			std::streamsize decryptedSize = _aes->decryptInPlace(encryptedPtr, dataSize - ivSize, dataPtr, ivSize, peerId);
 
+			stream->rdbuf()->pubsetbuf(encryptedPtr, decryptedSize);
 		}
 	}
 }
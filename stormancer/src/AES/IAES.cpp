@@ -7,4 +7,32 @@ namespace Stormancer
 	{
 		return 96 / 8;
 	}
+
+	uint16 IAES::tagSize()
+	{
+		return 96 / 8;
+	}
+
+	bool IAES::canEncryptInPlace()
+	{
+		return false;
+	}
+
+	void IAES::encryptInPlace(byte*, std::streamsize, byte*, std::streamsize, byte*, uint64)
+	{
+		throw std::runtime_error("In-place encryption is not supported by this AES implementation");
+	}
+
+	std::streamsize IAES::decryptInPlace(byte* dataPtr, std::streamsize dataSize, byte* ivPtr, std::streamsize ivSize, uint64 keyId)
+	{
+		// Fallback for the implementations which only decrypt into a stream. The decrypted data is never bigger than the encrypted data.
+		obytestream os;
+		decrypt(dataPtr, dataSize, ivPtr, ivSize, &os, keyId);
+		std::streamsize decryptedSize = os.writtenBytesCount();
+		if (decryptedSize > 0)
+		{
+			std::memcpy(dataPtr, os.startPtr(), (std::size_t)decryptedSize);
+		}
+		return decryptedSize;
+	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "stormancer/stdafx.h"
 #include "stormancer/ApiClient.h"
 #include "stormancer/SafeCapture.h"
+#include "stormancer/EndpointRace.h"
 
 namespace Stormancer
 {
@@ -8,6 +9,7 @@ namespace Stormancer
 		: _logger(logger)
 		, _config(config)
 		, _tokenHandler(tokenHandler)
+		, _sceneEndpoints(std::make_shared<SceneEndpointCache>(tokenHandler))
 	{
 		std::srand((uint32)std::time(0));
 	}
@@ -17,11 +19,58 @@ namespace Stormancer
 	}
 
 	pplx::task<SceneEndpoint> ApiClient::getSceneEndpoint(std::string accountId, std::string applicationName, std::string sceneId, pplx::cancellation_token ct)
+	{
+		STORMANCER_LOG(_logger, LogLevel::Trace, "ApiClient", "Scene endpoint data", accountId + ';' + applicationName + ';' + sceneId);
+
+		if (!_config->cacheSceneEndpoints)
+		{
+			return fetchSceneEndpoint(accountId, applicationName, sceneId, ct);
+		}
+
+		// The fetch is shared between the concurrent requests: it must not be canceled with one of them
+		return _sceneEndpoints->get(accountId + ';' + applicationName + ';' + sceneId, STRM_SAFE_CAPTURE([=]()
+		{
+			return fetchSceneEndpoint(accountId, applicationName, sceneId);
+		}), ct);
+	}
+
+	pplx::task<void> ApiClient::prefetchSceneEndpoints(std::string accountId, std::string applicationName, std::vector<std::string> sceneIds, pplx::cancellation_token ct)
+	{
+		if (!_config->cacheSceneEndpoints)
+		{
+			// The tokens would not be kept for the next connections
+			return pplx::task_from_result();
+		}
+
+		auto logger = _logger;
+		std::vector<pplx::task<void>> tasks;
+		for (auto& sceneId : sceneIds)
+		{
+			tasks.push_back(getSceneEndpoint(accountId, applicationName, sceneId, ct)
+				.then([logger, sceneId](pplx::task<SceneEndpoint> t)
+			{
+				try
+				{
+					t.get();
+				}
+				catch (const std::exception& ex)
+				{
+					logger->log(LogLevel::Warn, "ApiClient", "Failed to prefetch the endpoint of scene " + sceneId, ex.what());
+				}
+			}));
+		}
+		return pplx::when_all(tasks.begin(), tasks.end());
+	}
+
+	void ApiClient::invalidateSceneEndpoint(std::string accountId, std::string applicationName, std::string sceneId)
 	{
 		std::stringstream ss;
 		ss << accountId << ';' << applicationName << ';' << sceneId;
-		_logger->log(LogLevel::Trace, "ApiClient", "Scene endpoint data", ss.str());
+		_sceneEndpoints->invalidate(ss.str());
+	}
 
+	pplx::task<SceneEndpoint> ApiClient::fetchSceneEndpoint(std::string accountId, std::string applicationName, std::string sceneId, pplx::cancellation_token ct)
+	{
 		std::vector<std::string> baseUris = _config->getApiEndpoint();
 		auto errors = std::make_shared<std::vector<std::string>>();
 
@@ -46,6 +95,16 @@ namespace Stormancer
 			}
 			return getSceneEndpointImpl(baseUris2, errors, accountId, applicationName, sceneId, ct);
 		}
+		else if (_config->endpointSelectionMode == EndpointSelectionMode::RACE)
+		{
+			auto latencies = _config->endpointLatencies;
+			auto sortedUris = latencies ? latencies->sort(baseUris) : baseUris;
+			std::function<pplx::task<SceneEndpoint>(const std::string&, pplx::cancellation_token)> attempt = STRM_SAFE_CAPTURE([=](const std::string& baseUri, pplx::cancellation_token attemptCt)
+			{
+				return requestSceneEndpoint(baseUri, accountId, applicationName, sceneId, attemptCt);
+			});
+			return raceEndpoints(sortedUris, attempt, std::chrono::milliseconds(_config->endpointRaceDelay), latencies, ct);
+		}
 
 		return pplx::task_from_exception<SceneEndpoint>(std::runtime_error("Error selecting server endpoint."));
 	}
@@ -65,17 +124,30 @@ namespace Stormancer
 
 		auto it = endpoints.begin();
 		std::string baseUri = *it;
-		utility::string_t baseUri2(baseUri.begin(), baseUri.end());
 		endpoints.erase(it);
 
-		auto config = web::http::client::http_client_config();
-		config.set_timeout(std::chrono::seconds(30));
-
-
-		config.set_initHttpLib(_config->shoudInitializeNetworkLibraries);
-
+		return requestSceneEndpoint(baseUri, accountId, applicationName, sceneId, ct)
+			.then([=](pplx::task<SceneEndpoint> task)
+		{
+			try
+			{
+				return pplx::task_from_result(task.get());
+			}
+			catch (const pplx::task_canceled&)
+			{
+				throw;
+			}
+			catch (const std::exception& ex)
+			{
+				(*errors).push_back(ex.what());
+				return getSceneEndpointImpl(endpoints, errors, accountId, applicationName, sceneId, ct);
+			}
+		}, ct);
+	}
 
-		web::http::client::http_client client(baseUri2, config);
+	pplx::task<SceneEndpoint> ApiClient::requestSceneEndpoint(std::string baseUri, std::string accountId, std::string applicationName, std::string sceneId, pplx::cancellation_token ct)
+	{
+		auto client = getHttpClient(baseUri);
 		web::http::http_request request(web::http::methods::POST);
 		std::string relativeUri = "/" + accountId + "/" + applicationName + "/scenes/" + sceneId + "/token";
 		utility::string_t relativeUri2(relativeUri.begin(), relativeUri.end());
@@ -88,7 +160,7 @@ namespace Stormancer
 		request.headers().add(U("x-version"), U("2"));
 
 
-		return client.request(request, ct)
+		return client->request(request, ct)
 			.then([=](pplx::task<web::http::http_response> task)
 		{
 			web::http::http_response response;
@@ -96,45 +168,47 @@ namespace Stormancer
 			{
 				response = task.get();
 			}
+			catch (const pplx::task_canceled&)
+			{
+				throw;
+			}
 			catch (const std::exception& ex)
 			{
 				auto msgStr = "Can't reach the server endpoint. " + baseUri;
 				_logger->log(LogLevel::Warn, "ApiClient", msgStr, ex.what());
-				(*errors).push_back("[" + msgStr + ":" + ex.what() + "]");
-				return getSceneEndpointImpl(endpoints, errors, accountId, applicationName, sceneId, ct);
+				throw std::runtime_error("[" + msgStr + ":" + ex.what() + "]");
 			}
 
 			try
 			{
 				uint16 statusCode = response.status_code();
 				auto msgStr = "HTTP request on '" + baseUri + "' returned status code " + std::to_string(statusCode);
-				_logger->log(LogLevel::Trace, "ApiClient", msgStr);
+				STORMANCER_LOG(_logger, LogLevel::Trace, "ApiClient", msgStr);
 				concurrency::streams::stringstreambuf ss;
 				return response.body().read_to_end(ss)
 					.then([=](size_t)
 				{
 					
 					std::string responseText = ss.collection();
-					_logger->log(LogLevel::Trace, "ApiClient", "Response", responseText);
+					STORMANCER_LOG(_logger, LogLevel::Trace, "ApiClient", "Response", responseText);
 
 					if (ensureSuccessStatusCode(statusCode))
 					{
 						auto headers = response.headers();
 						if (headers[U("x-version")] == U("2"))
 						{
-							_logger->log(LogLevel::Trace, "ApiClient", "Get token API version : 2");
-							return pplx::task_from_result(_tokenHandler->getSceneEndpointInfo(responseText));
+							STORMANCER_LOG(_logger, LogLevel::Trace, "ApiClient", "Get token API version : 2");
+							return _tokenHandler->getSceneEndpointInfo(responseText);
 						}
 						else
 						{
-							_logger->log(LogLevel::Trace, "ApiClient", "Get token API version : 1");
-							return pplx::task_from_result(_tokenHandler->decodeToken(responseText));
+							STORMANCER_LOG(_logger, LogLevel::Trace, "ApiClient", "Get token API version : 1");
+							return _tokenHandler->decodeToken(responseText);
 						}
 					}
 					else
 					{
-						(*errors).push_back("[" + msgStr + ":" + std::to_string(statusCode) + "]");
-						return getSceneEndpointImpl(endpoints, errors, accountId, applicationName, sceneId, ct);
+						throw std::runtime_error("[" + msgStr + ":" + std::to_string(statusCode) + "]");
 					}
 				}, ct);
 			}
@@ -145,6 +219,23 @@ namespace Stormancer
 		}, ct);
 	}
 
+	std::shared_ptr<web::http::client::http_client> ApiClient::getHttpClient(const std::string& baseUri)
+	{
+		std::lock_guard<std::mutex> lg(_httpClientsMutex);
+		auto& client = _httpClients[baseUri];
+		if (!client)
+		{
+			utility::string_t baseUri2(baseUri.begin(), baseUri.end());
+
+			auto config = web::http::client::http_client_config();
+			config.set_timeout(std::chrono::seconds(30));
+			config.set_initHttpLib(_config->shoudInitializeNetworkLibraries);
+
+			client = std::make_shared<web::http::client::http_client>(baseUri2, config);
+		}
+		return client;
+	}
+
 	pplx::task<web::http::http_response> ApiClient::requestWithRetries(std::function<web::http::http_request(std::string)> requestFactory, pplx::cancellation_token ct)
 	{
 		auto errors = std::make_shared<std::vector<std::string>>();
@@ -5,60 +5,61 @@
 namespace Stormancer
 {
 	ChannelUidStore::ChannelUidStore()
+		: _useCounter(0)
 	{
-		auto now = std::chrono::steady_clock::now();;
-		for (int channelUid = 0; channelUid < channelUidsCount; channelUid++)
-		{
-			_channelsInfos[channelUid].lastUsed = now;
-		}
 	}
 
 	int ChannelUidStore::getChannelUid(const std::string& channelIdentifier)
 	{
+		uint64 identifierHash = hash(channelIdentifier);
+
 		// Look for reserved channelUid by channelIdentifier
 
-		int channelUid = getReservedChannel(channelIdentifier);
+		int channelUid = getReservedChannel(identifierHash);
 		if (channelUid == -1)
 		{
-			// Get the older used channel
-
-			channelUid = getOlderChannel();
+			std::lock_guard<std::mutex> lg(_channelsInfosMutex);
 
-			// This has to return a correct value
+			// Another thread may have reserved it meanwhile
 
+			channelUid = getReservedChannel(identifierHash);
 			if (channelUid == -1)
 			{
-				throw std::runtime_error("No channelUid available");
-			}
-
-			// Reserve the channelUid for this channelIdentifier
-
-			{
-				std::lock_guard<std::mutex> lg(_channelsInfosMutex);
+				// Reserve the older used channelUid for this channelIdentifier
 
-				_channelsInfos[channelUid].channelIdentifier = channelIdentifier;
+				channelUid = getOlderChannel();
+				_channelsInfos[channelUid].identifierHash.store(identifierHash, std::memory_order_relaxed);
 			}
 		}
 
-		// Update the channelUid last used date
-
-		{
-			std::lock_guard<std::mutex> lg(_channelsInfosMutex);
-
-			_channelsInfos[channelUid].lastUsed = std::chrono::steady_clock::now();
-		}
+		touch(channelUid);
 
 		return channelUid;
 	}
 
-	int ChannelUidStore::getReservedChannel(const std::string& channelIdentifier)
+	void ChannelUidStore::touch(int channelUid)
+	{
+		_channelsInfos[channelUid].lastUsed.store(_useCounter.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	uint64 ChannelUidStore::hash(const std::string& channelIdentifier)
 	{
-		std::lock_guard<std::mutex> lg(_channelsInfosMutex);
+		// FNV-1a. Two identifiers with the same hash share their channel, which only affects the ordering of their messages.
+		uint64 result = 14695981039346656037ULL;
+		for (char c : channelIdentifier)
+		{
+			result ^= (byte)c;
+			result *= 1099511628211ULL;
+		}
+		// 0 marks the free channels
+		return (result != 0 ? result : 1);
+	}
 
+	int ChannelUidStore::getReservedChannel(uint64 identifierHash) const
+	{
 		for (int channelUid = 0; channelUid < channelUidsCount; channelUid++)
 		{
-			auto& channelInfo = _channelsInfos[channelUid];
-			if (channelInfo.channelIdentifier == channelIdentifier)
+			if (_channelsInfos[channelUid].identifierHash.load(std::memory_order_relaxed) == identifierHash)
 			{
 				return channelUid;
 			}
@@ -67,19 +68,17 @@ namespace Stormancer
 		return -1;
 	}
 
-	int ChannelUidStore::getOlderChannel()
+	int ChannelUidStore::getOlderChannel() const
 	{
-		int minChannelUid = -1;
-		auto minDate = std::chrono::steady_clock::now();
-
-		std::lock_guard<std::mutex> lg(_channelsInfosMutex);
+		int minChannelUid = 0;
+		uint64 minUse = _channelsInfos[0].lastUsed.load(std::memory_order_relaxed);
 
-		for (int channelUid = 0; channelUid < channelUidsCount; channelUid++)
+		for (int channelUid = 1; channelUid < channelUidsCount; channelUid++)
 		{
-			auto& channelInfo = _channelsInfos[channelUid];
-			if (channelInfo.lastUsed < minDate)
+			uint64 lastUsed = _channelsInfos[channelUid].lastUsed.load(std::memory_order_relaxed);
+			if (lastUsed < minUse)
 			{
-				minDate = channelInfo.lastUsed;
+				minUse = lastUsed;
 				minChannelUid = channelUid;
 			}
 		}
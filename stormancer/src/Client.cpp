@@ -12,6 +12,7 @@
 #include "stormancer/P2P/P2PRequestModule.h"
 #include "stormancer/SafeCapture.h"
 #include "stormancer/KeyStore.h"
+#include "stormancer/EndpointRace.h"
 
 
 
@@ -62,7 +63,7 @@ namespace Stormancer
 	{
 		ConfigureContainer(this->dependencyResolver(), config);
 
-		logger()->log(LogLevel::Trace, "Client", "Creating the client...");
+		STORMANCER_LOG(logger(), LogLevel::Trace, "Client", "Creating the client...");
 
 		std::vector<std::shared_ptr<IRequestModule>> modules{ std::dynamic_pointer_cast<IRequestModule>(dependencyResolver()->resolve<P2PRequestModule>()) };
 
@@ -101,14 +102,14 @@ namespace Stormancer
 
 
 
-		logger()->log(LogLevel::Trace, "Client", "Client created");
+		STORMANCER_LOG(logger(), LogLevel::Trace, "Client", "Client created");
 	}
 
 	pplx::task<void> Client::destroy()
 	{
 		auto logger = _dependencyResolver->resolve<ILogger>();
 
-		logger->log(LogLevel::Trace, "Client", "Deleting client...");
+		STORMANCER_LOG(logger, LogLevel::Trace, "Client", "Deleting client...");
 
 		auto disconnectTask = disconnect().then([logger](pplx::task<void> t) {
 			try
@@ -117,7 +118,7 @@ namespace Stormancer
 			}
 			catch (const std::exception& ex)
 			{
-				logger->log(LogLevel::Trace, "Client", "Ignore client disconnection failure", ex.what());
+				STORMANCER_LOG(logger, LogLevel::Trace, "Client", "Ignore client disconnection failure", ex.what());
 			}
 		});
 
@@ -174,7 +175,7 @@ namespace Stormancer
 				{
 					logger->log(LogLevel::Warn, "Client", "Client destroy failed", ex.what());
 				}
-				logger->log(LogLevel::Trace, "Client", "Running shared_ptr finalizer.");
+				STORMANCER_LOG(logger, LogLevel::Trace, "Client", "Running shared_ptr finalizer.");
 				client->clean();
 				delete client;
 			});
@@ -188,7 +189,7 @@ namespace Stormancer
 	{
 		if (!_initialized)
 		{
-			logger()->log(LogLevel::Trace, "Client", "Initializing client...");
+			STORMANCER_LOG(logger(), LogLevel::Trace, "Client", "Initializing client...");
 			auto transport = _dependencyResolver->resolve<ITransport>();
 
 			_metadata["serializers"] = "msgpack/array";
@@ -211,7 +212,7 @@ namespace Stormancer
 			transport->onPacketReceived(createSafeCapture(weak_from_this(), [this](Packet_ptr packet) {
 				transport_packetReceived(packet);
 			}));
-			logger()->log(LogLevel::Trace, "Client", "Client initialized");
+			STORMANCER_LOG(logger(), LogLevel::Trace, "Client", "Client initialized");
 		}
 	}
 
@@ -275,7 +276,7 @@ namespace Stormancer
 
 	pplx::task<Scene_ptr> Client::getConnectedScene(const std::string& sceneId, pplx::cancellation_token ct)
 	{
-		logger()->log(LogLevel::Trace, "Client", "Get connected scene.", sceneId);
+		STORMANCER_LOG(logger(), LogLevel::Trace, "Client", "Get connected scene.", sceneId);
 
 		if (sceneId.empty())
 		{
@@ -307,7 +308,7 @@ namespace Stormancer
 
 	pplx::task<Scene_ptr> Client::getPublicScene(const std::string& sceneId, pplx::cancellation_token ct)
 	{
-		logger()->log(LogLevel::Trace, "Client", "Get public scene.", sceneId);
+		STORMANCER_LOG(logger(), LogLevel::Trace, "Client", "Get public scene.", sceneId);
 
 		if (sceneId.empty())
 		{
@@ -341,7 +342,26 @@ namespace Stormancer
 			}), ct)
 				.then(createSafeCapture(weak_from_this(), [this, sceneId, ct](SceneEndpoint sep)
 			{
-				return getSceneInternal(sceneId, sep, ct);
+				std::weak_ptr<ApiClient> wApiClient = _dependencyResolver->resolve<ApiClient>();
+				auto accountId = _accountId;
+				auto applicationName = _applicationName;
+				return getSceneInternal(sceneId, sep, ct)
+					.then([wApiClient, accountId, applicationName, sceneId](pplx::task<Scene_ptr> t)
+				{
+					try
+					{
+						return t.get();
+					}
+					catch (...)
+					{
+						// The cached endpoint may be the cause of the failure (revoked token, moved scene...)
+						if (auto apiClient = wApiClient.lock())
+						{
+							apiClient->invalidateSceneEndpoint(accountId, applicationName, sceneId);
+						}
+						throw;
+					}
+				});
 			}), ct);
 
 			cScene.task = task;
@@ -350,9 +370,19 @@ namespace Stormancer
 		}
 	}
 
+	pplx::task<void> Client::prefetchPublicScenes(const std::vector<std::string>& sceneIds, pplx::cancellation_token ct)
+	{
+		return ensureNetworkAvailable()
+			.then(createSafeCapture(weak_from_this(), [this, sceneIds, ct]()
+		{
+			auto apiClient = _dependencyResolver->resolve<ApiClient>();
+			return apiClient->prefetchSceneEndpoints(_accountId, _applicationName, sceneIds, ct);
+		}), ct);
+	}
+
 	pplx::task<Scene_ptr> Client::getPrivateScene(const std::string& sceneToken, pplx::cancellation_token ct)
 	{
-		logger()->log(LogLevel::Trace, "Client", "Get private scene.", sceneToken);
+		STORMANCER_LOG(logger(), LogLevel::Trace, "Client", "Get private scene.", sceneToken);
 
 		if (sceneToken.empty())
 		{
@@ -394,7 +424,7 @@ namespace Stormancer
 				try
 				{
 					//Start transport and execute plugin event
-					logger()->log(LogLevel::Trace, "Client", "Starting transport", "port:" + std::to_string(_config->clientSDKPort) + "; maxPeers:" + std::to_string((uint16)_maxPeers + 1));
+					STORMANCER_LOG(logger(), LogLevel::Trace, "Client", "Starting transport", "port:" + std::to_string(_config->clientSDKPort) + "; maxPeers:" + std::to_string((uint16)_maxPeers + 1));
 					auto transport = _dependencyResolver->resolve<ITransport>();
 					transport->start("client", _dependencyResolver->resolve<IConnectionManager>(), _cts.get_token(), _config->clientSDKPort, (uint16)_maxPeers + 1);
 					for (auto plugin : _plugins)
@@ -403,15 +433,14 @@ namespace Stormancer
 					}
 
 					//Connect to server
-					std::string endpointUrl;
+					std::vector<std::string> endpointUrls;
 					if (endpoint.version == 1)
 					{
-						endpointUrl = endpoint.tokenData.Endpoints.at(transport->name());
+						endpointUrls.push_back(endpoint.tokenData.Endpoints.at(transport->name()));
 					}
 					else
 					{
-						auto& endpoints = endpoint.getTokenResponse.endpoints.at(transport->name());
-						endpointUrl = endpoints.at(std::rand() % endpoints.size());
+						endpointUrls = endpoint.getTokenResponse.endpoints.at(transport->name());
 						if (_config->encryptionEnabled)
 						{
 							_metadata["encryption"] = endpoint.getTokenResponse.encryption.token;
@@ -427,10 +456,31 @@ namespace Stormancer
 
 					if (this->_config->forceTransportEndpoint != "")
 					{
-						endpointUrl = this->_config->forceTransportEndpoint;
+						endpointUrls = { this->_config->forceTransportEndpoint };
+					}
+
+					pplx::task<std::shared_ptr<IConnection>> connectTask;
+					if (_config->endpointSelectionMode == EndpointSelectionMode::RACE && endpointUrls.size() > 1)
+					{
+						auto latencies = _config->endpointLatencies;
+						auto sortedUrls = latencies ? latencies->sort(endpointUrls) : endpointUrls;
+						STORMANCER_LOG(logger(), LogLevel::Trace, "Client", "Racing transport connections to server", vectorJoin(sortedUrls, ", "));
+						std::function<pplx::task<std::shared_ptr<IConnection>>(const std::string&, pplx::cancellation_token)> attempt = [transport](const std::string& endpointUrl, pplx::cancellation_token attemptCt) {
+							return transport->connect(endpointUrl, attemptCt);
+						};
+						// A connection established after the winner is not needed
+						std::function<void(std::shared_ptr<IConnection>)> discard = [](std::shared_ptr<IConnection> connection) {
+							connection->close("Another server endpoint answered first");
+						};
+						connectTask = raceEndpoints(sortedUrls, attempt, std::chrono::milliseconds(_config->endpointRaceDelay), latencies, ct, discard);
+					}
+					else
+					{
+						auto endpointUrl = endpointUrls.at(std::rand() % endpointUrls.size());
+						STORMANCER_LOG(logger(), LogLevel::Trace, "Client", "Connecting transport to server", endpointUrl);
+						connectTask = transport->connect(endpointUrl, ct);
 					}
-					logger()->log(LogLevel::Trace, "Client", "Connecting transport to server", endpointUrl);
-					_connectionTask = transport->connect(endpointUrl, ct)
+					_connectionTask = connectTask
 						.then(createSafeCapture(weak_from_this(), [this](std::weak_ptr<IConnection> connectionWeak)
 					{
 						auto connection = connectionWeak.lock();
@@ -558,7 +608,7 @@ namespace Stormancer
 	{
 		ct = getLinkedCancellationToken(ct);
 
-		logger()->log(LogLevel::Trace, "Client", "Get scene " + sceneId, sep.token);
+		STORMANCER_LOG(logger(), LogLevel::Trace, "Client", "Get scene " + sceneId, sep.token);
 
 		return ensureConnectedToServer(sep, ct)
 			.then(createSafeCapture(weak_from_this(), [this, sep, ct]()
@@ -572,7 +622,7 @@ namespace Stormancer
 			parameter.Metadata = serverConnection->metadata();
 			parameter.Token = sep.token;
 
-			logger()->log(LogLevel::Trace, "Client", "Send SceneInfosRequestDto");
+			STORMANCER_LOG(logger(), LogLevel::Trace, "Client", "Send SceneInfosRequestDto");
 			return sendSystemRequest<SceneInfosDto>((byte)SystemRequestIDTypes::ID_GET_SCENE_INFOS, parameter, ct);
 		}), ct)
 			.then(createSafeCapture(weak_from_this(), [this, ct](SceneInfosDto sceneInfos)
@@ -590,7 +640,7 @@ namespace Stormancer
 			}
 			ss << "]";
 
-			logger()->log(LogLevel::Trace, "Client", "SceneInfosDto received", ss.str());
+			STORMANCER_LOG(logger(), LogLevel::Trace, "Client", "SceneInfosDto received", ss.str());
 
 			auto serverConnection = _serverConnection.lock();
 			if (!serverConnection)
@@ -607,7 +657,7 @@ namespace Stormancer
 		}), ct)
 			.then(createSafeCapture(weak_from_this(), [this, sceneId, sep](SceneInfosDto sceneInfos)
 		{
-			logger()->log(LogLevel::Trace, "Client", "Return the scene", sceneId);
+			STORMANCER_LOG(logger(), LogLevel::Trace, "Client", "Return the scene", sceneId);
 			auto scene = std::make_shared<Scene>(_serverConnection, weak_from_this(), sceneId, sep.token, sceneInfos, _dependencyResolver);
 			scene->initialize();
 			for (auto plugin : _plugins)
@@ -625,7 +675,7 @@ namespace Stormancer
 	pplx::task<void> Client::updateServerMetadata(pplx::cancellation_token ct)
 	{
 		auto loggerPtr = logger();
-		loggerPtr->log(LogLevel::Trace, "Client", "Update server metadata");
+		STORMANCER_LOG(loggerPtr, LogLevel::Trace, "Client", "Update server metadata");
 
 		ct = getLinkedCancellationToken(ct);
 
@@ -642,7 +692,7 @@ namespace Stormancer
 		}), PacketPriority::MEDIUM_PRIORITY, ct)
 			.then([loggerPtr](Packet_ptr)
 		{
-			loggerPtr->log(LogLevel::Trace, "Client", "Updated server metadata");
+			STORMANCER_LOG(loggerPtr, LogLevel::Trace, "Client", "Updated server metadata");
 		}, ct);
 	}
 
@@ -711,7 +761,7 @@ namespace Stormancer
 				{
 					plugin->sceneConnected(scene.get());
 				}
-				logger()->log(LogLevel::Debug, "client", "Scene connected.", scene->id());
+				STORMANCER_LOG(logger(), LogLevel::Debug, "client", "Scene connected.", scene->id());
 				return scene;
 			}), ct);
 		}), ct);
@@ -763,7 +813,7 @@ namespace Stormancer
 				}
 				catch (const std::exception& ex)
 				{
-					loggerPtr->log(LogLevel::Trace, "Client", "Ignore client disconnection failure", ex.what());
+					STORMANCER_LOG(loggerPtr, LogLevel::Trace, "Client", "Ignore client disconnection failure", ex.what());
 				}
 			});
 		}
@@ -814,7 +864,7 @@ namespace Stormancer
 				plugin->sceneDisconnected(scene.get());
 			}
 
-			logger()->log(LogLevel::Debug, "client", "Scene disconnected", sceneId);
+			STORMANCER_LOG(logger(), LogLevel::Debug, "client", "Scene disconnected", sceneId);
 
 			scene->setConnectionState(ConnectionState::Disconnected);
 		}), timeOutToken);
@@ -12,7 +12,8 @@ namespace Stormancer
 		scheduler = std::make_shared<DefaultScheduler>();
 		transportFactory = _defaultTransportFactory;
 		dispatcher = [](DependencyResolver* dr) {
-			return std::make_shared<DefaultPacketDispatcher>(dr->resolve<ILogger>());
+			auto config = dr->resolve<Configuration>();
+			return std::make_shared<DefaultPacketDispatcher>(dr->resolve<ILogger>(), config->asynchronousDispatch, config->packetDispatchMode, config->dispatchWorkersCount);
 		};
 		addServerEndpoint(endpoint);
 		_plugins.push_back(new RpcPlugin());
@@ -80,6 +80,8 @@ void Stormancer::ConfigureContainer(DependencyResolver* dr, Configuration_ptr co
 
 #if defined(_WIN32)
 		return std::make_shared<AESWindows>(dependencyResolver->resolve<KeyStore>());
+#elif defined(__linux__) && !defined(__ANDROID__)
+		return std::make_shared<AESOpenSSL>(dependencyResolver->resolve<KeyStore>());
 
 
 
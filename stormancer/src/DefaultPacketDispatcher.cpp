@@ -1,38 +1,84 @@
 #include "stormancer/stdafx.h"
 #include "stormancer/DefaultPacketDispatcher.h"
 #include "stormancer/Logger/ILogger.h"
+#include "stormancer/MessageIDTypes.h"
 
 namespace Stormancer
 {
-	DefaultPacketDispatcher::DefaultPacketDispatcher(ILogger_ptr logger, bool asyncDispatch)
-		: _asyncDispatch(asyncDispatch)
-		, _logger(logger)
+	DefaultPacketDispatcher::DefaultPacketDispatcher(ILogger_ptr logger, bool asyncDispatch, PacketDispatchMode mode, int workersCount)
+		: _state(std::make_shared<HandlersState>(logger))
+		, _frozen(false)
+		, _asyncDispatch(asyncDispatch)
+		, _mode(mode)
 	{
+		if (_asyncDispatch && _mode == PacketDispatchMode::WORKER_POOL)
+		{
+			for (int i = 0; i < std::max(workersCount, 1); i++)
+			{
+				auto worker = std::make_shared<Worker>();
+				auto state = _state;
+				worker->thread = std::thread([state, worker]() {
+					runWorker(state, worker);
+				});
+				_workers.push_back(worker);
+			}
+		}
 	}
 
 	DefaultPacketDispatcher::~DefaultPacketDispatcher()
 	{
-		for (auto pair : _handlers)
+		stopWorkers();
+	}
+
+	DefaultPacketDispatcher::HandlersState::HandlersState(ILogger_ptr logger)
+		: logger(logger)
+	{
+		handlers.fill(nullptr);
+
+		handlers[(byte)MessageIDTypes::ID_BATCH] = new handlerFunction([this](Packet_ptr packet) {
+			dispatchBatch(packet);
+			return true;
+		});
+	}
+
+	DefaultPacketDispatcher::HandlersState::~HandlersState()
+	{
+		for (auto& handler : handlers)
 		{
-			delete pair.second;
+			delete handler;
+			handler = nullptr;
 		}
-		_handlers.clear();
 
-		for (auto processor : _defaultProcessors)
+		for (auto processor : defaultProcessors)
 		{
 			delete processor;
 		}
-		_defaultProcessors.clear();
+		defaultProcessors.clear();
 	}
 
 	void DefaultPacketDispatcher::dispatchPacket(Packet_ptr packet)
 	{
-		if (_asyncDispatch)
+		_frozen = true;
+
+		if (!_workers.empty())
+		{
+			// Hash the connection id so the packets of a connection are always dispatched by the same worker
+			uint64 connectionId = (packet->connection ? packet->connection->id() : 0);
+			auto& worker = _workers[((connectionId * 0x9E3779B97F4A7C15ULL) >> 32) % _workers.size()];
+			{
+				std::lock_guard<std::mutex> lg(worker->mutex);
+				worker->pending.push_back(packet);
+			}
+			worker->depth++;
+			worker->condition.notify_one();
+		}
+		else if (_asyncDispatch)
 		{
-			pplx::create_task([=]() {
-				dispatchImpl(packet);
+			auto state = _state;
+			pplx::create_task([state, packet]() {
+				state->dispatch(packet);
 			})
-				.then([this](pplx::task<void> t)
+				.then([state](pplx::task<void> t)
 			{
 				try
 				{
@@ -40,18 +86,18 @@ namespace Stormancer
 				}
 				catch (const std::exception& ex)
 				{
-					_logger->log(LogLevel::Error, "client.dispatchPacket", "Exception unhandled in dispatchPacketImpl :" + std::string(ex.what()));
+					state->logger->log(LogLevel::Error, "client.dispatchPacket", "Exception unhandled in dispatchPacketImpl :" + std::string(ex.what()));
 					
 				}
 			});
 		}
 		else
 		{
-			dispatchImpl(packet);
+			_state->dispatch(packet);
 		}
 	}
 
-	void DefaultPacketDispatcher::dispatchImpl(Packet_ptr packet)
+	void DefaultPacketDispatcher::HandlersState::dispatch(Packet_ptr packet)
 	{
 		bool processed = false;
 		int count = 0;
@@ -59,9 +105,9 @@ namespace Stormancer
 		while (!processed && count < 40) // Max 40 layers
 		{
 			*(packet->stream) >> msgType;
-			if (mapContains(_handlers, msgType))
+			handlerFunction* handler = handlers[msgType];
+			if (handler)
 			{
-				handlerFunction* handler = _handlers[msgType];
 				processed = (*handler)(packet);
 				count++;
 			}
@@ -71,7 +117,7 @@ namespace Stormancer
 			}
 		}
 
-		for (auto processor : _defaultProcessors)
+		for (auto processor : defaultProcessors)
 		{
 			if ((*processor)(msgType, packet))
 			{
@@ -86,9 +132,109 @@ namespace Stormancer
 		}
 	}
 
+	void DefaultPacketDispatcher::HandlersState::dispatchBatch(Packet_ptr packet)
+	{
+		// ID_BATCH frame: repeated (uint16 length, message), each message starting with its own id.
+		// The messages are dispatched in order, reading the buffer of the batch without copying it.
+		auto stream = packet->stream;
+		while (stream->good() && stream->size() - stream->totalReadBytesCount() >= (std::streamsize)sizeof(uint16))
+		{
+			uint16 length = 0;
+			(*stream) >> length;
+			if (!stream->good() || stream->size() - stream->totalReadBytesCount() < (std::streamsize)length)
+			{
+				throw std::runtime_error("Truncated message in a batch.");
+			}
+
+			// The message keeps the batch, and its buffer, alive
+			Packet_ptr message = batchPacketPool->acquire(packet->connection, stream->currentPtr(), (std::streamsize)length, packet);
+			stream->seekg(length, std::ios_base::cur);
+			dispatch(message);
+		}
+	}
+
+	void DefaultPacketDispatcher::runWorker(std::shared_ptr<HandlersState> state, std::shared_ptr<Worker> worker)
+	{
+		// The worker only accesses the state and the worker, which it owns: a handler may destroy the dispatcher
+		// Swapped with the pending packets, so the vectors capacities are reused and dispatching does not allocate
+		std::vector<Packet_ptr> batch;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(worker->mutex);
+				worker->condition.wait(lock, [&worker]() {
+					return worker->stopping || !worker->pending.empty();
+				});
+				if (worker->stopping)
+				{
+					return;
+				}
+				batch.swap(worker->pending);
+			}
+
+			for (auto& packet : batch)
+			{
+				// The dispatcher may have been destroyed by a handler
+				if (worker->stopping)
+				{
+					return;
+				}
+				try
+				{
+					state->dispatch(packet);
+				}
+				catch (const std::exception& ex)
+				{
+					state->logger->log(LogLevel::Error, "client.dispatchPacket", "Exception unhandled in dispatchPacketImpl :" + std::string(ex.what()));
+				}
+				packet.reset();
+				worker->depth--;
+			}
+			batch.clear();
+		}
+	}
+
+	void DefaultPacketDispatcher::stopWorkers()
+	{
+		for (auto& worker : _workers)
+		{
+			{
+				std::lock_guard<std::mutex> lg(worker->mutex);
+				worker->stopping = true;
+			}
+			worker->condition.notify_one();
+
+			if (worker->thread.get_id() == std::this_thread::get_id())
+			{
+				// The dispatcher is destroyed by one of its handlers: the worker returns after this packet, and releases the state
+				worker->thread.detach();
+			}
+			else
+			{
+				worker->thread.join();
+			}
+		}
+		_workers.clear();
+	}
+
+	std::vector<std::size_t> DefaultPacketDispatcher::queueDepths() const
+	{
+		std::vector<std::size_t> depths;
+		depths.reserve(_workers.size());
+		for (auto& worker : _workers)
+		{
+			depths.push_back(worker->depth);
+		}
+		return depths;
+	}
+
 	void DefaultPacketDispatcher::addProcessor(std::shared_ptr<IPacketProcessor> processor)
 	{
-		PacketProcessorConfig config(_handlers, _defaultProcessors);
+		if (_frozen)
+		{
+			throw std::logic_error("Processors can't be added once packets are dispatched");
+		}
+		PacketProcessorConfig config(_state->handlers, _state->defaultProcessors);
 		processor->registerProcessor(config);
 	}
 };
@@ -18,33 +18,11 @@ namespace Stormancer
 			throw std::out_of_range("Scheduler periodic delay must be positive.");
 		}
 		
-		std::weak_ptr<TimerThread> weakTimer(_timer);
-		auto delayMs = std::chrono::milliseconds(delay);
-		_timer->schedule([=]()
-		{
-			periodicFunc(work, ct, weakTimer, delayMs);
-		}, clock_type::now());
+		_timer->schedulePeriodic(work, std::chrono::milliseconds(delay), clock_type::now(), ct);
 	}
 
 	void DefaultScheduler::schedule(clock_type::time_point when, std::function<void()> work)
 	{
 		_timer->schedule(work, when);
 	}
-
-	void DefaultScheduler::periodicFunc(std::function<void()> work, pplx::cancellation_token ct, std::weak_ptr<TimerThread> weakTimer, std::chrono::milliseconds delay)
-	{
-		if (!ct.is_canceled())
-		{
-			work();
-
-			auto timer = weakTimer.lock();
-			if (timer)
-			{
-				timer->schedule([=]()
-				{
-					periodicFunc(work, ct, weakTimer, delay);
-				}, clock_type::now() + delay);
-			}
-		}
-	}
 }
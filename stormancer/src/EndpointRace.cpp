@@ -0,0 +1,61 @@
+#include "stormancer/stdafx.h"
+#include "stormancer/EndpointRace.h"
+
+namespace Stormancer
+{
+	void EndpointLatencies::recordSuccess(const std::string& endpoint, std::chrono::milliseconds latency)
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		auto& entry = _entries[endpoint];
+		if (entry.latency < 0 || entry.failed)
+		{
+			entry.latency = latency.count();
+		}
+		else
+		{
+			entry.latency = (entry.latency * 3 + latency.count()) / 4;
+		}
+		entry.failed = false;
+	}
+
+	void EndpointLatencies::recordFailure(const std::string& endpoint)
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		_entries[endpoint].failed = true;
+	}
+
+	int64 EndpointLatencies::latency(const std::string& endpoint) const
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		auto it = _entries.find(endpoint);
+		if (it == _entries.end() || it->second.failed)
+		{
+			return -1;
+		}
+		return it->second.latency;
+	}
+
+	std::vector<std::string> EndpointLatencies::sort(std::vector<std::string> endpoints) const
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+
+		// Measured endpoints by latency, then the unknown endpoints, then the failed ones
+		auto rank = [this](const std::string& endpoint) -> std::pair<int, int64> {
+			auto it = _entries.find(endpoint);
+			if (it == _entries.end())
+			{
+				return { 1, 0 };
+			}
+			if (it->second.failed)
+			{
+				return { 2, 0 };
+			}
+			return { 0, it->second.latency };
+		};
+
+		std::stable_sort(endpoints.begin(), endpoints.end(), [&rank](const std::string& e1, const std::string& e2) {
+			return rank(e1) < rank(e2);
+		});
+		return endpoints;
+	}
+}
@@ -38,13 +38,22 @@ namespace Stormancer
 
 
 
+	MainThreadActionDispatcher::~MainThreadActionDispatcher()
+	{
+		deleteNodes(_posted.exchange(nullptr));
+		deleteNodes(_pendingHead);
+	}
+
 	void MainThreadActionDispatcher::start()
 	{
 		std::lock_guard<std::mutex> l(_mutex);
 
-		_isRunning = true;
+		deleteNodes(_posted.exchange(nullptr));
+		deleteNodes(_pendingHead);
+		_pendingHead = nullptr;
+		_pendingTail = nullptr;
 		_stopRequested = false;
-		_actions = std::queue<std::function<void()>>();
+		_isRunning = true;
 	}
 
 	//Stop will be effective only on the next execution of "run"
@@ -63,11 +72,18 @@ namespace Stormancer
 
 	void MainThreadActionDispatcher::post(const std::function<void(void)>& action)
 	{
-		std::lock_guard<std::mutex> l(_mutex);
-
 		if (_isRunning)
 		{
-			_actions.push(action);
+			auto node = new ActionNode{ action, _posted.load(std::memory_order_relaxed) };
+			do
+			{
+				// The list is closed by update when the dispatcher stops: the action would never run
+				if (node->next == closedList())
+				{
+					delete node;
+					throw std::logic_error("Dispatcher isn't running");
+				}
+			} while (!_posted.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed));
 		}
 		else
 		{
@@ -83,41 +99,91 @@ namespace Stormancer
 		}
 
 		auto start = std::chrono::system_clock::now();
-		bool tasksToRun = true;
 
-		do
+		while (true)
 		{
-			std::function<void()> action;
+			if (!_pendingHead)
 			{
-				// Retrieve in an inner scope to avoid keeping the mutex when calling action()
-				std::lock_guard<std::mutex> l(_mutex);
+				takePostedActions();
+			}
 
-				if (!_actions.empty())
-				{
-					action = _actions.front();
-					_actions.pop();
-				}
-				else
+			if (!_pendingHead)
+			{
+				if (_stopRequested)
 				{
-					tasksToRun = false;
-					if (_stopRequested)
+					// Wait for the queue to be empty before stopping, and close it so that no action can be posted after that
+					ActionNode* expected = nullptr;
+					if (!_posted.compare_exchange_strong(expected, closedList(), std::memory_order_acq_rel))
 					{
-						// Wait for the queue to be empty before stopping
-						_isRunning = false;
-						_stopTce.set();
+						// Actions were posted since the queue was taken
+						continue;
 					}
+					_isRunning = false;
+					_stopTce.set();
 				}
+				return;
 			}
-			if (tasksToRun)
+
+			// Unlink the node before calling the action, which may call update
+			auto node = _pendingHead;
+			_pendingHead = node->next;
+			if (!_pendingHead)
 			{
-				action();
+				_pendingTail = nullptr;
 			}
+			std::unique_ptr<ActionNode> guard(node);
+			node->action();
 
 			if (std::chrono::system_clock::now() - start > maxDuration)
 			{
 				return;
 			}
-		} while (tasksToRun || _stopRequested);
+		}
+	}
+
+	void MainThreadActionDispatcher::takePostedActions()
+	{
+		ActionNode* node = _posted.exchange(nullptr, std::memory_order_acquire);
+
+		// The posted list is in reverse posting order
+		ActionNode* head = nullptr;
+		ActionNode* tail = node;
+		while (node)
+		{
+			auto next = node->next;
+			node->next = head;
+			head = node;
+			node = next;
+		}
+
+		if (head)
+		{
+			if (_pendingTail)
+			{
+				_pendingTail->next = head;
+			}
+			else
+			{
+				_pendingHead = head;
+			}
+			_pendingTail = tail;
+		}
+	}
+
+	MainThreadActionDispatcher::ActionNode* MainThreadActionDispatcher::closedList()
+	{
+		static ActionNode closed{ nullptr, nullptr };
+		return &closed;
+	}
+
+	void MainThreadActionDispatcher::deleteNodes(ActionNode* node)
+	{
+		while (node && node != closedList())
+		{
+			auto next = node->next;
+			delete node;
+			node = next;
+		}
 	}
 
 	void MainThreadActionDispatcher::schedule(pplx::TaskProc_t task, void* param)
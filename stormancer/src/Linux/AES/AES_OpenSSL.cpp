@@ -0,0 +1,269 @@
+#include "stormancer/stdafx.h"
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+#include <openssl/rand.h>
+#include <openssl/err.h>
+#include "stormancer/Linux/AES/AES_OpenSSL.h"
+#include "stormancer/KeyStore.h"
+
+namespace
+{
+	/// Size of the stack buffer the data is processed through, large enough for a full MTU packet.
+	const int chunkSize = 2048;
+
+	/// Maximum number of cipher contexts kept for each direction.
+	const std::size_t maxContexts = 64;
+
+	void throwOpenSSLError(const char* function)
+	{
+		char buffer[256];
+		ERR_error_string_n(ERR_get_error(), buffer, sizeof(buffer));
+		std::stringstream ss;
+		ss << "Error " << buffer << " returned by " << function;
+		throw std::runtime_error(ss.str());
+	}
+}
+
+namespace Stormancer
+{
+	AESOpenSSL::AESOpenSSL(std::shared_ptr<KeyStore> keyStore)
+		: _key(keyStore)
+	{
+	}
+
+	AESOpenSSL::~AESOpenSSL()
+	{
+		cleanAES();
+	}
+
+	void AESOpenSSL::encrypt(byte* dataPtr, std::streamsize dataSize, byte* ivPtr, std::streamsize ivSize, obytestream* outputStream, uint64 keyId)
+	{
+		std::lock_guard<std::mutex> lg(_encryptMutex);
+
+		auto ctx = beginEncrypt(ivPtr, ivSize, keyId);
+
+		byte buffer[chunkSize];
+		int outSize = 0;
+		for (std::streamsize offset = 0; offset < dataSize; offset += chunkSize)
+		{
+			int inSize = (int)std::min<std::streamsize>(chunkSize, dataSize - offset);
+			if (EVP_EncryptUpdate(ctx, buffer, &outSize, dataPtr + offset, inSize) != 1)
+			{
+				throwOpenSSLError("EVP_EncryptUpdate");
+			}
+			if (outputStream)
+			{
+				outputStream->write(buffer, outSize);
+			}
+		}
+
+		byte tag[256 / 8];
+		endEncrypt(ctx, tag);
+
+		// Write the tag after the encrypted data
+		if (outputStream)
+		{
+			outputStream->write(tag, tagSize());
+		}
+	}
+
+	void AESOpenSSL::decrypt(byte* dataPtr, std::streamsize dataSize, byte* ivPtr, std::streamsize ivSize, obytestream* outputStream, uint64 keyId)
+	{
+		if (dataSize < tagSize())
+		{
+			throw std::runtime_error("Encrypted data is smaller than the authentication tag");
+		}
+
+		std::lock_guard<std::mutex> lg(_decryptMutex);
+
+		auto ctx = beginDecrypt(ivPtr, ivSize, keyId);
+
+		std::streamsize cipherSize = dataSize - tagSize();
+		byte buffer[chunkSize];
+		int outSize = 0;
+		for (std::streamsize offset = 0; offset < cipherSize; offset += chunkSize)
+		{
+			int inSize = (int)std::min<std::streamsize>(chunkSize, cipherSize - offset);
+			if (EVP_DecryptUpdate(ctx, buffer, &outSize, dataPtr + offset, inSize) != 1)
+			{
+				throwOpenSSLError("EVP_DecryptUpdate");
+			}
+			if (outputStream)
+			{
+				outputStream->write(buffer, outSize);
+			}
+		}
+
+		endDecrypt(ctx, dataPtr + cipherSize);
+	}
+
+	bool AESOpenSSL::canEncryptInPlace()
+	{
+		return true;
+	}
+
+	void AESOpenSSL::encryptInPlace(byte* dataPtr, std::streamsize dataSize, byte* ivPtr, std::streamsize ivSize, byte* tagPtr, uint64 keyId)
+	{
+		std::lock_guard<std::mutex> lg(_encryptMutex);
+
+		auto ctx = beginEncrypt(ivPtr, ivSize, keyId);
+
+		// GCM is a stream mode: the output has the size of the input and can overwrite it
+		int outSize = 0;
+		if (dataSize > 0 && EVP_EncryptUpdate(ctx, dataPtr, &outSize, dataPtr, (int)dataSize) != 1)
+		{
+			throwOpenSSLError("EVP_EncryptUpdate");
+		}
+
+		endEncrypt(ctx, tagPtr);
+	}
+
+	std::streamsize AESOpenSSL::decryptInPlace(byte* dataPtr, std::streamsize dataSize, byte* ivPtr, std::streamsize ivSize, uint64 keyId)
+	{
+		if (dataSize < tagSize())
+		{
+			throw std::runtime_error("Encrypted data is smaller than the authentication tag");
+		}
+
+		std::lock_guard<std::mutex> lg(_decryptMutex);
+
+		auto ctx = beginDecrypt(ivPtr, ivSize, keyId);
+
+		std::streamsize cipherSize = dataSize - tagSize();
+		int outSize = 0;
+		if (cipherSize > 0 && EVP_DecryptUpdate(ctx, dataPtr, &outSize, dataPtr, (int)cipherSize) != 1)
+		{
+			throwOpenSSLError("EVP_DecryptUpdate");
+		}
+
+		endDecrypt(ctx, dataPtr + cipherSize);
+		return cipherSize;
+	}
+
+	void AESOpenSSL::generateRandomIV(byte* ivPtr)
+	{
+		if (RAND_bytes(ivPtr, ivSize()) != 1)
+		{
+			throwOpenSSLError("RAND_bytes");
+		}
+	}
+
+	std::streamsize AESOpenSSL::getBlockSize()
+	{
+		return 16;
+	}
+
+	EVP_CIPHER_CTX* AESOpenSSL::getContext(ContextCache& cache, uint64 keyId, bool encrypt)
+	{
+		// The key store key is replaced when connecting to a new server: the contexts hold the schedule of the previous key
+		if (std::memcmp(cache.key, _key->key, sizeof(cache.key)) != 0)
+		{
+			clearContexts(cache);
+			std::memcpy(cache.key, _key->key, sizeof(cache.key));
+		}
+
+		auto& contexts = cache.contexts;
+		auto it = contexts.find(keyId);
+		if (it != contexts.end())
+		{
+			return it->second;
+		}
+
+		if (contexts.size() >= maxContexts)
+		{
+			// Key ids of past connections: rebuilding the contexts of the current ones is cheap
+			clearContexts(cache);
+		}
+
+		EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+		if (ctx == nullptr)
+		{
+			throwOpenSSLError("EVP_CIPHER_CTX_new");
+		}
+
+		int result = encrypt
+			? EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, _key->key, nullptr)
+			: EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, _key->key, nullptr);
+		if (result != 1)
+		{
+			EVP_CIPHER_CTX_free(ctx);
+			throwOpenSSLError(encrypt ? "EVP_EncryptInit_ex" : "EVP_DecryptInit_ex");
+		}
+
+		contexts[keyId] = ctx;
+		return ctx;
+	}
+
+	EVP_CIPHER_CTX* AESOpenSSL::beginEncrypt(byte* ivPtr, std::streamsize ivSize, uint64 keyId)
+	{
+		auto ctx = getContext(_encryptContexts, keyId, true);
+
+		// The key schedule is kept in the context, only the IV is set for each packet
+		if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, (int)ivSize, nullptr) != 1 ||
+			EVP_EncryptInit_ex(ctx, nullptr, nullptr, nullptr, ivPtr) != 1)
+		{
+			throwOpenSSLError("EVP_EncryptInit_ex");
+		}
+		return ctx;
+	}
+
+	EVP_CIPHER_CTX* AESOpenSSL::beginDecrypt(byte* ivPtr, std::streamsize ivSize, uint64 keyId)
+	{
+		auto ctx = getContext(_decryptContexts, keyId, false);
+
+		if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, (int)ivSize, nullptr) != 1 ||
+			EVP_DecryptInit_ex(ctx, nullptr, nullptr, nullptr, ivPtr) != 1)
+		{
+			throwOpenSSLError("EVP_DecryptInit_ex");
+		}
+		return ctx;
+	}
+
+	void AESOpenSSL::endEncrypt(EVP_CIPHER_CTX* ctx, byte* tagPtr)
+	{
+		byte buffer[chunkSize];
+		int outSize = 0;
+		if (EVP_EncryptFinal_ex(ctx, buffer, &outSize) != 1)
+		{
+			throwOpenSSLError("EVP_EncryptFinal_ex");
+		}
+
+		if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, tagSize(), tagPtr) != 1)
+		{
+			throwOpenSSLError("EVP_CIPHER_CTX_ctrl(EVP_CTRL_GCM_GET_TAG)");
+		}
+	}
+
+	void AESOpenSSL::endDecrypt(EVP_CIPHER_CTX* ctx, byte* tagPtr)
+	{
+		if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, tagSize(), tagPtr) != 1)
+		{
+			throwOpenSSLError("EVP_CIPHER_CTX_ctrl(EVP_CTRL_GCM_SET_TAG)");
+		}
+
+		byte buffer[chunkSize];
+		int outSize = 0;
+		if (EVP_DecryptFinal_ex(ctx, buffer, &outSize) != 1)
+		{
+			throw std::runtime_error("AES-GCM authentication tag mismatch");
+		}
+	}
+
+	void AESOpenSSL::cleanAES()
+	{
+		clearContexts(_encryptContexts);
+		clearContexts(_decryptContexts);
+	}
+
+	void AESOpenSSL::clearContexts(ContextCache& cache)
+	{
+		for (auto ctx : cache.contexts)
+		{
+			EVP_CIPHER_CTX_free(ctx.second);
+		}
+		cache.contexts.clear();
+	}
+}
+
+#endif
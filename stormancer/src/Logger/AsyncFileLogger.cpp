@@ -0,0 +1,346 @@
+#include "stormancer/stdafx.h"
+#include "stormancer/Logger/AsyncFileLogger.h"
+#include "stormancer/Helpers.h"
+
+namespace Stormancer
+{
+	namespace
+	{
+		/// Size of the formatted records above which the writer writes them, without waiting for the ring buffer to be empty.
+		const std::size_t writeBatchSize = 64 * 1024;
+
+		/// Maximum time the writer sleeps when it was not woken up by a new record.
+		const std::chrono::milliseconds writerSleepTime(50);
+	}
+
+	AsyncFileLogger::AsyncFileLogger(const char* filepath, std::size_t capacity, OverflowPolicy policy, uint64 maxFileSize, int maxFiles)
+		: _fileName(std::strlen(filepath) ? filepath : "stormancer_" + nowDateStr() + ".log")
+		, _maxFileSize(maxFileSize)
+		, _maxFiles(std::max(maxFiles, 0))
+		, _policy(policy)
+		, _enqueuePos(0)
+		, _droppedCount(0)
+		, _writtenCount(0)
+		, _writerSleeping(false)
+		, _stopRequested(false)
+	{
+		std::size_t slotsCount = 2;
+		while (slotsCount < capacity)
+		{
+			slotsCount *= 2;
+		}
+		_slots.reset(new Slot[slotsCount]);
+		_mask = slotsCount - 1;
+		for (std::size_t i = 0; i < slotsCount; i++)
+		{
+			_slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		if (!tryOpenFile())
+		{
+			throw std::runtime_error("AsyncFileLogger can't open the file " + _fileName + " to log.");
+		}
+
+		_writer = std::thread([this]() {
+			writerLoop();
+		});
+	}
+
+	AsyncFileLogger::~AsyncFileLogger()
+	{
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			_stopRequested = true;
+		}
+		_wakeUp.notify_one();
+		if (_writer.joinable())
+		{
+			_writer.join();
+		}
+		_file.close();
+	}
+
+	void AsyncFileLogger::log(const std::string& message)
+	{
+		enqueue([&message](Record& record) {
+			record.detailed = false;
+			record.message.assign(message);
+		});
+	}
+
+	void AsyncFileLogger::log(LogLevel level, const std::string& category, const std::string& message, const std::string& data)
+	{
+		enqueue([&](Record& record) {
+			record.detailed = true;
+			record.level = level;
+			record.time = nowTime_t();
+			record.category.assign(category);
+			record.message.assign(message);
+			record.data.assign(data);
+		});
+	}
+
+	void AsyncFileLogger::log(const std::exception& ex)
+	{
+		log(LogLevel::Error, "exception", ex.what(), "");
+	}
+
+	uint64 AsyncFileLogger::droppedCount() const
+	{
+		return _droppedCount.load(std::memory_order_relaxed);
+	}
+
+	void AsyncFileLogger::flush()
+	{
+		std::size_t target = _enqueuePos.load(std::memory_order_acquire);
+		std::unique_lock<std::mutex> lock(_mutex);
+		_wakeUp.notify_one();
+		_written.wait(lock, [this, target]() {
+			// The positions wrap around, compare their difference
+			return (intptr_t)(_writtenCount.load(std::memory_order_relaxed) - target) >= 0 || _stopRequested;
+		});
+	}
+
+	template<typename TFill>
+	void AsyncFileLogger::enqueue(TFill fill)
+	{
+		std::size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+		Slot* slot;
+		while (true)
+		{
+			slot = &_slots[pos & _mask];
+			std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+			if (diff == 0)
+			{
+				if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				// The slot still holds the record logged one lap ago: the buffer is full
+				if (_policy == OverflowPolicy::Drop || _stopRequested)
+				{
+					_droppedCount.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+				_wakeUp.notify_one();
+				std::this_thread::yield();
+				pos = _enqueuePos.load(std::memory_order_relaxed);
+			}
+			else
+			{
+				pos = _enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		fill(slot->record);
+		slot->sequence.store(pos + 1, std::memory_order_release);
+
+		if (_writerSleeping.load(std::memory_order_relaxed))
+		{
+			_wakeUp.notify_one();
+		}
+	}
+
+	bool AsyncFileLogger::dequeue(Record& record)
+	{
+		Slot& slot = _slots[_dequeuePos & _mask];
+		if (slot.sequence.load(std::memory_order_acquire) != _dequeuePos + 1)
+		{
+			return false;
+		}
+
+		// Swapping gives the strings of the previous record back to the slot, so their capacity is reused
+		std::swap(record, slot.record);
+		slot.sequence.store(_dequeuePos + _mask + 1, std::memory_order_release);
+		_dequeuePos++;
+		return true;
+	}
+
+	void AsyncFileLogger::writerLoop()
+	{
+		std::string buffer;
+		buffer.reserve(writeBatchSize + 1024);
+		Record record;
+
+		while (true)
+		{
+			bool stopping = _stopRequested;
+
+			std::size_t count = 0;
+			while (dequeue(record))
+			{
+				append(buffer, record);
+				count++;
+				if (buffer.size() >= writeBatchSize)
+				{
+					write(buffer);
+					buffer.clear();
+				}
+			}
+
+			uint64 dropped = _droppedCount.load(std::memory_order_relaxed);
+			if (dropped != _reportedDroppedCount)
+			{
+				Record report;
+				report.detailed = true;
+				report.level = LogLevel::Warn;
+				report.time = nowTime_t();
+				report.category = "AsyncFileLogger";
+				report.message = "Log records dropped, the buffer was full";
+				report.data = std::to_string(dropped - _reportedDroppedCount);
+				append(buffer, report);
+				_reportedDroppedCount = dropped;
+			}
+
+			if (!buffer.empty())
+			{
+				write(buffer);
+				buffer.clear();
+				_file.flush();
+			}
+
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				if (count > 0)
+				{
+					_writtenCount.fetch_add(count, std::memory_order_relaxed);
+					_written.notify_all();
+				}
+
+				if (stopping)
+				{
+					return;
+				}
+
+				_writerSleeping = true;
+				_wakeUp.wait_for(lock, writerSleepTime, [this]() {
+					return _stopRequested || _slots[_dequeuePos & _mask].sequence.load(std::memory_order_acquire) == _dequeuePos + 1;
+				});
+				_writerSleeping = false;
+			}
+		}
+	}
+
+	void AsyncFileLogger::append(std::string& buffer, const Record& record)
+	{
+		if (!record.detailed)
+		{
+			buffer.append(record.message);
+			buffer.push_back('\n');
+			return;
+		}
+
+		// Same layout as ILogger::format
+		if (record.time != _lastTime)
+		{
+			_lastTime = record.time;
+			_lastTimeStr = time_tToStr(record.time);
+		}
+		buffer.push_back('[');
+		buffer.append(_lastTimeStr);
+		buffer.push_back(']');
+
+		switch (record.level)
+		{
+		case LogLevel::Fatal:
+			buffer.append(" [Fatal]");
+			break;
+		case LogLevel::Error:
+			buffer.append(" [Error]");
+			break;
+		case LogLevel::Warn:
+			buffer.append(" [Warn ]");
+			break;
+		case LogLevel::Info:
+			buffer.append(" [Info ]");
+			break;
+		case LogLevel::Debug:
+			buffer.append(" [Debug]");
+			break;
+		case LogLevel::Trace:
+			buffer.append(" [Trace]");
+			break;
+		}
+
+		if (!record.category.empty())
+		{
+			buffer.append(" [");
+			buffer.append(record.category);
+			buffer.push_back(']');
+		}
+
+		if (!record.message.empty())
+		{
+			buffer.push_back(' ');
+			buffer.append(record.message);
+		}
+
+		if (!record.data.empty())
+		{
+			buffer.append(" [");
+			buffer.append(record.data);
+			buffer.push_back(']');
+		}
+
+		buffer.push_back('\n');
+	}
+
+	void AsyncFileLogger::write(const std::string& buffer)
+	{
+		if (_maxFileSize > 0 && _fileSize > 0 && _fileSize + buffer.size() > _maxFileSize)
+		{
+			rotate();
+		}
+
+		if (tryOpenFile())
+		{
+			_file.write(buffer.data(), (std::streamsize)buffer.size());
+			_fileSize += buffer.size();
+		}
+	}
+
+	void AsyncFileLogger::rotate()
+	{
+		_file.close();
+
+		if (_maxFiles > 0)
+		{
+			std::remove((_fileName + "." + std::to_string(_maxFiles)).c_str());
+			for (int i = _maxFiles - 1; i >= 1; i--)
+			{
+				std::rename((_fileName + "." + std::to_string(i)).c_str(), (_fileName + "." + std::to_string(i + 1)).c_str());
+			}
+			std::rename(_fileName.c_str(), (_fileName + ".1").c_str());
+		}
+		else
+		{
+			std::remove(_fileName.c_str());
+		}
+
+		_file.open(_fileName, std::ofstream::out | std::ofstream::trunc);
+		_fileSize = 0;
+	}
+
+	bool AsyncFileLogger::tryOpenFile()
+	{
+		if (_file.is_open())
+		{
+			return true;
+		}
+
+		_file.open(_fileName, std::ofstream::out | std::ofstream::app);
+		if (!_file.is_open())
+		{
+			return false;
+		}
+
+		_file.seekp(0, std::ios_base::end);
+		auto position = _file.tellp();
+		_fileSize = (position > 0 ? (uint64)position : 0);
+		return true;
+	}
+};
@@ -40,6 +40,11 @@ namespace Stormancer
 
 		std::clog << formatException(e) << std::endl;
 	}
+
+	bool ConsoleLogger::isEnabled(Stormancer::LogLevel level, const char*)
+	{
+		return level <= _maximalLogLevel;
+	}
 }
 
 #endif
@@ -74,6 +74,11 @@ namespace Stormancer
 		resetColor();
 	}
 
+	bool ConsoleLogger::isEnabled(LogLevel level, const char*)
+	{
+		return level <= _maximalLogLevel;
+	}
+
 	void ConsoleLogger::setConsoleColor(WORD color)
 	{
 		SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), color);
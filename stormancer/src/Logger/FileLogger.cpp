@@ -22,7 +22,7 @@ namespace Stormancer
 		std::lock_guard<std::mutex> lg(_mutex);
 		if (tryOpenFile())
 		{
-			_myfile << message << std::endl;
+			_myfile << message << '\n';
 			if (_immediate)
 			{
 				_myfile.flush();
@@ -36,7 +36,7 @@ namespace Stormancer
 		if (tryOpenFile())
 		{
 			auto str = format(level, category, message,data);
-			_myfile << str << std::endl;
+			_myfile << str << '\n';
 			if (_immediate)
 			{
 				_myfile.flush();
@@ -49,7 +49,7 @@ namespace Stormancer
 		std::lock_guard<std::mutex> lg(_mutex);
 		if (tryOpenFile())
 		{
-			_myfile << formatException(ex) << std::endl;
+			_myfile << formatException(ex) << '\n';
 			if (_immediate)
 			{
 				_myfile.flush();
@@ -13,6 +13,11 @@ namespace Stormancer
 	{
 	}
 
+	bool ILogger::isEnabled(LogLevel, const char*)
+	{
+		return true;
+	}
+
 	std::string ILogger::format(LogLevel level, const std::string& category, const std::string& message, const std::string& data)
 	{
 		std::stringstream ss;
@@ -22,4 +22,9 @@ namespace Stormancer
 	void NullLogger::log(const std::exception&)
 	{
 	}
+
+	bool NullLogger::isEnabled(LogLevel /*level*/, const char* /*category*/)
+	{
+		return false;
+	}
 };
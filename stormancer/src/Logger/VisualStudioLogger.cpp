@@ -43,4 +43,9 @@ namespace Stormancer
 			OutputDebugStringA(msg.c_str());
 		}
 	}
+
+	bool VisualStudioLogger::isEnabled(Stormancer::LogLevel level, const char*)
+	{
+		return level <= _maximalLogLevel;
+	}
 }
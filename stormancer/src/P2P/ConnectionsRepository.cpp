@@ -23,7 +23,7 @@ namespace Stormancer
 
 	void ConnectionsRepository::newConnection(std::shared_ptr<IConnection> connection)
 	{
-		_logger->log(LogLevel::Trace, "P2P", "Adding connection " + connection->ipAddress(), std::to_string(connection->id()));
+		STORMANCER_LOG(_logger, LogLevel::Trace, "P2P", "Adding connection " + connection->ipAddress(), std::to_string(connection->id()));
 		if (connection == nullptr)
 		{
 			throw std::runtime_error("connection is null");
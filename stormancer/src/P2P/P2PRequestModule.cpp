@@ -79,7 +79,7 @@ namespace Stormancer
 
 		builder->service((byte)SystemRequestIDTypes::ID_P2P_TEST_CONNECTIVITY_CLIENT, [=](RequestContext* ctx) {
 			auto candidate = _serializer->deserializeOne<ConnectivityCandidate>(ctx->inputStream());
-			_logger->log(LogLevel::Debug, "p2p", "Starting connectivity test (CLIENT) " + candidate.clientEndpointCandidate.address + " => " + candidate.listeningEndpointCandidate.address);
+			STORMANCER_LOG(_logger, LogLevel::Debug, "p2p", "Starting connectivity test (CLIENT) " + candidate.clientEndpointCandidate.address + " => " + candidate.listeningEndpointCandidate.address);
 			/*auto connection = _connections->getConnection(candidate.listeningPeer);
 			if (connection && connection->getConnectionState() == ConnectionState::Connected)
 			{
@@ -116,7 +116,7 @@ namespace Stormancer
 			{
 				return _transport->sendPing(candidate.listeningEndpointCandidate.address).then([=](pplx::task<int> t) {
 					auto latency = (int)t.get();
-					_logger->log(LogLevel::Debug, "p2p", "Connectivity test complete : " + candidate.clientEndpointCandidate.address + " => " + candidate.listeningEndpointCandidate.address + " ping : " + std::to_string(latency));
+					STORMANCER_LOG(_logger, LogLevel::Debug, "p2p", "Connectivity test complete : " + candidate.clientEndpointCandidate.address + " => " + candidate.listeningEndpointCandidate.address + " ping : " + std::to_string(latency));
 					ctx->send([=](obytestream* stream) {
 						_serializer->serialize(stream, latency);
 					});
@@ -126,7 +126,7 @@ namespace Stormancer
 
 		builder->service((byte)SystemRequestIDTypes::ID_P2P_TEST_CONNECTIVITY_HOST, [=](RequestContext* ctx) {
 			auto candidate = _serializer->deserializeOne<ConnectivityCandidate>(ctx->inputStream());
-			_logger->log(LogLevel::Debug, "p2p", "Starting connectivity test (LISTENER) " + candidate.clientEndpointCandidate.address + " => " + candidate.listeningEndpointCandidate.address);
+			STORMANCER_LOG(_logger, LogLevel::Debug, "p2p", "Starting connectivity test (LISTENER) " + candidate.clientEndpointCandidate.address + " => " + candidate.listeningEndpointCandidate.address);
 			/*auto connection = _connections->getConnection(candidate.clientPeer);
 			if (connection && connection->getConnectionState() == ConnectionState::Connected)
 			{
@@ -152,7 +152,7 @@ namespace Stormancer
 				return pplx::task_from_result();
 			}
 
-			_logger->log(LogLevel::Debug, "p2p", "Waiting connection " + candidate.clientEndpointCandidate.address + " => " + candidate.listeningEndpointCandidate.address);
+			STORMANCER_LOG(_logger, LogLevel::Debug, "p2p", "Waiting connection " + candidate.clientEndpointCandidate.address + " => " + candidate.listeningEndpointCandidate.address);
 			_connections->addPendingConnection(candidate.clientPeer)
 				.then([=](pplx::task<std::shared_ptr<IConnection>> t) {
 
@@ -176,7 +176,7 @@ namespace Stormancer
 				return pplx::task_from_result();
 			}
 
-			_logger->log(LogLevel::Debug, "p2p", "Connecting... " + candidate.clientEndpointCandidate.address + " => " + candidate.listeningEndpointCandidate.address);
+			STORMANCER_LOG(_logger, LogLevel::Debug, "p2p", "Connecting... " + candidate.clientEndpointCandidate.address + " => " + candidate.listeningEndpointCandidate.address);
 			_connections->addPendingConnection(candidate.listeningPeer)
 				.then([=](pplx::task<std::shared_ptr<IConnection>> t) {
 
@@ -1,17 +1,23 @@
 #include "stormancer/stdafx.h"
 #include "stormancer/P2P/RakNet/P2PTunnelClient.h"
-#include "..\..\..\include\stormancer\P2P\RakNet\P2PTunnelClient.h"
+#include "stormancer/P2P/RakNet/P2PTunnelReactor.h"
 
 namespace Stormancer
 {
 	// Use this intermediate variable to avoid "string literal to char* conversion" warning
 	static char address[] = "127.0.0.1";
 
+	/// Number of receive structs kept for reuse by a polling thread.
+	static const std::size_t freeStructsCapacity = 8;
+
 	P2PTunnelClient::P2PTunnelClient(std::function<void(P2PTunnelClient*, RakNet::RNS2RecvStruct*)> onMsgRecv,
 		std::shared_ptr<RequestProcessor> sysCall,
-		ILogger_ptr logger)
+		ILogger_ptr logger,
+		std::shared_ptr<P2PTunnelReactor> reactor)
 		: _sysCall(sysCall)
 		, _logger(logger)
+		, _reactor(reactor)
+		, _hostResolved(false)
 	{
 		_onMsgRecv = onMsgRecv;
 		hostPort = 0;
@@ -48,6 +54,19 @@ namespace Stormancer
 			RakNet::RakNetSocket2Allocator::DeallocRNS2(socket);
 			throw std::runtime_error("Failed to send test message");
 		}
+		_boundPort = socket->GetBoundAddress().GetPort();
+
+#if defined(__linux__)
+		if (_reactor)
+		{
+			_reactor->add(((RakNet::RNS2_Berkley*)socket)->GetSocket(), [this](RakNet::RNS2RecvStruct* recvStruct) {
+				OnRNS2Recv(recvStruct);
+			});
+			isRunning = true;
+			return;
+		}
+#endif
+
 		((RakNet::RNS2_Berkley*)socket)->CreateRecvPollingThread(0).then([this](pplx::task<void> task)
 		{
 			try
@@ -68,6 +87,18 @@ namespace Stormancer
 		{	
 			auto socketCopy = socket;
 			socket = nullptr;
+
+#if defined(__linux__)
+			if (_reactor)
+			{
+				// The polling thread was never started: once the reactor released the socket, nothing uses it anymore
+				_reactor->remove(((RakNet::RNS2_Berkley*)socketCopy)->GetSocket());
+				RakNet::RakNetSocket2Allocator::DeallocRNS2(socketCopy);
+				delete _handler;
+				return;
+			}
+#endif
+
 			_handler->innerClient = nullptr;
 			auto handler = _handler;
 			
@@ -81,30 +112,83 @@ namespace Stormancer
 		}
 	}
 
+	unsigned short P2PTunnelClient::boundPort() const
+	{
+		return _boundPort;
+	}
+
+	void P2PTunnelClient::setHostPort(unsigned short port)
+	{
+		_hostAddress.FromStringExplicitPort(address, port, socket->GetBoundAddress().GetIPVersion());
+		hostPort = port;
+		_hostResolved.store(true, std::memory_order_release);
+	}
+
+	void P2PTunnelClient::sendToHost(const byte* data, std::size_t size)
+	{
+		if (!_hostResolved.load(std::memory_order_acquire))
+		{
+			return;
+		}
+
+		RakNet::RNS2_SendParameters bsp;
+		bsp.data = (char*)data;
+		bsp.length = (int)size;
+		bsp.systemAddress = _hostAddress;
+		socket->Send(&bsp, _FILE_AND_LINE_);
+	}
+
 	void P2PTunnelClient::OnRNS2Recv(RakNet::RNS2RecvStruct* recvStruct)
 	{
-		if (recvStruct->systemAddress.GetPort() != socket->GetBoundAddress().GetPort())
+		if (recvStruct->systemAddress.GetPort() != _boundPort)
 		{
 			_onMsgRecv(this, recvStruct);
 		}
 	}
 	
 
+	P2PTunnelRNS2EventHandler::~P2PTunnelRNS2EventHandler()
+	{
+		for (auto s : _freeStructs)
+		{
+			RakNet::OP_DELETE(s, _FILE_AND_LINE_);
+		}
+	}
+
 	void P2PTunnelRNS2EventHandler::OnRNS2Recv(RakNet::RNS2RecvStruct * recvStruct)
 	{
 		if (innerClient)
 		{
 			innerClient->OnRNS2Recv(recvStruct);
 		}
+		// The datagram is forwarded synchronously, the struct can be reused by the next read
+		DeallocRNS2RecvStruct(recvStruct, _FILE_AND_LINE_);
 	}
 
 	void P2PTunnelRNS2EventHandler::DeallocRNS2RecvStruct(RakNet::RNS2RecvStruct * s, const char * file, unsigned int line)
 	{
+		{
+			std::lock_guard<std::mutex> lg(_freeStructsMutex);
+			if (_freeStructs.size() < freeStructsCapacity)
+			{
+				_freeStructs.push_back(s);
+				return;
+			}
+		}
 		RakNet::OP_DELETE(s, file, line);
 	}
 
 	RakNet::RNS2RecvStruct * P2PTunnelRNS2EventHandler::AllocRNS2RecvStruct(const char * file, unsigned int line)
 	{
+		{
+			std::lock_guard<std::mutex> lg(_freeStructsMutex);
+			if (!_freeStructs.empty())
+			{
+				auto s = _freeStructs.back();
+				_freeStructs.pop_back();
+				return s;
+			}
+		}
 		return RakNet::OP_NEW<RakNet::RNS2RecvStruct>(file, line);
 	}
 };
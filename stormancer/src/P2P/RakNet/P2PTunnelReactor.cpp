@@ -0,0 +1,169 @@
+#include "stormancer/stdafx.h"
+#include "stormancer/P2P/RakNet/P2PTunnelReactor.h"
+
+#if defined(__linux__)
+
+#include <future>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "stormancer/TCP/EpollReactor.h"
+
+namespace Stormancer
+{
+	struct P2PTunnelReactor::ReceiveBatch
+	{
+		/// Maximum number of datagrams read by one recvmmsg call.
+		static const unsigned int size = 32;
+
+		ReceiveBatch()
+		{
+			std::memset(headers, 0, sizeof(headers));
+			for (unsigned int i = 0; i < size; i++)
+			{
+				iovecs[i].iov_base = structs[i].data;
+				iovecs[i].iov_len = sizeof(structs[i].data);
+				headers[i].msg_hdr.msg_iov = &iovecs[i];
+				headers[i].msg_hdr.msg_iovlen = 1;
+				headers[i].msg_hdr.msg_name = &addresses[i];
+			}
+		}
+
+		RakNet::RNS2RecvStruct structs[size];
+		iovec iovecs[size];
+		sockaddr_storage addresses[size];
+		mmsghdr headers[size];
+	};
+
+	P2PTunnelReactor::P2PTunnelReactor(ILogger_ptr logger)
+		: _logger(logger)
+		, _reactor(std::make_shared<EpollReactor>(logger))
+		, _batch(std::make_shared<ReceiveBatch>())
+	{
+		_reactor->start();
+	}
+
+	P2PTunnelReactor::~P2PTunnelReactor()
+	{
+		// When called by a handler, the reactor thread exits once the handler returns
+		_reactor->stop();
+
+		std::lock_guard<std::mutex> lg(_registrationsMutex);
+		for (auto& registration : _registrations)
+		{
+			registration.second->removed = true;
+		}
+	}
+
+	void P2PTunnelReactor::add(RakNet::RNS2Socket socket, Handler handler)
+	{
+		auto registration = std::make_shared<Registration>();
+		registration->handler = handler;
+		{
+			std::lock_guard<std::mutex> lg(_registrationsMutex);
+			_registrations[socket] = registration;
+		}
+
+		auto batch = _batch;
+		auto logger = _logger;
+		_reactor->add(socket, EPOLLIN, [socket, registration, batch, logger](uint32_t) {
+			receive(socket, *registration, *batch, logger);
+		});
+	}
+
+	void P2PTunnelReactor::remove(RakNet::RNS2Socket socket)
+	{
+		if (_reactor->isReactorThread())
+		{
+			removeOnReactorThread(socket);
+			return;
+		}
+
+		// Remove the socket between two handler calls, so the tunnel can be destroyed when the call returns
+		auto removed = std::make_shared<std::promise<void>>();
+		auto done = removed->get_future();
+		_reactor->post([this, socket, removed]() {
+			removeOnReactorThread(socket);
+			removed->set_value();
+		});
+
+		// A stopped reactor drops the action without running it: the promise is then broken, which completes the wait
+		removed.reset();
+		done.wait();
+	}
+
+	void P2PTunnelReactor::removeOnReactorThread(RakNet::RNS2Socket socket)
+	{
+		_reactor->remove(socket);
+
+		std::lock_guard<std::mutex> lg(_registrationsMutex);
+		auto it = _registrations.find(socket);
+		if (it != _registrations.end())
+		{
+			it->second->removed = true;
+			_registrations.erase(it);
+		}
+	}
+
+	void P2PTunnelReactor::receive(RakNet::RNS2Socket socket, Registration& registration, ReceiveBatch& batch, const ILogger_ptr& logger)
+	{
+		while (true)
+		{
+			for (unsigned int i = 0; i < ReceiveBatch::size; i++)
+			{
+				batch.headers[i].msg_hdr.msg_namelen = sizeof(batch.addresses[i]);
+			}
+
+			int count = recvmmsg(socket, batch.headers, ReceiveBatch::size, MSG_DONTWAIT, nullptr);
+			if (count < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				if (errno != EAGAIN && errno != EWOULDBLOCK)
+				{
+					STORMANCER_LOG(logger, LogLevel::Debug, "P2PTunnelReactor", "recvmmsg failed", std::to_string(errno));
+				}
+				return;
+			}
+
+			for (int i = 0; i < count; i++)
+			{
+				auto recvStruct = &batch.structs[i];
+				recvStruct->bytesRead = (int)batch.headers[i].msg_len;
+				recvStruct->socket = nullptr;
+				auto& address = recvStruct->systemAddress;
+				if (batch.addresses[i].ss_family == AF_INET)
+				{
+					std::memcpy(&address.address.addr4, &batch.addresses[i], sizeof(sockaddr_in));
+					address.debugPort = ntohs(address.address.addr4.sin_port);
+				}
+#if RAKNET_SUPPORT_IPV6 == 1
+				else
+				{
+					std::memcpy(&address.address.addr6, &batch.addresses[i], sizeof(sockaddr_in6));
+					address.debugPort = ntohs(address.address.addr6.sin6_port);
+				}
+#endif
+				if (recvStruct->bytesRead > 0)
+				{
+					registration.handler(recvStruct);
+
+					// The handler removed the socket, or destroyed the reactor
+					if (registration.removed)
+					{
+						return;
+					}
+				}
+			}
+
+			// A partial batch drained the socket
+			if ((unsigned int)count < ReceiveBatch::size)
+			{
+				return;
+			}
+		}
+	}
+}
+
+#endif
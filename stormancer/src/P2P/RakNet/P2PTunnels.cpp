@@ -4,6 +4,7 @@
 #include "stormancer/SystemRequestIDTypes.h"
 #include "stormancer/MessageIDTypes.h"
 #include "stormancer/P2P/RakNet/P2PTunnelClient.h"
+#include "stormancer/P2P/RakNet/P2PTunnelReactor.h"
 #include "stormancer/Scene.h"
 #include "stormancer/SafeCapture.h"
 #include "stormancer/P2P/OpenTunnelResult.h"
@@ -56,7 +57,7 @@ namespace Stormancer
 			{
 				auto client = std::make_shared<P2PTunnelClient>(STRM_SAFE_CAPTURE([this](P2PTunnelClient* client, RakNet::RNS2RecvStruct* msg) {
 					onMsgReceived(client, msg);
-				}), _sysClient, _logger);
+				}), _sysClient, _logger, reactor());
 				client->handle = result.handle;
 				client->peerId = connectionId;
 				client->serverId = serverId;
@@ -68,7 +69,7 @@ namespace Stormancer
 				}));
 				tunnel->id = serverId;
 				tunnel->ip = "127.0.0.1";
-				tunnel->port = (uint16) client->socket->GetBoundAddress().GetPort();
+				tunnel->port = (uint16) client->boundPort();
 				return tunnel;
 			}
 			else
@@ -97,12 +98,12 @@ namespace Stormancer
 			peerHandle key(clientPeerId, handle);
 			if (_tunnels.find(key) == _tunnels.end())
 			{
-				auto client = std::make_shared<P2PTunnelClient>([=](P2PTunnelClient* client, RakNet::RNS2RecvStruct* msg) { this->onMsgReceived(client, msg); }, _sysClient, _logger);
+				auto client = std::make_shared<P2PTunnelClient>([=](P2PTunnelClient* client, RakNet::RNS2RecvStruct* msg) { this->onMsgReceived(client, msg); }, _sysClient, _logger, reactor());
 				client->handle = handle;
 				client->peerId = clientPeerId;
 				client->serverId = serverId;
 				client->serverSide = true;
-				client->hostPort = serverIt->second.port;
+				client->setHostPort(serverIt->second.port);
 				_tunnels[key] = client;
 				return handle;
 			}
@@ -180,8 +181,6 @@ namespace Stormancer
 	{
 		byte handle;
 		stream->read(&handle, 1);
-		byte buffer[1464];
-		auto read = stream->readsome(buffer, 1464);
 
 		auto itTunnel = _tunnels.find(std::make_tuple(id, handle));
 		if (itTunnel != _tunnels.end())
@@ -189,12 +188,8 @@ namespace Stormancer
 			auto client = (*itTunnel).second;
 			if (client)
 			{
-				RakNet::RNS2_SendParameters bsp;
-				bsp.data = (char*)buffer;
-				bsp.length = (int)read;
-				bsp.systemAddress.FromStringExplicitPort("127.0.0.1", client->hostPort, client->socket->GetBoundAddress().GetIPVersion());
-
-				(*itTunnel).second->socket->Send(&bsp, _FILE_AND_LINE_);
+				// Forward the datagram from the packet buffer
+				client->sendToHost(stream->currentPtr(), (std::size_t)stream->rdbuf()->in_avail());
 			}
 			else
 			{
@@ -205,22 +200,53 @@ namespace Stormancer
 
 	void P2PTunnels::onMsgReceived(P2PTunnelClient* client, RakNet::RNS2RecvStruct* recvStruct)
 	{
-		auto connection = _connections->getConnection(client->peerId);
+		// The connection and its channel are resolved again only when the connection changes
+		auto connection = client->connection.lock();
+		if (!connection || connection->getConnectionState() != ConnectionState::Connected)
+		{
+			connection = _connections->getConnection(client->peerId);
+			client->connection = connection;
+			client->channelUid = -1;
+		}
+
 		if (connection)
 		{
 			if (client->hostPort == 0)
 			{
-				client->hostPort = recvStruct->systemAddress.GetPort();
+				client->setHostPort(recvStruct->systemAddress.GetPort());
+			}
+
+			auto& channelUidStore = connection->getChannelUidStore();
+			if (client->channelUid < 0)
+			{
+				client->channelUid = channelUidStore.getChannelUid("P2PTunnels_" + std::to_string(connection->id()));
+			}
+			else
+			{
+				channelUidStore.touch(client->channelUid);
 			}
-			std::stringstream ss;
-			ss << "P2PTunnels_" << connection->id();
-			int channelUid = connection->getChannelUidStore().getChannelUid(ss.str());
-			connection->send([=](obytestream* stream) {
+
+			byte handle = client->handle;
+			connection->send([handle, recvStruct](obytestream* stream) {
 				(*stream) << (byte)MessageIDTypes::ID_P2P_TUNNEL;
-				(*stream) << client->handle;
+				(*stream) << handle;
 				stream->write(recvStruct->data, recvStruct->bytesRead);
-			}, channelUid, PacketPriority::IMMEDIATE_PRIORITY, PacketReliability::UNRELIABLE);
+			}, client->channelUid, PacketPriority::IMMEDIATE_PRIORITY, PacketReliability::UNRELIABLE);
+		}
+	}
+
+	std::shared_ptr<P2PTunnelReactor> P2PTunnels::reactor()
+	{
+#if defined(__linux__)
+		std::lock_guard<std::mutex> lg(_reactorMutex);
+		if (!_reactor)
+		{
+			_reactor = std::make_shared<P2PTunnelReactor>(_logger);
 		}
+		return _reactor;
+#else
+		return nullptr;
+#endif
 	}
 
 	std::size_t PeerHandle_hash::operator()(const peerHandle & k) const
@@ -0,0 +1,214 @@
+#include "stormancer/stdafx.h"
+#include "stormancer/PacketCapture.h"
+
+namespace Stormancer
+{
+	namespace
+	{
+		// The fields of the file use the fixed width types: Stormancer::uint32 is 64 bits with some standard libraries
+		const char captureMagic[8] = { 'S', 'T', 'R', 'M', 'P', 'C', 'A', 'P' };
+		const uint32_t captureVersion = 1;
+
+		/// Maximum time a recorded frame stays in memory before being written.
+		const std::chrono::milliseconds writerPeriod(100);
+
+		template<typename T>
+		void append(byte*& ptr, T value)
+		{
+			std::memcpy(ptr, &value, sizeof(T));
+			ptr += sizeof(T);
+		}
+
+		template<typename T>
+		bool readValue(std::ifstream& file, T& value)
+		{
+			return (bool)file.read((char*)&value, sizeof(T));
+		}
+	}
+
+	PacketCapture::PacketCapture(const std::string& path, std::size_t bufferSize)
+		: _file(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc)
+		, _bufferSize(bufferSize)
+		, _start(std::chrono::steady_clock::now())
+		, _droppedCount(0)
+	{
+		if (!_file.is_open())
+		{
+			throw std::runtime_error("PacketCapture can't open the file " + path);
+		}
+
+		int64 startTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		uint32_t reserved = 0;
+		_file.write(captureMagic, sizeof(captureMagic));
+		_file.write((const char*)&captureVersion, sizeof(captureVersion));
+		_file.write((const char*)&reserved, sizeof(reserved));
+		_file.write((const char*)&startTime, sizeof(startTime));
+		_file.flush();
+
+		_current.reserve(_bufferSize);
+		_spare.reserve(_bufferSize);
+
+		_writer = std::thread([this]() {
+			writerLoop();
+		});
+	}
+
+	PacketCapture::~PacketCapture()
+	{
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			_stopRequested = true;
+		}
+		_wakeUp.notify_one();
+		if (_writer.joinable())
+		{
+			_writer.join();
+		}
+		_file.close();
+	}
+
+	void PacketCapture::record(Direction direction, uint64 connectionId, const byte* data, std::size_t size)
+	{
+		int64 time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+		std::size_t recordSize = recordHeaderSize + size;
+
+		std::lock_guard<std::mutex> lg(_mutex);
+		if (_current.size() + recordSize > _bufferSize && !_current.empty())
+		{
+			if (_spareFull)
+			{
+				_droppedCount++;
+				return;
+			}
+			_current.swap(_spare);
+			_spareFull = true;
+			_wakeUp.notify_one();
+		}
+
+		std::size_t offset = _current.size();
+		_current.resize(offset + recordSize);
+		byte* ptr = _current.data() + offset;
+		append(ptr, (uint32_t)size);
+		append(ptr, (byte)direction);
+		append(ptr, (byte)(size > 0 ? data[0] : 0));
+		append(ptr, (uint16_t)0);
+		append(ptr, connectionId);
+		append(ptr, time);
+		if (size > 0)
+		{
+			std::memcpy(ptr, data, size);
+		}
+	}
+
+	void PacketCapture::flush()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		// A write already started may not contain the last frames
+		uint64 target = _writeGeneration + (_writing ? 2 : 1);
+		_flushRequested = true;
+		_wakeUp.notify_one();
+		_written.wait(lock, [this, target]() {
+			return _writeGeneration >= target || _stopRequested;
+		});
+	}
+
+	uint64 PacketCapture::droppedCount() const
+	{
+		return _droppedCount.load();
+	}
+
+	void PacketCapture::writerLoop()
+	{
+		std::vector<byte> full;
+		full.reserve(_bufferSize);
+		std::vector<byte> tail;
+		tail.reserve(_bufferSize);
+
+		while (true)
+		{
+			bool stopping;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wakeUp.wait_for(lock, writerPeriod, [this]() {
+					return _spareFull || _flushRequested || _stopRequested;
+				});
+
+				// The spare buffer was filled before the current one
+				if (_spareFull)
+				{
+					full.swap(_spare);
+					_spareFull = false;
+				}
+				tail.swap(_current);
+				_flushRequested = false;
+				_writing = true;
+				stopping = _stopRequested;
+			}
+
+			_file.write((const char*)full.data(), (std::streamsize)full.size());
+			_file.write((const char*)tail.data(), (std::streamsize)tail.size());
+			_file.flush();
+			full.clear();
+			tail.clear();
+
+			{
+				std::lock_guard<std::mutex> lg(_mutex);
+				_writing = false;
+				_writeGeneration++;
+			}
+			_written.notify_all();
+
+			if (stopping)
+			{
+				return;
+			}
+		}
+	}
+
+	std::vector<PacketCapture::Record> PacketCapture::read(const std::string& path)
+	{
+		std::ifstream file(path, std::ifstream::in | std::ifstream::binary);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Can't open the capture file " + path);
+		}
+
+		char magic[sizeof(captureMagic)];
+		uint32_t version = 0;
+		uint32_t reserved = 0;
+		int64 startTime = 0;
+		if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, captureMagic, sizeof(magic)) != 0
+			|| !readValue(file, version) || !readValue(file, reserved) || !readValue(file, startTime))
+		{
+			throw std::runtime_error("Not a capture file: " + path);
+		}
+		if (version != captureVersion)
+		{
+			throw std::runtime_error("Unsupported capture file version " + std::to_string(version));
+		}
+
+		std::vector<Record> records;
+		uint32_t size;
+		while (readValue(file, size))
+		{
+			Record record;
+			byte direction;
+			uint16_t recordReserved;
+			int64 time;
+			if (!readValue(file, direction) || !readValue(file, record.messageId) || !readValue(file, recordReserved)
+				|| !readValue(file, record.connectionId) || !readValue(file, time))
+			{
+				throw std::runtime_error("Truncated record in the capture file " + path);
+			}
+			record.direction = (Direction)direction;
+			record.time = std::chrono::nanoseconds(time);
+			record.data.resize(size);
+			if (size > 0 && !file.read((char*)record.data.data(), size))
+			{
+				throw std::runtime_error("Truncated record in the capture file " + path);
+			}
+			records.push_back(std::move(record));
+		}
+		return records;
+	}
+};
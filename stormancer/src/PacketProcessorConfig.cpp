@@ -3,7 +3,7 @@
 
 namespace Stormancer
 {
-	PacketProcessorConfig::PacketProcessorConfig(std::map<byte, handlerFunction*>& handlers, std::vector<processorFunction*>& defaultProcessors)
+	PacketProcessorConfig::PacketProcessorConfig(HandlersTable& handlers, std::vector<processorFunction*>& defaultProcessors)
 		: _handlers(handlers),
 		_defaultProcessors(defaultProcessors)
 	{
@@ -15,7 +15,7 @@ namespace Stormancer
 
 	void PacketProcessorConfig::addProcessor(byte msgId, handlerFunction* handler)
 	{
-		if (mapContains(_handlers, msgId))
+		if (_handlers[msgId])
 		{
 			throw std::invalid_argument(std::string("An handler is already registered for id ") + std::to_string(msgId) + ".");
 		}
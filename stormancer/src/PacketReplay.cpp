@@ -0,0 +1,69 @@
+#include "stormancer/stdafx.h"
+#include "stormancer/PacketReplay.h"
+#include "stormancer/MessageIDTypes.h"
+
+namespace Stormancer
+{
+	PacketReplay::PacketReplay(const std::string& path)
+		: PacketReplay(PacketCapture::read(path))
+	{
+	}
+
+	PacketReplay::PacketReplay(std::vector<PacketCapture::Record> records)
+		: _records(std::make_shared<std::vector<PacketCapture::Record>>(std::move(records)))
+	{
+	}
+
+	const std::vector<PacketCapture::Record>& PacketReplay::records() const
+	{
+		return *_records;
+	}
+
+	std::size_t PacketReplay::replay(IPacketDispatcher& dispatcher, std::function<std::shared_ptr<IConnection>(uint64)> connectionResolver, double speed)
+	{
+		std::size_t count = 0;
+		auto start = std::chrono::steady_clock::now();
+		auto records = _records;
+		for (auto& record : *records)
+		{
+			if (record.direction != PacketCapture::Direction::Inbound || record.data.empty())
+			{
+				continue;
+			}
+
+			if (speed > 0)
+			{
+				std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(record.time / speed));
+			}
+
+			std::shared_ptr<IConnection> connection;
+			if (connectionResolver)
+			{
+				connection = connectionResolver(record.connectionId);
+			}
+
+			Packet_ptr packet;
+			if (record.messageId == (byte)MessageIDTypes::ID_ENCRYPTED || record.messageId == (byte)MessageIDTypes::ID_BATCH)
+			{
+				// Encrypted messages are decrypted in place: copy them, so the capture can be replayed again
+				auto data = std::make_shared<std::vector<byte>>(record.data);
+				auto stream = new ibytestream(data->data(), (std::streamsize)data->size());
+				packet.reset(new Packet<>(connection, stream));
+				packet->cleanup += [stream, data]() {
+					delete stream;
+				};
+			}
+			else
+			{
+				auto stream = new ibytestream(record.data.data(), (std::streamsize)record.data.size());
+				packet.reset(new Packet<>(connection, stream));
+				packet->cleanup += [stream, records]() {
+					delete stream;
+				};
+			}
+			dispatcher.dispatchPacket(packet);
+			count++;
+		}
+		return count;
+	}
+};
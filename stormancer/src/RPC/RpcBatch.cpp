@@ -0,0 +1,113 @@
+#include "stormancer/stdafx.h"
+#include "stormancer/RPC/RpcBatch.h"
+#include "stormancer/RPC/RpcPlugin.h"
+
+namespace Stormancer
+{
+	RpcBatch::RpcBatch(RpcService* service, Route_ptr batchRoute, int channelUid)
+		: _service(service)
+		, _batchRoute(batchRoute)
+		, _channelUid(channelUid)
+	{
+	}
+
+	RpcBatch::~RpcBatch()
+	{
+		if (!_calls.empty())
+		{
+			fail(_calls, "The RPC batch was destroyed before being sent");
+		}
+	}
+
+	pplx::task<void> RpcBatch::rpcWriter(const RpcStub& stub, const Writer& writer)
+	{
+		if (!_batchRoute)
+		{
+			return _service->rpcWriter(stub, writer);
+		}
+		return _service->rpcWriterImpl(RpcService::BatchedCall{ this, stub }, writer);
+	}
+
+	std::size_t RpcBatch::size() const
+	{
+		return std::count_if(_calls.begin(), _calls.end(), [](const Call& call) {
+			return !call.request->hasCompleted;
+		});
+	}
+
+	void RpcBatch::send(PacketPriority priority)
+	{
+		std::vector<Call> calls;
+		calls.swap(_calls);
+
+		// The calls cancelled while queued released their request id, which may already be used by another request
+		calls.erase(std::remove_if(calls.begin(), calls.end(), [](const Call& call) {
+			return call.request->hasCompleted;
+		}), calls.end());
+		if (calls.empty())
+		{
+			return;
+		}
+		for (auto& call : calls)
+		{
+			call.request->queued = false;
+		}
+
+		try
+		{
+			_service->_scene->send(_batchRoute, [&calls](obytestream* stream) {
+				*stream << (uint16)calls.size();
+				for (auto& call : calls)
+				{
+					*stream << call.routeHandle;
+					*stream << call.request->id;
+					*stream << (uint32)call.arguments.size();
+					if (!call.arguments.empty())
+					{
+						stream->write(call.arguments.data(), call.arguments.size());
+					}
+				}
+			}, _channelUid, priority, PacketReliability::RELIABLE_ORDERED);
+		}
+		catch (const std::exception& ex)
+		{
+			_service->_logger->log(LogLevel::Error, "RpcBatch", "Failed to send rpc batch", ex.what());
+			fail(calls, ex.what());
+		}
+	}
+
+	void RpcBatch::append(const RpcStub& stub, RpcRequest_ptr request, const Writer& writer)
+	{
+		if (_calls.size() >= 0xffff)
+		{
+			throw std::overflow_error("Too many calls in the RPC batch.");
+		}
+
+		Call call;
+		call.routeHandle = stub._route->handle();
+		call.request = request;
+		request->queued = true;
+		if (writer)
+		{
+			obytestream stream;
+			writer(&stream);
+			call.arguments = stream.bytes();
+		}
+		_calls.push_back(std::move(call));
+	}
+
+	void RpcBatch::fail(std::vector<Call>& calls, const std::string& reason)
+	{
+		for (auto& call : calls)
+		{
+			auto request = call.request;
+			if (!request->hasCompleted)
+			{
+				request->hasCompleted = true;
+				_service->eraseRequest(request);
+				request->observer.on_error(std::make_exception_ptr(std::runtime_error(reason)));
+			}
+		}
+		calls.clear();
+	}
+};
@@ -12,6 +12,8 @@ namespace Stormancer
 	const std::string RpcPlugin::errorRouteName = "stormancer.rpc.error";
 	const std::string RpcPlugin::completeRouteName = "stormancer.rpc.completed";
 	const std::string RpcPlugin::cancellationRouteName = "stormancer.rpc.cancel";
+	const std::string RpcPlugin::batchRouteName = "stormancer.rpc.batch";
+	const std::string RpcPlugin::batchResponsesRouteName = "stormancer.rpc.batch.responses";
 
 	void RpcPlugin::registerSceneDependencies(Scene* scene)
 	{
@@ -57,6 +59,11 @@ namespace Stormancer
 					auto rpcService = scene->dependencyResolver()->resolve<RpcService>().get();
 					rpcService->complete(p);
 				});
+
+				scene->addRoute(batchResponsesRouteName, [=](Packetisp_ptr p) {
+					auto rpcService = scene->dependencyResolver()->resolve<RpcService>().get();
+					rpcService->batchResponses(p);
+				});
 			}
 		}
 	}
@@ -1,6 +1,7 @@
 #include "stormancer/stdafx.h"
 #include "stormancer/RPC/RpcPlugin.h"
 #include "stormancer/RPC/RpcService.h"
+#include "stormancer/RPC/RpcBatch.h"
 #include "stormancer/IActionDispatcher.h"
 
 namespace Stormancer
@@ -16,121 +17,192 @@ namespace Stormancer
 	{
 	}
 
-	rxcpp::observable<Packetisp_ptr> RpcService::rpc_observable(const std::string& route, const Writer& writer, PacketPriority priority)
+	RpcStub RpcService::bind(const std::string& route)
 	{
 		if (!_scene)
 		{
 			throw std::runtime_error("The scene ptr is invalid");
 		}
 
-		auto observable = rxcpp::observable<>::create<Packetisp_ptr>([=](rxcpp::subscriber<Packetisp_ptr> subscriber) {
-			if (!_scene)
-			{
-				throw std::runtime_error("The scene ptr is invalid");
-			}
+		RpcStub stub;
 
-			auto rr = _scene->remoteRoutes();
-			Route_ptr relevantRoute;
+		try
+		{
+			stub._route = _scene->remoteRoute(route);
+		}
+		catch (const std::exception&)
+		{
+			std::string message = std::string() + "The target route '" + route + "' does not exist on the remote host.";
+			_logger->log(LogLevel::Error, "RpcService", message);
+			throw std::runtime_error(message);
+		}
 
-			auto sz = rr.size();
-			for (uint32 i = 0; i < sz; ++i)
-			{
-				auto r = rr[i];
-				if (r->name() == route)
-				{
-					relevantRoute = r;
-					break;
-				}
-			}
+		auto& metadata = stub._route->metadata();
 
-			if (!relevantRoute)
-			{
-				std::string message = std::string() + "The target route '" + route + "' does not exist on the remote host.";
-				_logger->log(LogLevel::Error, "RpcService", message);
-				throw std::runtime_error(message);
-			}
+		auto it = metadata.find(RpcPlugin::pluginName);
+		if (it == metadata.end())
+		{
+			auto errorMsg = std::string() + "The target remote route '" + route + "' is not an RPC route.";
+			_logger->log(LogLevel::Error, "RpcService", errorMsg, route);
+			throw std::runtime_error(errorMsg);
+		}
 
-			auto metadata = relevantRoute->metadata();
+		if (it->second != RpcPlugin::version)
+		{
+			auto errorMsg = std::string() + "The target remote route '" + route + "' does not support the plugin RPC version " + RpcPlugin::version;
+			_logger->log(LogLevel::Error, "RpcService", errorMsg.c_str(), route);
+			throw std::runtime_error(errorMsg);
+		}
 
-			if (!mapContains(metadata, RpcPlugin::pluginName))
-			{
-				auto errorMsg = std::string() + "The target remote route '" + route + "' is not an RPC route.";
-				_logger->log(LogLevel::Error, "RpcService", errorMsg, route);
-				throw std::runtime_error(errorMsg);
-			}
-			
-			if (metadata[RpcPlugin::pluginName] != RpcPlugin::version)
-			{
-				auto errorMsg = std::string() + "The target remote route '" + route + "' does not support the plugin RPC version " + RpcPlugin::version;
-				_logger->log(LogLevel::Error, "RpcService", errorMsg.c_str(), route);
-				throw std::runtime_error(errorMsg);
-			}
+		stub._channelUid = _scene->getChannelUid(_rpcServerChannelIdentifier);
 
-			RpcRequest_ptr request(new RpcRequest(subscriber));
-			auto id = reserveId();
-			request->id = id;
+		return stub;
+	}
 
-			{
-				std::lock_guard<std::mutex> lock(_pendingRequestsMutex);
-				_pendingRequests[id] = request;
-			}
+	RpcBatch RpcService::batch()
+	{
+		if (!_scene)
+		{
+			throw std::runtime_error("The scene ptr is invalid");
+		}
 
-			try
-			{
-				_scene->send(route, [=](obytestream* bs) {
-					*bs << id;
-					if (writer)
-					{
-						writer(bs);
-					}
-				}, priority, PacketReliability::RELIABLE_ORDERED, _rpcServerChannelIdentifier);
-			}
-			catch (std::exception& ex)
+		Route_ptr batchRoute;
+		auto remoteRoutes = _scene->remoteRoutes();
+		for (auto& route : remoteRoutes)
+		{
+			if (route->name() == RpcPlugin::batchRouteName)
 			{
-				subscriber.on_error(std::make_exception_ptr(ex));
-				_logger->log(LogLevel::Error, "RpcService", ("Failed to send rpc packet on route " + route).c_str(), ex.what());
-				return;
+				batchRoute = route;
+				break;
 			}
+		}
+
+		return RpcBatch(this, batchRoute, _scene->getChannelUid(_rpcServerChannelIdentifier));
+	}
+
+	rxcpp::observable<Packetisp_ptr> RpcService::rpc_observable(const std::string& route, const Writer& writer, PacketPriority priority)
+	{
+		if (!_scene)
+		{
+			throw std::runtime_error("The scene ptr is invalid");
+		}
+
+		auto observable = rxcpp::observable<>::create<Packetisp_ptr>([=](rxcpp::subscriber<Packetisp_ptr> subscriber) {
+			sendRpc(bind(route), subscriber, writer, priority);
+		});
+
+		return observable.as_dynamic();
+	}
+
+	rxcpp::observable<Packetisp_ptr> RpcService::rpc_observable(const RpcStub& stub, const Writer& writer, PacketPriority priority)
+	{
+		if (!_scene)
+		{
+			throw std::runtime_error("The scene ptr is invalid");
+		}
+		if (!stub._route)
+		{
+			throw std::invalid_argument("The rpc stub is not bound to a route");
+		}
+
+		auto observable = rxcpp::observable<>::create<Packetisp_ptr>([=](rxcpp::subscriber<Packetisp_ptr> subscriber) {
+			sendRpc(stub, subscriber, writer, priority);
+		});
 
-			subscriber.add([=]() {
-				if (!request->hasCompleted)
+		return observable.as_dynamic();
+	}
+
+	rxcpp::observable<Packetisp_ptr> RpcService::rpc_observable(const BatchedCall& call, const Writer& writer, PacketPriority)
+	{
+		auto observable = rxcpp::observable<>::create<Packetisp_ptr>([=](rxcpp::subscriber<Packetisp_ptr> subscriber) {
+			auto request = reserveRequest(subscriber);
+			call.batch->append(call.stub, request, writer);
+			addCancellation(subscriber, request);
+		});
+
+		return observable.as_dynamic();
+	}
+
+	void RpcService::sendRpc(const RpcStub& stub, rxcpp::subscriber<Packetisp_ptr> subscriber, const Writer& writer, PacketPriority priority)
+	{
+		if (!_scene)
+		{
+			throw std::runtime_error("The scene ptr is invalid");
+		}
+
+		auto request = reserveRequest(subscriber);
+		auto id = request->id;
+
+		try
+		{
+			_scene->send(stub._route, [=](obytestream* bs) {
+				*bs << id;
+				if (writer)
 				{
+					writer(bs);
+				}
+			}, stub._channelUid, priority, PacketReliability::RELIABLE_ORDERED);
+		}
+		catch (std::exception& ex)
+		{
+			subscriber.on_error(std::make_exception_ptr(ex));
+			_logger->log(LogLevel::Error, "RpcService", ("Failed to send rpc packet on route " + stub.route()).c_str(), ex.what());
+			return;
+		}
+
+		addCancellation(subscriber, request);
+	}
+
+	RpcRequest_ptr RpcService::reserveRequest(rxcpp::subscriber<Packetisp_ptr> subscriber)
+	{
+		RpcRequest_ptr request(new RpcRequest(subscriber));
+		try
+		{
+			request->id = _pendingRequests.reserve(request);
+		}
+		catch (const std::overflow_error&)
+		{
+			throw std::overflow_error("Unable to create a new RPC request: Too many pending requests.");
+		}
+#ifdef STORMANCER_LOG_RPC
+		STORMANCER_LOG(_logger, LogLevel::Trace, "RpcService", "Create RPC", std::to_string(request->id));
+#endif
+		return request;
+	}
+
+	void RpcService::addCancellation(rxcpp::subscriber<Packetisp_ptr> subscriber, RpcRequest_ptr request)
+	{
+		subscriber.add([=]() {
+			if (!request->hasCompleted)
+			{
 #ifdef STORMANCER_LOG_RPC
-					auto idStr = std::to_string(request->id);
-					_logger->log(LogLevel::Trace, "RpcService", "Cancel RPC", idStr.c_str());
+				auto idStr = std::to_string(request->id);
+				STORMANCER_LOG(_logger, LogLevel::Trace, "RpcService", "Cancel RPC", idStr.c_str());
 #endif
-					if (_scene && _scene->getCurrentConnectionState() == ConnectionState::Connected)
+				// A call still queued in a batch is skipped when the batch is sent: the server doesn't know it
+				request->hasCompleted = true;
+				if (!request->queued && _scene && _scene->getCurrentConnectionState() == ConnectionState::Connected)
+				{
+					try
 					{
-						try
-						{
-							_scene->send(RpcPlugin::cancellationRouteName, [=](obytestream* bs)
-							{
-								*bs << request->id;
-							}, PacketPriority::IMMEDIATE_PRIORITY, PacketReliability::RELIABLE_ORDERED, _rpcServerChannelIdentifier);
-						}
-						catch (std::exception& e)
+						_scene->send(RpcPlugin::cancellationRouteName, [=](obytestream* bs)
 						{
-							_logger->log(LogLevel::Error, "RpcService", "Failed to send rpc cancellation packet", e.what());
-						}
+							*bs << request->id;
+						}, PacketPriority::IMMEDIATE_PRIORITY, PacketReliability::RELIABLE_ORDERED, _rpcServerChannelIdentifier);
+					}
+					catch (std::exception& e)
+					{
+						_logger->log(LogLevel::Error, "RpcService", "Failed to send rpc cancellation packet", e.what());
 					}
-					eraseRequest(request->id);
 				}
-			});
+				eraseRequest(request);
+			}
 		});
-
-		return observable.as_dynamic();
 	}
 
 	uint16 RpcService::pendingRequests()
 	{
-		uint16 size = 0;
-
-		{
-			std::lock_guard<std::mutex> lock(_pendingRequestsMutex);
-			size = (uint16)_pendingRequests.size();
-		}
-
-		return size;
+		return (uint16)_pendingRequests.size();
 	}
 
 	void RpcService::addProcedure(const std::string& route, std::function<pplx::task<void>(RpcRequestContext_ptr)> handler, MessageOriginFilter filter, bool ordered)
@@ -198,47 +270,12 @@ namespace Stormancer
 		}
 	}
 
-	uint16 RpcService::reserveId()
-	{
-		uint32 i = 0;
-
-		std::lock_guard<std::mutex> lock(_pendingRequestsMutex);
-
-		static uint16 id = 0;
-
-		while (i <= 0xffff)
-		{
-			i++;
-			id++;
-
-			if (!mapContains(_pendingRequests, id))
-			{
-#ifdef STORMANCER_LOG_RPC
-				auto idStr = std::to_string(id);
-				_logger->log(LogLevel::Trace, "RpcService", "Create RPC", idStr.c_str());
-#endif
-				return id;
-				break;
-			}
-		}
-
-		throw std::overflow_error("Unable to create a new RPC request: Too many pending requests.");
-	}
-
 	RpcRequest_ptr RpcService::getPendingRequest(Packetisp_ptr packet)
 	{
 		uint16 id = 0;
 		*packet->stream >> id;
 
-		RpcRequest_ptr request;
-
-		{
-			std::lock_guard<std::mutex> lock(_pendingRequestsMutex);
-			if (mapContains(_pendingRequests, id))
-			{
-				request = _pendingRequests[id];
-			}
-		}
+		auto request = _pendingRequests.get(id);
 
 		if (!request)
 		{
@@ -249,13 +286,12 @@ namespace Stormancer
 		return request;
 	}
 
-	void RpcService::eraseRequest(uint16 requestId)
+	void RpcService::eraseRequest(const RpcRequest_ptr& request)
 	{
-		std::lock_guard<std::mutex> lock(_pendingRequestsMutex);
 #ifdef STORMANCER_LOG_RPC
-		_logger->log(LogLevel::Trace, "RpcService", "Erase RPC", std::to_string(requestId));
+		STORMANCER_LOG(_logger, LogLevel::Trace, "RpcService", "Erase RPC", std::to_string(request->id));
 #endif
-		_pendingRequests.erase(requestId);
+		_pendingRequests.remove(request->id, request.get());
 	}
 
 	void RpcService::next(Packetisp_ptr packet)
@@ -265,7 +301,7 @@ namespace Stormancer
 		{
 #ifdef STORMANCER_LOG_RPC
 			auto idstr = std::to_string(request->id);
-			_logger->log(LogLevel::Trace, "RpcService", "RPC next", idstr.c_str());
+			STORMANCER_LOG(_logger, LogLevel::Trace, "RpcService", "RPC next", idstr.c_str());
 #endif
 			request->observer.on_next(packet);
 			if (!request->task.is_done())
@@ -282,11 +318,11 @@ namespace Stormancer
 		{
 #ifdef STORMANCER_LOG_RPC
 			auto idstr = std::to_string(request->id);
-			_logger->log(LogLevel::Trace, "RpcService", "RPC error", idstr.c_str());
+			STORMANCER_LOG(_logger, LogLevel::Trace, "RpcService", "RPC error", idstr.c_str());
 #endif
 			request->hasCompleted = true;
 
-			eraseRequest(request->id);
+			eraseRequest(request);
 
 			std::string msg = _serializer.deserializeOne<std::string>(packet->stream);
 			
@@ -305,9 +341,9 @@ namespace Stormancer
 		{
 #ifdef STORMANCER_LOG_RPC
 			auto idstr = std::to_string(request->id);
-			_logger->log(LogLevel::Trace, "RpcService", "RPC complete", idstr.c_str());
+			STORMANCER_LOG(_logger, LogLevel::Trace, "RpcService", "RPC complete", idstr.c_str());
 			std::string messageSentStr = std::string() + "messageSent == " + (messageSent ? "true" : "false");
-			_logger->log(LogLevel::Trace, "RpcService", messageSentStr.c_str(), idstr.c_str());
+			STORMANCER_LOG(_logger, LogLevel::Trace, "RpcService", messageSentStr.c_str(), idstr.c_str());
 #endif
 			request->hasCompleted = true;
 			if (!messageSent)
@@ -319,12 +355,60 @@ namespace Stormancer
 			}
 
 			request->task.then([=](pplx::task<void> t) {
-				eraseRequest(request->id);
+				eraseRequest(request);
 				request->observer.on_completed();
 			});
 		}
 	}
 
+	void RpcService::batchResponses(Packetisp_ptr packet)
+	{
+		uint16 count = 0;
+		*packet->stream >> count;
+
+		for (uint16 i = 0; i < count; i++)
+		{
+			byte kind = 0;
+			uint32 length = 0;
+			*packet->stream >> kind;
+			*packet->stream >> length;
+
+			auto data = std::make_shared<std::vector<byte>>(length);
+			if (length > 0)
+			{
+				packet->stream->read(data->data(), length);
+			}
+			if (!packet->stream->good())
+			{
+				_logger->log(LogLevel::Error, "RpcService", "Truncated RPC batch response frame");
+				return;
+			}
+
+			auto stream = new ibytestream(data->data(), length);
+			Packetisp_ptr response(new Packet<IScenePeer>(packet->connection, stream, packet->metadata));
+			response->route = packet->route;
+			response->cleanup += [stream, data]() {
+				delete stream;
+			};
+
+			switch (kind)
+			{
+			case 0:
+				next(response);
+				break;
+			case 1:
+				error(response);
+				break;
+			case 2:
+				complete(response);
+				break;
+			default:
+				_logger->log(LogLevel::Warn, "RpcService", "Unknown RPC batch response kind", std::to_string(kind));
+				break;
+			}
+		}
+	}
+
 	void RpcService::cancel(Packetisp_ptr packet)
 	{
 		uint16 id = 0;
@@ -332,10 +416,10 @@ namespace Stormancer
 
 #ifdef STORMANCER_LOG_RPC
 		auto idstr = std::to_string(id);
-		_logger->log(LogLevel::Trace, "RpcService", "cancel RPC", idstr.c_str());
+		STORMANCER_LOG(_logger, LogLevel::Trace, "RpcService", "cancel RPC", idstr.c_str());
 #endif
 		{
-			std::lock_guard<std::mutex> lock(_pendingRequestsMutex);
+			std::lock_guard<std::mutex> lock(_runningRequestsMutex);
 			if (mapContains(_runningRequests, id))
 			{
 				auto cts = _runningRequests[id];
@@ -356,25 +440,16 @@ namespace Stormancer
 			_runningRequests.clear();
 		}
 
-		std::map<uint16, RpcRequest_ptr> pendingRequestsCopy;
+		auto pendingRequests = _pendingRequests.takeAll();
 
+		for (auto request : pendingRequests)
 		{
-			std::lock_guard<std::mutex> lock(_pendingRequestsMutex);
-			pendingRequestsCopy = _pendingRequests;
-		}
-
-		for (auto pair : pendingRequestsCopy)
-		{
-			if (!pair.second->hasCompleted)
+			if (!request->hasCompleted)
 			{
-				pair.second->observer.on_error(std::make_exception_ptr<std::runtime_error>(std::runtime_error(reason)));
+				request->hasCompleted = true;
+				request->observer.on_error(std::make_exception_ptr<std::runtime_error>(std::runtime_error(reason)));
 			}
 		}
-
-		{
-			std::lock_guard<std::mutex> lock(_pendingRequestsMutex);
-			_pendingRequests.clear();
-		}
 	}
 
 	std::shared_ptr<IActionDispatcher> RpcService::getDispatcher()
@@ -384,28 +459,11 @@ namespace Stormancer
 
 	pplx::task<void> RpcService::rpcWriter(const std::string& procedure, const Writer& writer)
 	{
-		pplx::task_completion_event<void> tce;
-
-		auto observable = rpc_observable(procedure, writer, PacketPriority::MEDIUM_PRIORITY);
-
-		observable.subscribe([](Packetisp_ptr packet) {
-			// On next
-		}, [=](std::exception_ptr exptr) {
-			// On error
-			try
-			{
-				std::rethrow_exception(exptr);
-			}
-			catch (const std::exception& ex)
-			{
-				_logger->log(LogLevel::Warn, "RpcHelpers", "An exception occurred during the rpc '" + procedure + "'", ex.what());
-				tce.set_exception(ex);
-			}
-		}, [=]() {
-			// On complete
-			tce.set();
-		});
+		return rpcWriterImpl(procedure, writer);
+	}
 
-		return pplx::create_task(tce, pplx::task_options(getDispatcher()));
+	pplx::task<void> RpcService::rpcWriter(const RpcStub& stub, const Writer& writer)
+	{
+		return rpcWriterImpl(stub, writer);
 	}
 };
@@ -3,6 +3,7 @@
 #include "stormancer/Logger/ILogger.h"
 #include "stormancer/AES/AESPacketTransform.h"
 #include "stormancer/AES/IAES.h"
+#include "stormancer/MessageIDTypes.h"
 
 namespace Stormancer
 {
@@ -30,6 +31,11 @@ namespace Stormancer
 		};
 
 		_connectionStateObservable.get_observable().subscribe(onNext, onError);
+
+		if (_dependencyResolver)
+		{
+			_packetTransforms.emplace_back(std::make_shared<AESPacketTransform>(_dependencyResolver->resolve<IAES>()));
+		}
 	}
 
 	RakNetConnection::~RakNetConnection()
@@ -103,6 +109,14 @@ namespace Stormancer
 	{
 		if (_connectionState == ConnectionState::Connected || _connectionState == ConnectionState::Connecting)
 		{
+			try
+			{
+				flushBatches();
+			}
+			catch (const std::exception& ex)
+			{
+				_logger->log(LogLevel::Warn, "RakNetConnection", "Failed to send the coalesced messages before closing the connection", ex.what());
+			}
 			setConnectionState(ConnectionState::Disconnecting);
 			_closeAction("");
 			setConnectionState(ConnectionState::Disconnected);
@@ -124,11 +138,11 @@ namespace Stormancer
 
 	void RakNetConnection::send(const Writer& writer, int channelUid, PacketPriority priority, PacketReliability reliability, const TransformMetadata& transformMetadata)
 	{
-		obytestream stream;
-		std::vector<std::shared_ptr<IPacketTransform>> packetTransforms;
-		packetTransforms.emplace_back(std::make_shared<AESPacketTransform>(_dependencyResolver->resolve<IAES>()));
+		// Serialize in a frame on the stack: only the messages larger than a datagram allocate a buffer
+		byte frame[MAXIMUM_MTU_SIZE];
+		obytestream stream(frame, sizeof(frame), true);
 		Writer writer2 = writer;
-		for (auto& packetTransform : packetTransforms)
+		for (auto& packetTransform : _packetTransforms)
 		{
 			packetTransform->onSend(writer2, this->id(), transformMetadata);
 		}
@@ -142,22 +156,123 @@ namespace Stormancer
 
 #if defined(STORMANCER_LOG_PACKETS) || defined(STORMANCER_LOG_RAKNET_PACKETS)
 		auto bytes2 = stringifyBytesArray(stream.bytes(), true);
-		_logger->log(LogLevel::Trace, "RakNetConnection", "Send packet to scene", bytes2.c_str());
+		STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetConnection", "Send packet to scene", bytes2.c_str());
 #endif
 
 		auto peer = _peer.lock();
-		if (peer)
+		if (!peer)
+		{
+			throw std::runtime_error("RakNet::RakPeerInterface has been destroyed.");
+		}
+
+		char orderingChannel = channelUid % 16;
+		if (_coalescingSize == 0)
+		{
+			sendDatagram(peer.get(), dataPtr, dataSize, priority, reliability, orderingChannel);
+			return;
+		}
+
+		// One batch per ordering channel, so the messages of a channel are always sent in order
+		std::lock_guard<std::mutex> lock(_batchesMutex);
+		auto it = std::find_if(_batches.begin(), _batches.end(), [=](const Batch& batch) {
+			return batch.orderingChannel == orderingChannel;
+		});
+
+		// The length of a coalesced message is written on 16 bits: bigger messages are always sent alone
+		std::size_t entrySize = sizeof(uint16) + (std::size_t)dataSize;
+		if (priority == PacketPriority::IMMEDIATE_PRIORITY || entrySize > _coalescingSize / 2 || dataSize > (std::streamsize)std::numeric_limits<uint16>::max())
 		{
-			char orderingChannel = channelUid % 16;
-			auto result = peer->Send((const char*)dataPtr, (int)dataSize, priority, reliability, orderingChannel, _guid, false);
-			if (result == 0)
+			// Keep the order of the messages of the channel
+			if (it != _batches.end())
 			{
-				throw std::runtime_error("Raknet failed to send the message.");
+				sendBatch(peer.get(), *it);
 			}
+			sendDatagram(peer.get(), dataPtr, dataSize, priority, reliability, orderingChannel);
+			return;
+		}
+
+		if (it == _batches.end())
+		{
+			_batches.emplace_back();
+			it = _batches.end() - 1;
+			it->orderingChannel = orderingChannel;
+			it->data.reserve(_coalescingSize);
+		}
+		else if (it->priority != priority || it->reliability != reliability || it->data.size() + entrySize > _coalescingSize)
+		{
+			sendBatch(peer.get(), *it);
+		}
+		it->priority = priority;
+		it->reliability = reliability;
+
+		if (it->data.empty())
+		{
+			it->data.push_back((byte)MessageIDTypes::ID_BATCH);
+		}
+		uint16 length = (uint16)dataSize;
+		const byte* lengthPtr = (const byte*)&length;
+		it->data.insert(it->data.end(), lengthPtr, lengthPtr + sizeof(uint16));
+		it->data.insert(it->data.end(), dataPtr, dataPtr + dataSize);
+		it->count++;
+	}
+
+	void RakNetConnection::flushBatches()
+	{
+		if (_coalescingSize == 0)
+		{
+			return;
+		}
+
+		auto peer = _peer.lock();
+		if (!peer)
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(_batchesMutex);
+		for (auto& batch : _batches)
+		{
+			sendBatch(peer.get(), batch);
+		}
+	}
+
+	void RakNetConnection::sendBatch(RakNet::RakPeerInterface* peer, Batch& batch)
+	{
+		if (batch.count == 0)
+		{
+			return;
+		}
+
+		// The batch is reset even if the send fails, like a message sent directly
+		int count = batch.count;
+		batch.count = 0;
+		std::vector<byte> data;
+		data.swap(batch.data);
+		batch.data.reserve(_coalescingSize);
+
+		if (count == 1)
+		{
+			// Skip the batch header: the single message is sent as if it was not coalesced
+			std::size_t headerSize = 1 + sizeof(uint16);
+			sendDatagram(peer, data.data() + headerSize, (std::streamsize)(data.size() - headerSize), batch.priority, batch.reliability, batch.orderingChannel);
 		}
 		else
 		{
-			throw std::runtime_error("RakNet::RakPeerInterface has been destroyed.");
+			sendDatagram(peer, data.data(), (std::streamsize)data.size(), batch.priority, batch.reliability, batch.orderingChannel);
+		}
+	}
+
+	void RakNetConnection::sendDatagram(RakNet::RakPeerInterface* peer, const byte* data, std::streamsize size, PacketPriority priority, PacketReliability reliability, char orderingChannel)
+	{
+		auto result = peer->Send((const char*)data, (int)size, priority, reliability, orderingChannel, _guid, false);
+		if (result == 0)
+		{
+			throw std::runtime_error("Raknet failed to send the message.");
+		}
+
+		if (_capture)
+		{
+			_capture->record(PacketCapture::Direction::Outbound, _id, data, (std::size_t)size);
 		}
 	}
 
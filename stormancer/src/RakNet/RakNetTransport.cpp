@@ -16,28 +16,51 @@
 
 namespace Stormancer
 {
+	static bool allCanceled(const std::vector<ConnectionRequest>& requests)
+	{
+		for (auto& rq : requests)
+		{
+			if (!rq.cancellationToken.is_canceled())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
 	RakNetTransport::RakNetTransport(DependencyResolver* resolver)
 		: _dependencyResolver(resolver)
 		, _logger(resolver->resolve<ILogger>())
 		, _scheduler(resolver->resolve<IScheduler>())
 	{
+		auto config = resolver->resolve<Configuration>();
+		if (config)
+		{
+			_receiveMode = config->transportReceiveMode;
+			_pollInterval = config->transportPollInterval;
+			_sendCoalescingSize = config->sendCoalescingSize;
+			if (!config->packetCapturePath.empty())
+			{
+				_capture = std::make_shared<PacketCapture>(config->packetCapturePath);
+			}
+		}
 	}
 
 	RakNetTransport::~RakNetTransport()
 	{
-		_logger->log(LogLevel::Trace, "RakNetTransport", "Deleting RakNet transport...");
+		STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Deleting RakNet transport...");
 
 		if (_isRunning)
 		{
 			stop();
 		}
 
-		_logger->log(LogLevel::Trace, "RakNetTransport", "RakNet transport deleted");
+		STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "RakNet transport deleted");
 	}
 
 	void RakNetTransport::start(std::string type, std::shared_ptr<IConnectionManager> handler, pplx::cancellation_token ct, uint16 serverPort, uint16 maxConnections)
 	{
-		_logger->log(LogLevel::Trace, "RakNetTransport", "Starting RakNet transport...");
+		STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Starting RakNet transport...");
 
 		if (!compareExchange(_mutex, _isRunning, false, true))
 		{
@@ -53,26 +76,35 @@ namespace Stormancer
 		_handler = handler;
 		initialize(maxConnections, serverPort);
 
-		_scheduler->schedulePeriodic(15, STRM_SAFE_CAPTURE([this]() {
-			std::lock_guard<std::mutex> lock(_mutex);
-			if (_isRunning)
-			{
-				run();
-			}
-		}), ct);
+		if (_receiveMode == TransportReceiveMode::EVENT_DRIVEN)
+		{
+			_receiveThread = std::thread([this]() {
+				receiveLoop();
+			});
+		}
+		else
+		{
+			_scheduler->schedulePeriodic(_pollInterval, STRM_SAFE_CAPTURE([this]() {
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (_isRunning)
+				{
+					run();
+				}
+			}), ct);
+		}
 
 		ct.register_callback(STRM_SAFE_CAPTURE([this]() {
 			stop();
 		}));
 
-		_logger->log(LogLevel::Trace, "RakNetTransport", "RakNet transport started");
+		STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "RakNet transport started");
 	}
 
 	void RakNetTransport::initialize(uint16 maxConnections, uint16 serverPort)
 	{
 		try
 		{
-			_logger->log(LogLevel::Trace, "RakNetTransport", "Initializing raknet transport", _type.c_str());
+			STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Initializing raknet transport", _type.c_str());
 
 			RakNet::PacketFileLogger* rakNetLogger = nullptr;
 #ifdef STORMANCER_PACKETFILELOGGER
@@ -80,19 +112,27 @@ namespace Stormancer
 			rakNetLogger->StartLog("packetLogs");
 #endif
 
-			_peer = std::shared_ptr<RakNet::RakPeerInterface>(RakNet::RakPeerInterface::GetInstance(), STRM_SAFE_CAPTURE([=](RakNet::RakPeerInterface* peer) {
-				_logger->log(LogLevel::Trace, "RakNetTransport", "Deleting RakPeerInterface...");
+			// The peer can outlive the transport, so the deleter must not capture the transport
+			auto logger = _logger;
+			_peer = std::shared_ptr<RakNet::RakPeerInterface>(RakNet::RakPeerInterface::GetInstance(), [logger, rakNetLogger](RakNet::RakPeerInterface* peer) {
+				STORMANCER_LOG(logger, LogLevel::Trace, "RakNetTransport", "Deleting RakPeerInterface...");
 				RakNet::RakPeerInterface::DestroyInstance(peer);
 				if (rakNetLogger)
 				{
 					delete rakNetLogger;
 				}
-			}));
+			});
 
 #ifdef STORMANCER_PACKETFILELOGGER
 			_peer->AttachPlugin(rakNetLogger);
 #endif
 
+			// Each received packet owns the peer which allocated it, so the peer lives until its last packet is deallocated,
+			// even after the transport stopped or restarted with another peer
+			_packetPool->setBufferReleaser([](void* rakNetPacket, void* peer) {
+				((RakNet::RakPeerInterface*)peer)->DeallocatePacket((RakNet::Packet*)rakNetPacket);
+			});
+
 			_dependencyResolver->registerDependency(_peer);
 			if (serverPort != 0)
 			{
@@ -111,7 +151,7 @@ namespace Stormancer
 				throw std::runtime_error(std::string("RakNet peer startup failed (RakNet::StartupResult == ") + std::to_string(startupResult) + ')');
 			}
 			_peer->SetMaximumIncomingConnections(maxConnections);
-			_logger->log(LogLevel::Trace, "RakNetTransport", "Raknet transport initialized", _type.c_str());
+			STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Raknet transport initialized", _type.c_str());
 		}
 		catch (const std::exception& ex)
 		{
@@ -138,7 +178,7 @@ namespace Stormancer
 #ifdef STORMANCER_LOG_RAKNET_PACKETS
 				std::vector<byte> receivedData(rakNetPacket->data, rakNetPacket->data + rakNetPacket->length);
 				auto bytes = stringifyBytesArray(receivedData, true);
-				_logger->log(LogLevel::Trace, "RakNetTransport", "RakNet packet received", bytes.c_str());
+				STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "RakNet packet received", bytes.c_str());
 #endif
 
 				try
@@ -151,30 +191,34 @@ namespace Stormancer
 						std::lock_guard<std::mutex> lg(_pendingConnection_mtx);
 
 						std::string packetSystemAddressStr = rakNetPacket->systemAddress.ToString(true, ':');
-						if (!_pendingConnections.empty())
+						auto it = _pendingConnections.find(packetSystemAddressStr);
+						if (it != _pendingConnections.end())
 						{
-							auto rq = _pendingConnections.front();
 							if (!_serverConnected)
 							{
-								_pendingConnections.pop();
-								if (rq.cancellationToken.is_canceled())
+								auto requests = std::move(it->second);
+								_pendingConnections.erase(it);
+								if (allCanceled(requests))
 								{
 									_peer->CloseConnection(rakNetPacket->guid, false);
 								}
 								else
 								{
-									_logger->log(LogLevel::Trace, "RakNetTransport", "Connection request accepted", packetSystemAddressStr.c_str());
+									STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Connection request accepted", packetSystemAddressStr.c_str());
 									_serverConnected = true;
 									_serverRakNetGUID = rakNetPacket->guid;
 									auto connection = onConnection(rakNetPacket->systemAddress, rakNetPacket->guid, 0);
-									rq.tce.set(connection);
+									for (auto& rq : requests)
+									{
+										rq.tce.set(connection);
+									}
 								}
-								startNextPendingConnections();
 							}
 							else
 							{
-								if (rq.cancellationToken.is_canceled())
+								if (allCanceled(it->second))
 								{
+									_pendingConnections.erase(it);
 									_peer->CloseConnection(rakNetPacket->guid, false);
 								}
 								else
@@ -189,7 +233,9 @@ namespace Stormancer
 						}
 						else
 						{
-							_logger->log(LogLevel::Error, "RakNetTransport", "Can't get the pending connection TCE", packetSystemAddressStr.c_str());
+							// The request was canceled while the remote peer accepted it
+							STORMANCER_LOG(_logger, LogLevel::Debug, "RakNetTransport", "No pending connection request, it was canceled", packetSystemAddressStr.c_str());
+							_peer->CloseConnection(rakNetPacket->guid, true);
 						}
 						break;
 					}
@@ -197,37 +243,19 @@ namespace Stormancer
 					case DefaultMessageIDTypes::ID_NO_FREE_INCOMING_CONNECTIONS:
 					case DefaultMessageIDTypes::ID_CONNECTION_ATTEMPT_FAILED:
 					{
-						std::string packetSystemAddressStr = rakNetPacket->systemAddress.ToString(true, ':');
-
-						//_peer->CloseConnection(rakNetPacket->guid, false);
-
-						std::lock_guard<std::mutex> lg(_pendingConnection_mtx);
-
-						if (!_pendingConnections.empty())
-						{
-							auto rq = _pendingConnections.front();
-							_pendingConnections.pop();
-							if (!rq.cancellationToken.is_canceled())
-							{
-								_logger->log(LogLevel::Trace, "RakNetTransport", "Connection request failed", packetSystemAddressStr.c_str());
-								rq.tce.set_exception(std::runtime_error("Connection attempt failed"));
-							}
-							startNextPendingConnections();
-						}
-						else
-						{
-							_logger->log(LogLevel::Error, "RakNetTransport", "Can't get the pending connection TCE", packetSystemAddressStr.c_str());
-						}
+						STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Connection request failed", rakNetPacket->systemAddress.ToString(true, ':'));
+						failPendingConnections(rakNetPacket->systemAddress, "Connection attempt failed");
 						break;
 					}
 					case DefaultMessageIDTypes::ID_ALREADY_CONNECTED:
 					{
 						_logger->log(LogLevel::Error, "RakNetTransport", "Peer already connected", rakNetPacket->systemAddress.ToString(true, ':'));
+						failPendingConnections(rakNetPacket->systemAddress, "Peer already connected");
 						break;
 					}
 					case DefaultMessageIDTypes::ID_NEW_INCOMING_CONNECTION:
 					{
-						_logger->log(LogLevel::Trace, "RakNetTransport", "Incoming connection", rakNetPacket->systemAddress.ToString(true, ':'));
+						STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Incoming connection", rakNetPacket->systemAddress.ToString(true, ':'));
 						RakNet::BitStream data;
 						data.Write((char)MessageIDTypes::ID_ADVERTISE_PEERID);
 						data.Write(_id);
@@ -237,36 +265,39 @@ namespace Stormancer
 					}
 					case DefaultMessageIDTypes::ID_DISCONNECTION_NOTIFICATION:
 					{
-						_logger->log(LogLevel::Trace, "RakNetTransport", "Peer disconnected", rakNetPacket->systemAddress.ToString(true, ':'));
+						STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Peer disconnected", rakNetPacket->systemAddress.ToString(true, ':'));
 						onDisconnection(rakNetPacket, "CLIENT_DISCONNECTED");
 						break;
 					}
 					case DefaultMessageIDTypes::ID_CONNECTION_LOST:
 					{
-						_logger->log(LogLevel::Trace, "RakNetTransport", "Peer lost the connection", rakNetPacket->systemAddress.ToString(true, ':'));
+						STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Peer lost the connection", rakNetPacket->systemAddress.ToString(true, ':'));
 						onDisconnection(rakNetPacket, "CLIENT_CONNECTION_LOST");
 						break;
 					}
 					case DefaultMessageIDTypes::ID_CONNECTION_BANNED:
 					{
-						_logger->log(LogLevel::Trace, "RakNetTransport", "We are banned from the system we attempted to connect to", rakNetPacket->systemAddress.ToString(true, ':'));
+						STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "We are banned from the system we attempted to connect to", rakNetPacket->systemAddress.ToString(true, ':'));
+						failPendingConnections(rakNetPacket->systemAddress, "Banned from the remote system");
 						break;
 					}
 					case DefaultMessageIDTypes::ID_INVALID_PASSWORD:
 					{
-						_logger->log(LogLevel::Trace, "RakNetTransport", "The remote system is using a password and has refused our connection because we did not set the correct password", rakNetPacket->systemAddress.ToString(true, ':'));
+						STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "The remote system is using a password and has refused our connection because we did not set the correct password", rakNetPacket->systemAddress.ToString(true, ':'));
+						failPendingConnections(rakNetPacket->systemAddress, "Invalid password");
 						break;
 					}
 					case DefaultMessageIDTypes::ID_IP_RECENTLY_CONNECTED:
 					{
-						_logger->log(LogLevel::Trace, "RakNetTransport", "this IP address connected recently, and can't connect again as a security measure", rakNetPacket->systemAddress.ToString(true, ':'));
+						STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "this IP address connected recently, and can't connect again as a security measure", rakNetPacket->systemAddress.ToString(true, ':'));
+						failPendingConnections(rakNetPacket->systemAddress, "IP address recently connected");
 						break;
 					}
 					case DefaultMessageIDTypes::ID_UNCONNECTED_PONG:
 					{
 
 						auto address = std::string(rakNetPacket->systemAddress.ToString(true, ':'));
-						_logger->log(LogLevel::Debug, "RakNetTransport", "Received pong message.", address);
+						STORMANCER_LOG(_logger, LogLevel::Debug, "RakNetTransport", "Received pong message.", address);
 						RakNet::BitStream data(rakNetPacket->data + 1, rakNetPacket->length - 1, false);
 						RakNet::TimeMS sentOn;
 
@@ -286,7 +317,7 @@ namespace Stormancer
 					}
 					case DefaultMessageIDTypes::ID_ADVERTISE_SYSTEM:
 					{
-						_logger->log(LogLevel::Trace, "RakNetTransport", "Inform a remote system of our IP/Port", rakNetPacket->systemAddress.ToString(true, ':'));
+						STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Inform a remote system of our IP/Port", rakNetPacket->systemAddress.ToString(true, ':'));
 						break;
 					}
 					// Stormancer messages types
@@ -294,7 +325,7 @@ namespace Stormancer
 					{
 						int64 sid;
 						std::memcpy(&sid, (rakNetPacket->data + 1), sizeof(sid));
-						_logger->log(LogLevel::Trace, "RakNetTransport", "Connection ID received", std::to_string(sid));
+						STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Connection ID received", std::to_string(sid));
 						onConnectionIdReceived(sid);
 						break;
 					}
@@ -310,21 +341,30 @@ namespace Stormancer
 						bool waitingConnection;
 						data.Read(waitingConnection);
 
-						if (waitingConnection)
+						if (_serverConnected && rakNetPacket->guid == _serverRakNetGUID)
 						{
-							auto rq = _pendingConnections.front();
-							_pendingConnections.pop();
-							if (rq.cancellationToken.is_canceled())
+							// The server connection was completed when it was accepted
+						}
+						else if (waitingConnection)
+						{
+							auto requests = takePendingConnections(rakNetPacket->systemAddress);
+							if (requests.empty())
+							{
+								_logger->log(LogLevel::Error, "RakNetTransport", "Can't get the pending connection TCE", packetSystemAddressStr.c_str());
+							}
+							else if (allCanceled(requests))
 							{
 								_peer->CloseConnection(rakNetPacket->guid, false);
 							}
 							else
 							{
-								_logger->log(LogLevel::Trace, "RakNetTransport", "Connection request accepted", packetSystemAddressStr.c_str());
+								STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Connection request accepted", packetSystemAddressStr.c_str());
 								auto connection = onConnection(rakNetPacket->systemAddress, rakNetPacket->guid, (uint64)remotePeerId);
-								rq.tce.set(connection);
+								for (auto& rq : requests)
+								{
+									rq.tce.set(connection);
+								}
 							}
-							startNextPendingConnections();
 						}
 						else
 						{
@@ -348,7 +388,7 @@ namespace Stormancer
 						}
 						else
 						{
-							_logger->log(LogLevel::Trace, "RakNetTransport", "Unprocessed RakNet message ID", std::to_string(ID));
+							STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Unprocessed RakNet message ID", std::to_string(ID));
 						}
 						rakNetPacket = nullptr;
 						break;
@@ -364,6 +404,24 @@ namespace Stormancer
 					_logger->log(LogLevel::Error, "RakNetTransport", "An error occured while handling a message", ex.what());
 				}
 			}
+
+			if (_sendCoalescingSize > 0)
+			{
+				for (auto& it : _connections)
+				{
+					if (it.second)
+					{
+						try
+						{
+							it.second->flushBatches();
+						}
+						catch (const std::exception& ex)
+						{
+							_logger->log(LogLevel::Error, "RakNetTransport", "Failed to send the coalesced messages", ex.what());
+						}
+					}
+				}
+			}
 		}
 		catch (const std::exception& ex)
 		{
@@ -371,15 +429,52 @@ namespace Stormancer
 		}
 	}
 
+	void RakNetTransport::receiveLoop()
+	{
+		while (true)
+		{
+			std::shared_ptr<RakNet::RakPeerInterface> peer;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (!_isRunning)
+				{
+					break;
+				}
+				run();
+				peer = _peer;
+			}
+
+			if (!peer)
+			{
+				break;
+			}
+			// Wakes up as soon as RakNet queues a packet, or after the poll interval to run the peer plugins
+			peer->WaitForPacket(_pollInterval);
+		}
+	}
+
 	void RakNetTransport::stop()
 	{
-		_logger->log(LogLevel::Trace, "RakNetTransport", "Stopping RakNet transport...");
+		STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Stopping RakNet transport...");
 
 		if (!compareExchange(_mutex, _isRunning, true, false))
 		{
 			throw std::runtime_error("RakNet transport is not started");
 		}
 
+		if (_receiveThread.joinable())
+		{
+			// The receive thread notices _isRunning is false after at most one poll interval
+			if (_receiveThread.get_id() == std::this_thread::get_id())
+			{
+				_receiveThread.detach();
+			}
+			else
+			{
+				_receiveThread.join();
+			}
+		}
+
 		auto peer = _peer;
 		_peer.reset();
 		if (peer)
@@ -399,7 +494,7 @@ namespace Stormancer
 				_handler.reset();
 			}
 
-			_logger->log(LogLevel::Trace, "RakNetTransport", "RakNet transport stopped");
+			STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "RakNet transport stopped");
 		}
 	}
 
@@ -423,79 +518,148 @@ namespace Stormancer
 
 	pplx::task<std::shared_ptr<IConnection>> RakNetTransport::connect(std::string endpoint, pplx::cancellation_token ct)
 	{
-		std::lock_guard<std::mutex> lock(_pendingConnection_mtx);
-
-		auto shouldStart = _pendingConnections.empty();
 		ConnectionRequest rq;
 		rq.endpoint = endpoint;
 		rq.cancellationToken = ct;
-		_pendingConnections.push(rq);
-		if (shouldStart)
+		auto tce = rq.tce;
+		auto task = pplx::task<std::shared_ptr<IConnection>>(tce, ct);
+
+		auto split = stringSplit(endpoint, ':');
+		if (split.size() < 2)
 		{
-			startNextPendingConnections();
+			tce.set_exception(std::invalid_argument("Bad server endpoint, no port (" + endpoint + ')'));
+			return task;
 		}
 
-		return pplx::task<std::shared_ptr<IConnection>>(rq.tce, ct);
-	}
+		std::string portString = split[1];
+		if (endpoint.size() - 1 <= portString.size())
+		{
+			tce.set_exception(std::invalid_argument("Bad server endpoint, no host (" + endpoint + ')'));
+			return task;
+		}
 
-	void RakNetTransport::startNextPendingConnections()
-	{
-		if (_pendingConnections.empty())
+		auto port = (uint16)std::atoi(portString.c_str());
+		if (port == 0)
 		{
-			return;
+			tce.set_exception(std::runtime_error("Server endpoint port should not be 0 (" + endpoint + ')'));
+			return task;
 		}
 
-		auto rq = _pendingConnections.front();
+		auto hostStr = split[0];
 
-		if (rq.cancellationToken.is_canceled())
+		auto peer = _peer;
+		if (peer == nullptr || !peer->IsActive())
 		{
-			_pendingConnections.pop();
-			startNextPendingConnections();
+			tce.set_exception(std::runtime_error("Transport not started. Make sure you started it."));
+			return task;
 		}
 
-		auto endpoint = rq.endpoint;
-		auto split = stringSplit(endpoint, ':');
-		auto tce = rq.tce;
-		if (split.size() < 2)
+		// Resolve the host once, so the RakNet notifications (which only carry the address) find the request
+		RakNet::SystemAddress address;
+		if (!address.FromStringExplicitPort(hostStr.c_str(), port, peer->GetMyBoundAddress().GetIPVersion()))
 		{
-			tce.set_exception(std::invalid_argument("Bad server endpoint, no port (" + endpoint + ')'));
-			return;
+			tce.set_exception(std::runtime_error("Can't resolve the endpoint host (" + endpoint + ')'));
+			return task;
 		}
 
-		std::string portString = split[1];
-		if (endpoint.size() - 1 <= portString.size())
 		{
-			tce.set_exception(std::invalid_argument("Bad server endpoint, no host (" + endpoint + ')'));
-			return;
+			std::lock_guard<std::mutex> lock(_pendingConnection_mtx);
+
+			_port = port;
+			auto& requests = _pendingConnections[address.ToString(true, ':')];
+			requests.push_back(rq);
+			// Otherwise, an attempt to this address is already running
+			if (requests.size() == 1)
+			{
+				std::string ip = address.ToString(false);
+				auto result = peer->Connect(ip.c_str(), port, nullptr, 0, nullptr, 0, 12, 500, 30000);
+				if (result != RakNet::ConnectionAttemptResult::CONNECTION_ATTEMPT_STARTED)
+				{
+					for (auto& request : takePendingConnections(address))
+					{
+						request.tce.set_exception(std::runtime_error(std::string("Bad RakNet connection attempt result (") + std::to_string(result) + ')'));
+					}
+					return task;
+				}
+			}
 		}
 
-		_port = (uint16)std::atoi(portString.c_str());
-		if (_port == 0)
+		if (ct.is_cancelable())
 		{
-			tce.set_exception(std::runtime_error("Server endpoint port should not be 0 (" + endpoint + ')'));
-			return;
+			// Stop the attempt when nobody waits for it anymore, for instance when another endpoint won a race
+			auto registration = ct.register_callback(STRM_SAFE_CAPTURE_NOTHROW([this, address]()
+			{
+				cancelPendingConnections(address);
+			}));
+
+			// Release the callback once the attempt completed. The request is completed under the pending connections lock,
+			// which the callback takes: deregistering it there would wait for a callback running on another thread.
+			pplx::create_task(tce).then([ct, registration](pplx::task<std::shared_ptr<IConnection>>)
+			{
+				pplx::create_task([ct, registration]()
+				{
+					ct.deregister_callback(registration);
+				});
+			});
 		}
 
-		auto hostStr = split[0];
+		return task;
+	}
 
-		if (_peer == nullptr || !_peer->IsActive())
+	std::vector<ConnectionRequest> RakNetTransport::takePendingConnections(const RakNet::SystemAddress& address)
+	{
+		std::vector<ConnectionRequest> requests;
+		auto it = _pendingConnections.find(address.ToString(true, ':'));
+		if (it != _pendingConnections.end())
 		{
-			tce.set_exception(std::runtime_error("Transport not started. Make sure you started it."));
-			return;
+			requests = std::move(it->second);
+			_pendingConnections.erase(it);
 		}
+		return requests;
+	}
 
-		auto result = _peer->Connect(hostStr.c_str(), _port, nullptr, 0, nullptr, 0, 12, 500, 30000);
-		if (result != RakNet::ConnectionAttemptResult::CONNECTION_ATTEMPT_STARTED)
+	void RakNetTransport::cancelPendingConnections(const RakNet::SystemAddress& address)
+	{
+		std::lock_guard<std::mutex> lg(_pendingConnection_mtx);
+
+		auto it = _pendingConnections.find(address.ToString(true, ':'));
+		if (it == _pendingConnections.end() || !allCanceled(it->second))
 		{
-			tce.set_exception(std::runtime_error(std::string("Bad RakNet connection attempt result (") + std::to_string(result) + ')'));
 			return;
 		}
+		_pendingConnections.erase(it);
+
+		auto peer = _peer;
+		if (peer)
+		{
+			// The request may already be accepted, and waiting for the remote peer id
+			peer->CancelConnectionAttempt(address);
+			peer->CloseConnection(address, true);
+		}
+	}
+
+	void RakNetTransport::failPendingConnections(const RakNet::SystemAddress& address, const std::string& reason)
+	{
+		std::lock_guard<std::mutex> lg(_pendingConnection_mtx);
+
+		auto requests = takePendingConnections(address);
+		if (requests.empty())
+		{
+			STORMANCER_LOG(_logger, LogLevel::Debug, "RakNetTransport", "No pending connection request, it was canceled", address.ToString(true, ':'));
+		}
+		for (auto& rq : requests)
+		{
+			if (!rq.cancellationToken.is_canceled())
+			{
+				rq.tce.set_exception(std::runtime_error(reason));
+			}
+		}
 	}
 
 	std::shared_ptr<RakNetConnection> RakNetTransport::onConnection(RakNet::SystemAddress systemAddress, RakNet::RakNetGUID guid, uint64 peerId)
 	{
 		auto msg = std::string() + systemAddress.ToString(true, ':') + " connected";
-		_logger->log(LogLevel::Trace, "RakNetTransport", msg.c_str());
+		STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", msg.c_str());
 
 		auto connection = createNewConnection(guid, peerId);
 
@@ -513,9 +677,14 @@ namespace Stormancer
 	void RakNetTransport::onDisconnection(RakNet::Packet* packet, std::string reason)
 	{
 		auto msg = std::string() + packet->systemAddress.ToString(true, ':') + " disconnected";
-		_logger->log(LogLevel::Trace, "RakNetTransport", msg.c_str(), reason.c_str());
+		STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", msg.c_str(), reason.c_str());
 
 		auto connection = removeConnection(packet->guid);
+		if (!connection)
+		{
+			// The peer disconnected before advertising its id, or its connection request was canceled
+			return;
+		}
 
 		_handler->closeConnection(connection, reason);
 
@@ -532,25 +701,18 @@ namespace Stormancer
 #if defined(STORMANCER_LOG_PACKETS) && !defined(STORMANCER_LOG_RAKNET_PACKETS)
 		std::vector<byte> tempBytes(rakNetPacket->data, rakNetPacket->data + rakNetPacket->length);
 		auto bytes = stringifyBytesArray(tempBytes, true);
-		_logger->log(LogLevel::Trace, "RakNetTransport", "Packet received", bytes.c_str());
+		STORMANCER_LOG(_logger, LogLevel::Trace, "RakNetTransport", "Packet received", bytes.c_str());
 #endif
 
 		auto connection = getConnection(rakNetPacket->guid);
-		auto stream = new ibytestream((byte*)rakNetPacket->data, (std::streamsize)rakNetPacket->length);
 
-		Packet_ptr packet(new Packet<>(connection, stream), deleter<Packet<>>());
-		auto peer = _peer;
-		packet->cleanup += [=]() {
-			if (stream)
-			{
-				stream->rdbuf()->pubsetbuf(nullptr, 0);
-				delete stream;
-			}
-			if (peer && rakNetPacket)
-			{
-				peer->DeallocatePacket(rakNetPacket);
-			}
-		};
+		if (_capture)
+		{
+			_capture->record(PacketCapture::Direction::Inbound, (connection ? connection->id() : 0), (byte*)rakNetPacket->data, (std::size_t)rakNetPacket->length);
+		}
+
+		// The RakNet packet is deallocated by its peer when the packet returns to the pool
+		Packet_ptr packet = _packetPool->acquire(connection, (byte*)rakNetPacket->data, (std::streamsize)rakNetPacket->length, rakNetPacket, _peer);
 
 		_onPacketReceived(packet);
 	}
@@ -566,6 +728,12 @@ namespace Stormancer
 		{
 			int64 cid = peerId;
 			auto connection = std::make_shared<RakNetConnection>(raknetGuid, cid, _peer, _logger,_dependencyResolver);
+			connection->_capture = _capture;
+			if (_sendCoalescingSize > 0)
+			{
+				// The coalesced messages are smaller than half this size, so their length fits in 16 bits
+				connection->_coalescingSize = (std::size_t)std::min(_sendCoalescingSize, 0xFFFF);
+			}
 			RakNet::RakNetGUID guid(connection->guid());
 			auto logger = _logger;
 			std::weak_ptr<RakNet::RakPeerInterface> weakPeer = _peer;
@@ -573,7 +741,7 @@ namespace Stormancer
 				auto peer = weakPeer.lock();
 				if (peer)
 				{
-					logger->log(LogLevel::Trace, "RakNetTransport", "On close", guid.ToString());
+					STORMANCER_LOG(logger, LogLevel::Trace, "RakNetTransport", "On close", guid.ToString());
 					peer->CloseConnection(guid, true);
 				}
 			});
@@ -590,6 +758,11 @@ namespace Stormancer
 		return connection;
 	}
 
+	std::shared_ptr<PacketPool<>> RakNetTransport::packetPool() const
+	{
+		return _packetPool;
+	}
+
 	bool RakNetTransport::isRunning() const
 	{
 		return _isRunning;
@@ -692,7 +865,7 @@ namespace Stormancer
 
 			if (!sent)
 			{
-				logger->log(LogLevel::Debug, "RakNetTransport", "Pings to " + address + " failed: unreachable address.");
+				STORMANCER_LOG(logger, LogLevel::Debug, "RakNetTransport", "Pings to " + address + " failed: unreachable address.");
 				tce.set(-1);
 			}
 		}, cts.get_token())
@@ -703,7 +876,7 @@ namespace Stormancer
 			}
 			catch (const std::exception&)
 			{
-				logger->log(LogLevel::Debug, "RakNetTransport", "Pings to " + address + " failed: ping cancelled.");
+				STORMANCER_LOG(logger, LogLevel::Debug, "RakNetTransport", "Pings to " + address + " failed: ping cancelled.");
 			}
 		});
 
@@ -718,7 +891,7 @@ namespace Stormancer
 			}
 			catch (std::exception& ex)
 			{
-				_logger->log(LogLevel::Debug, "RakNetTransport", "Ping to " + address + " failed", ex.what());
+				STORMANCER_LOG(_logger, LogLevel::Debug, "RakNetTransport", "Ping to " + address + " failed", ex.what());
 				return -1;
 			}
 		}));
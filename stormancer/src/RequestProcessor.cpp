@@ -182,6 +182,7 @@ namespace Stormancer
 			}
 			catch (const std::exception& ex)
 			{
+				freeRequestSlot(request->id);
 				tce.set_exception(ex);
 			}
 
@@ -195,62 +196,22 @@ namespace Stormancer
 
 	SystemRequest_ptr RequestProcessor::reserveRequestSlot(byte msgId, pplx::task_completion_event<Packet_ptr> tce)
 	{
-		SystemRequest_ptr request;
+		auto request = std::make_shared<SystemRequest>(msgId, tce);
 
-		{ // this scope ensures the static id is not used outside the locked mutex.
-			std::lock_guard<std::mutex> lock(_mutexPendingRequests);
-
-			static uint16 id = 0;
-			// i is used to know if we tested all uint16 available values, whatever the current value of id.
-			uint32 i = 0;
-			while (i <= 0xffff)
-			{
-				id++;
-				i++;
-
-				if (!mapContains(_pendingRequests, id))
-				{
-					request = std::make_shared<SystemRequest>(msgId, tce);
-					request->id = id;
-					_pendingRequests[id] = request;
-					break;
-				}
-				else
-				{
-					std::string unexpectedMsgId;
-					if (_pendingRequests[id])
-					{
-						unexpectedMsgId = "msgId: " + std::to_string(_pendingRequests[id]->operation());
-					}
-					else
-					{
-						unexpectedMsgId = "request is null";
-					}
-					_logger->log(LogLevel::Warn, "RequestProcessor", "Unexpected occupied request slot: " + std::to_string(id), unexpectedMsgId);
-				}
-			}
+		try
+		{
+			request->id = _pendingRequests.reserve(request);
 		}
-
-		if (request)
+		catch (const std::overflow_error&)
 		{
-			time(&request->lastRefresh);
-			return request;
+			throw std::overflow_error("Unable to create a new request: Too many pending requests.");
 		}
 
-		throw std::overflow_error("Unable to create a new request: Too many pending requests.");
+		return request;
 	}
 
 	SystemRequest_ptr RequestProcessor::freeRequestSlot(uint16 requestId)
 	{
-		std::lock_guard<std::mutex> lock(_mutexPendingRequests);
-
-		SystemRequest_ptr request;
-		if (mapContains(_pendingRequests, requestId))
-		{
-			request = _pendingRequests[requestId];
-			_pendingRequests.erase(requestId);
-		}
-
-		return request;
+		return _pendingRequests.take(requestId);
 	}
 };
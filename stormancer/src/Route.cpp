@@ -5,6 +5,7 @@ namespace Stormancer
 {
 	Route::Route()
 		: _handle(0)
+		, _channelUid(-1)
 	{
 	}
 
@@ -13,6 +14,7 @@ namespace Stormancer
 		, _filter(filter)
 		, _name(routeName)
 		, _metadata(metadata)
+		, _channelUid(-1)
 	{
 	}
 
@@ -49,4 +51,24 @@ namespace Stormancer
 	{
 		return _filter;
 	}
+
+	bool Route::encrypted() const
+	{
+		return _encrypted;
+	}
+
+	void Route::setEncrypted(bool encrypted)
+	{
+		_encrypted = encrypted;
+	}
+
+	int Route::channelUid() const
+	{
+		return _channelUid.load(std::memory_order_relaxed);
+	}
+
+	void Route::setChannelUid(int channelUid)
+	{
+		_channelUid.store(channelUid, std::memory_order_relaxed);
+	}
 };
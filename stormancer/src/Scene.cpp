@@ -18,9 +18,19 @@ namespace Stormancer
 		, _client(client)
 		, _logger(_dependencyResolver->resolve<ILogger>())
 	{
+		std::string cryptKey("crypt");
+		std::string cryptedRoutes;
+		if (mapContains(_metadata, cryptKey))
+		{
+			cryptedRoutes = _metadata.at(cryptKey);
+		}
+		bool cryptAll = (cryptedRoutes.find(";ALL;") != std::string::npos);
+
 		for (auto routeDto : dto.Routes)
 		{
-			_remoteRoutesMap[routeDto.Name] = std::make_shared<Route>(routeDto.Name, routeDto.Handle, MessageOriginFilter::Host, routeDto.Metadata);
+			auto route = std::make_shared<Route>(routeDto.Name, routeDto.Handle, MessageOriginFilter::Host, routeDto.Metadata);
+			route->setEncrypted(cryptAll || cryptedRoutes.find(";+" + routeDto.Name + ";") != std::string::npos);
+			_remoteRoutesMap[routeDto.Name] = route;
 		}
 
 		auto onNext = [=](ConnectionState state) {
@@ -43,7 +53,7 @@ namespace Stormancer
 
 	Scene::~Scene()
 	{
-		_logger->log(LogLevel::Trace, "Scene", "deleting scene...", _id);
+		STORMANCER_LOG(_logger, LogLevel::Trace, "Scene", "deleting scene...", _id);
 
 		auto logger = _logger;
 		disconnect().then([logger](pplx::task<void> t) {
@@ -53,7 +63,7 @@ namespace Stormancer
 			}
 			catch (const std::exception& ex)
 			{
-				logger->log(LogLevel::Trace, "Client", "Ignore scene disconnection failure", ex.what());
+				STORMANCER_LOG(logger, LogLevel::Trace, "Client", "Ignore scene disconnection failure", ex.what());
 			}
 		});
 
@@ -70,7 +80,7 @@ namespace Stormancer
 		_localRoutesMap.clear();
 		_remoteRoutesMap.clear();
 
-		_logger->log(LogLevel::Trace, "Scene", "Scene deleted.", _id);
+		STORMANCER_LOG(_logger, LogLevel::Trace, "Scene", "Scene deleted.", _id);
 	}
 
 	void Scene::initialize()
@@ -175,27 +185,8 @@ namespace Stormancer
 	rxcpp::observable<Packetisp_ptr> Scene::onMessage(Route_ptr route)
 	{
 		auto observable = rxcpp::observable<>::create<Packetisp_ptr>([=](rxcpp::subscriber<Packetisp_ptr> subscriber) {
-			auto handler = std::function<void(Packet_ptr)>([=](Packet_ptr p) {
-				std::shared_ptr<IScenePeer> origin = nullptr;
-				bool isOriginHost = false;
-				if (p->connection->id() == host()->id())
-				{
-					isOriginHost = true;
-					origin = _host;
-				}
-				else
-				{
-					origin = _connectedPeers[p->connection->id()];
-				}
-				if (origin)
-				{
-					if ((isOriginHost && ((int)route->filter() & (int)MessageOriginFilter::Host)) ||
-						((!isOriginHost) && ((int)route->filter() & (int)MessageOriginFilter::Peer))) //Filter packet
-					{
-						Packetisp_ptr packet(new Packet<IScenePeer>(origin, p->stream, p->metadata));
-						subscriber.on_next(packet);
-					}
-				}
+			auto handler = std::function<void(Packetisp_ptr)>([=](Packetisp_ptr p) {
+				subscriber.on_next(p);
 			});
 			route->handlers.push_back(handler);
 			auto it = route->handlers.end();
@@ -209,6 +200,17 @@ namespace Stormancer
 	}
 
 	void Scene::send(const PeerFilter&, const std::string& routeName, const Writer& writer, PacketPriority priority, PacketReliability reliability, const std::string& channelIdentifier)
+	{
+		if (routeName.length() == 0)
+		{
+			throw std::invalid_argument("The Route name is invalid");
+		}
+
+		auto route = remoteRoute(routeName);
+		send(route, writer, (channelIdentifier.empty() ? getChannelUid(route) : getChannelUid(channelIdentifier)), priority, reliability);
+	}
+
+	void Scene::send(const Route_ptr& route, const Writer& writer, int channelUid, PacketPriority priority, PacketReliability reliability)
 	{
 		auto client = _client.lock();
 		if (!client)
@@ -227,38 +229,71 @@ namespace Stormancer
 			throw std::runtime_error("The scene is not connected");
 		}
 
-		if (routeName.length() == 0)
+		peer->getChannelUidStore().touch(channelUid);
+
+		auto writer2 = [=, &writer](obytestream* stream) {
+			(*stream) << _handle;
+			(*stream) << route->handle();
+			if (writer)
+			{
+				writer(stream);
+			}
+		};
+		TransformMetadata transformMetadata;
+		transformMetadata.sceneMetadata = &_metadata;
+		transformMetadata.sceneHandle = _handle;
+		transformMetadata.routeHandle = route->handle();
+		transformMetadata.encrypted = route->encrypted();
+		peer->send(writer2, channelUid, priority, reliability, transformMetadata);
+	}
+
+	Route_ptr Scene::remoteRoute(const std::string& routeName) const
+	{
+		auto it = _remoteRoutesMap.find(routeName);
+		if (it == _remoteRoutesMap.end())
 		{
-			throw std::invalid_argument("The Route name is invalid");
+			throw std::invalid_argument(std::string() + "The route '" + routeName + "' doesn't exist on the scene");
 		}
+		return it->second;
+	}
 
-		if (!mapContains(_remoteRoutesMap, routeName))
+	int Scene::getChannelUid(const std::string& channelIdentifier, const std::string& routeName)
+	{
+		auto peer = _peer.lock();
+		if (!peer)
 		{
-			throw std::invalid_argument(std::string() + "The route '" + routeName + "' doesn't exist on the scene");
+			throw std::runtime_error("Peer deleted");
 		}
 
-		Route_ptr route = _remoteRoutesMap[routeName];
-		int channelUid = 1;
 		if (channelIdentifier.empty())
 		{
+			auto it = _remoteRoutesMap.find(routeName);
+			if (it != _remoteRoutesMap.end())
+			{
+				return getChannelUid(it->second);
+			}
 			std::stringstream ss;
 			ss << "Scene_" << _id << "_" << routeName;
-			channelUid = peer->getChannelUidStore().getChannelUid(ss.str());
+			return peer->getChannelUidStore().getChannelUid(ss.str());
 		}
 		else
 		{
-			channelUid = peer->getChannelUidStore().getChannelUid(channelIdentifier);
+			return peer->getChannelUidStore().getChannelUid(channelIdentifier);
 		}
-		auto writer2 = [=, &writer](obytestream* stream) {
-			(*stream) << _handle;
-			(*stream) << route->handle();
-			if (writer)
-			{
-				writer(stream);
-			}
-		};
-		TransformMetadata transformMetadata{ _metadata };
-		peer->send(writer2, channelUid, priority, reliability, transformMetadata);
+	}
+
+	int Scene::getChannelUid(const Route_ptr& route)
+	{
+		int channelUid = route->channelUid();
+		if (channelUid == -1)
+		{
+			// Resolved once: the route keeps its channel even if the store reassigns it to another identifier
+			std::stringstream ss;
+			ss << "Scene_" << _id << "_" << route->name();
+			channelUid = getChannelUid(ss.str());
+			route->setChannelUid(channelUid);
+		}
+		return channelUid;
 	}
 
 	void Scene::send(const std::string& routeName, const Writer& writer, PacketPriority priority, PacketReliability reliability, const std::string& channelIdentifier)
@@ -292,7 +327,7 @@ namespace Stormancer
 
 	pplx::task<void> Scene::disconnect()
 	{
-		_logger->log(LogLevel::Trace, "Scene", "Scene disconnecting");
+		STORMANCER_LOG(_logger, LogLevel::Trace, "Scene", "Scene disconnecting");
 
 		std::lock_guard<std::mutex> lg(_disconnectMutex);
 
@@ -348,10 +383,17 @@ namespace Stormancer
 	{
 		_handle = cr.SceneHandle;
 
+		_routesByHandle.clear();
 		for (auto pair : _localRoutesMap)
 		{
-			pair.second->setHandle(cr.RouteMappings[pair.first]);
-			_handlers[pair.second->handle()] = pair.second->handlers;
+			uint16 routeHandle = cr.RouteMappings[pair.first];
+			pair.second->setHandle(routeHandle);
+			if (routeHandle >= _routesByHandle.size())
+			{
+				_routesByHandle.resize(routeHandle + 1);
+			}
+			_routesByHandle[routeHandle].route = pair.second;
+			_routesByHandle[routeHandle].handlers = pair.second->handlers;
 		}
 	}
 
@@ -363,18 +405,10 @@ namespace Stormancer
 		*packet->stream >> routeHandle;
 
 
-		if (mapContains(_handlers, routeHandle))
+		if (routeHandle < _routesByHandle.size() && _routesByHandle[routeHandle].route)
 		{
-			Route_ptr route;
-			for (auto it = _localRoutesMap.begin(); it != _localRoutesMap.end(); ++it)
-			{
-				if (it->second->handle() == routeHandle)
-				{
-					route = it->second;
-					break;
-				}
-
-			}
+			auto& routeHandlers = _routesByHandle[routeHandle];
+			auto& route = routeHandlers.route;
 			if (packet->connection->id() == _host->id() && !((int)route->filter() & (int)Stormancer::MessageOriginFilter::Host))
 			{
 				return; // The route doesn't accept messages from the scene host.
@@ -385,11 +419,35 @@ namespace Stormancer
 				return; // The route doesn't accept messages from the scene host.
 			}
 
-			packet->metadata["routeId"] = route->name();
-			auto observers = _handlers[routeHandle];
-			for (auto f : observers)
+			if (routeHandlers.handlers.empty())
+			{
+				return;
+			}
+
+			std::shared_ptr<IScenePeer> origin;
+			if (packet->connection->id() == _host->id())
 			{
-				f(packet);
+				origin = _host;
+			}
+			else
+			{
+				auto it = _connectedPeers.find(packet->connection->id());
+				if (it != _connectedPeers.end())
+				{
+					origin = it->second;
+				}
+			}
+			if (!origin)
+			{
+				return;
+			}
+
+			// One scene packet is shared by all the handlers of the route, and takes over the metadata of the transport packet
+			packet->route = route;
+			Packetisp_ptr scenePacket = _packetPool->acquire(origin, packet);
+			for (auto& f : routeHandlers.handlers)
+			{
+				f(scenePacket);
 			}
 		}
 	}
@@ -406,6 +464,11 @@ namespace Stormancer
 		return _host.get();
 	}
 
+	std::shared_ptr<PacketPool<IScenePeer>> Scene::packetPool() const
+	{
+		return _packetPool;
+	}
+
 	bool Scene::isHost() const
 	{
 		return _isHost;
@@ -0,0 +1,156 @@
+#include "stormancer/stdafx.h"
+#include "stormancer/SceneEndpointCache.h"
+
+namespace Stormancer
+{
+	/// The endpoints are dropped this long before their token expires, so they are not rejected while connecting.
+	static const auto expirationMargin = std::chrono::seconds(30);
+
+	/// Upper bound of the time an endpoint is kept, whatever its token expiration.
+	static const auto maxCacheDuration = std::chrono::minutes(10);
+
+	SceneEndpointCache::SceneEndpointCache(std::shared_ptr<ITokenHandler> tokenHandler)
+		: _tokenHandler(tokenHandler)
+	{
+	}
+
+	pplx::task<SceneEndpoint> SceneEndpointCache::get(const std::string& key, Fetch fetch, pplx::cancellation_token ct)
+	{
+		pplx::task<SceneEndpoint> task;
+		pplx::task_completion_event<SceneEndpoint> fetchTce;
+		uint64 generation = 0;
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			auto it = _entries.find(key);
+			if (it != _entries.end() && (!it->second.fetched || std::chrono::steady_clock::now() < it->second.expiration))
+			{
+				task = it->second.task;
+			}
+			else
+			{
+				auto& entry = _entries[key];
+				entry = Entry();
+				entry.task = pplx::task<SceneEndpoint>(fetchTce);
+				entry.generation = generation = ++_generation;
+				task = entry.task;
+			}
+		}
+
+		if (generation != 0)
+		{
+			std::weak_ptr<SceneEndpointCache> wCache = shared_from_this();
+			pplx::task<SceneEndpoint> fetchTask;
+			try
+			{
+				fetchTask = fetch();
+			}
+			catch (...)
+			{
+				fetchTask = pplx::task_from_exception<SceneEndpoint>(std::current_exception());
+			}
+
+			fetchTask.then([wCache, key, generation, fetchTce](pplx::task<SceneEndpoint> t)
+			{
+				auto cache = wCache.lock();
+				try
+				{
+					auto endpoint = t.get();
+					if (cache)
+					{
+						cache->onFetched(key, generation, endpoint);
+					}
+					fetchTce.set(endpoint);
+				}
+				catch (...)
+				{
+					if (cache)
+					{
+						cache->onFetchFailed(key, generation);
+					}
+					fetchTce.set_exception(std::current_exception());
+				}
+			});
+		}
+
+		// The fetch is shared: canceling this request must not cancel it for the others
+		pplx::task_completion_event<SceneEndpoint> tce;
+		task.then([tce](pplx::task<SceneEndpoint> t)
+		{
+			try
+			{
+				tce.set(t.get());
+			}
+			catch (...)
+			{
+				tce.set_exception(std::current_exception());
+			}
+		});
+		return pplx::task<SceneEndpoint>(tce, ct);
+	}
+
+	void SceneEndpointCache::invalidate(const std::string& key)
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		_entries.erase(key);
+	}
+
+	std::size_t SceneEndpointCache::size() const
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		return _entries.size();
+	}
+
+	void SceneEndpointCache::onFetched(const std::string& key, uint64 generation, const SceneEndpoint& endpoint)
+	{
+		auto expirationMs = expiration(endpoint);
+		auto nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		auto remaining = std::chrono::milliseconds(expirationMs - nowMs) - expirationMargin;
+
+		std::lock_guard<std::mutex> lg(_mutex);
+		auto it = _entries.find(key);
+		if (it == _entries.end() || it->second.generation != generation)
+		{
+			return;
+		}
+
+		if (expirationMs < 0 || remaining <= std::chrono::milliseconds(0))
+		{
+			// Unknown or too close expiration: only the requests waiting for this fetch get the endpoint
+			_entries.erase(it);
+			return;
+		}
+
+		it->second.fetched = true;
+		it->second.expiration = std::chrono::steady_clock::now() + std::min<std::chrono::milliseconds>(remaining, maxCacheDuration);
+	}
+
+	void SceneEndpointCache::onFetchFailed(const std::string& key, uint64 generation)
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		auto it = _entries.find(key);
+		if (it != _entries.end() && it->second.generation == generation)
+		{
+			_entries.erase(it);
+		}
+	}
+
+	int64 SceneEndpointCache::expiration(const SceneEndpoint& endpoint) const
+	{
+		if (endpoint.version == 1)
+		{
+			return endpoint.tokenData.Expiration;
+		}
+
+		if (_tokenHandler && !endpoint.getTokenResponse.token.empty())
+		{
+			try
+			{
+				return _tokenHandler->decodeToken(endpoint.getTokenResponse.token).tokenData.Expiration;
+			}
+			catch (const std::exception&)
+			{
+			}
+		}
+		return -1;
+	}
+}
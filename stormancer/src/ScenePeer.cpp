@@ -28,9 +28,18 @@ namespace Stormancer
 			throw std::invalid_argument(std::string("The routeName '") + routeName + "' is not declared on the server.");
 		}
 		Route_ptr r = _routeMapping[routeName];
-		std::stringstream ss;
-		ss << "ScenePeer_" << id() << "_" << routeName;
-		int channelUid = connection->getChannelUidStore().getChannelUid(ss.str());
+		int channelUid = r->channelUid();
+		if (channelUid == -1)
+		{
+			std::stringstream ss;
+			ss << "ScenePeer_" << id() << "_" << routeName;
+			channelUid = connection->getChannelUidStore().getChannelUid(ss.str());
+			r->setChannelUid(channelUid);
+		}
+		else
+		{
+			connection->getChannelUidStore().touch(channelUid);
+		}
 		connection->send([=, &writer](obytestream* stream) {
 			(*stream) << _sceneHandle;
 			(*stream) << r->handle();
@@ -8,11 +8,16 @@ namespace Stormancer
 		// do nothing
 	}
 
-	void Serializer::UnstackAndDeserialize(const byte*, const uint64, uint64*) const
+	void Serializer::UnstackAndDeserialize(msgpack::zone&, const byte*, const std::size_t, std::size_t&) const
 	{
 		// do nothing
 	}
 
+	bool Serializer::referenceBuffer(msgpack::type::object_type, std::size_t, void*)
+	{
+		return true;
+	}
+
 	template<>
 	void Serializer::deserializeOne(ibytestream*) const
 	{
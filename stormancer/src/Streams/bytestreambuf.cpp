@@ -452,7 +452,8 @@ namespace Stormancer
 			reset();
 			init(newSize);
 
-			_mode = oldMode;
+			// The new buffer is always allocated, even when the old one was external
+			_mode = oldMode | Allocated;
 
 			if (oldSize > 0)
 			{
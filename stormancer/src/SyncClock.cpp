@@ -26,7 +26,7 @@ namespace Stormancer
 	void SyncClock::start(std::weak_ptr<IConnection> connectionPtr, pplx::cancellation_token ct)
 	{
 		auto logger = _dependencyResolver->resolve<ILogger>();
-		logger->log(LogLevel::Trace, "synchronizedClock", "Starting SyncClock...");
+		STORMANCER_LOG(logger, LogLevel::Trace, "synchronizedClock", "Starting SyncClock...");
 
 		if (!compareExchange(_mutex, _isRunning, false, true))
 		{
@@ -78,7 +78,7 @@ namespace Stormancer
 				stop();
 			}));
 
-			logger->log(LogLevel::Trace, "synchronizedClock", "SyncClock started");
+			STORMANCER_LOG(logger, LogLevel::Trace, "synchronizedClock", "SyncClock started");
 		}
 		else
 		{
@@ -89,14 +89,14 @@ namespace Stormancer
 	void SyncClock::stop()
 	{
 		auto logger = _logger;
-		logger->log(LogLevel::Trace, "synchronizedClock", "Stopping SyncClock...");
+		STORMANCER_LOG(logger, LogLevel::Trace, "synchronizedClock", "Stopping SyncClock...");
 
 		if (!compareExchange(_mutex, _isRunning, true, false))
 		{
 			throw std::runtime_error("SyncClock is not started");
 		}
 
-		logger->log(LogLevel::Trace, "synchronizedClock", "SyncClock stopped");
+		STORMANCER_LOG(logger, LogLevel::Trace, "synchronizedClock", "SyncClock stopped");
 	}
 
 	int SyncClock::lastPing()
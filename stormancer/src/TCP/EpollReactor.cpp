@@ -0,0 +1,235 @@
+#include "stormancer/stdafx.h"
+#include "stormancer/TCP/EpollReactor.h"
+
+#if defined(__linux__)
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace Stormancer
+{
+	EpollReactor::State::~State()
+	{
+		if (wakeFd >= 0)
+		{
+			::close(wakeFd);
+		}
+		if (epollFd >= 0)
+		{
+			::close(epollFd);
+		}
+	}
+
+	EpollReactor::EpollReactor(ILogger_ptr logger)
+		: _state(std::make_shared<State>())
+	{
+		_state->logger = logger;
+		_state->epollFd = epoll_create1(EPOLL_CLOEXEC);
+		if (_state->epollFd < 0)
+		{
+			throw std::runtime_error("epoll_create1 failed (errno " + std::to_string(errno) + ')');
+		}
+
+		_state->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (_state->wakeFd < 0)
+		{
+			throw std::runtime_error("eventfd failed (errno " + std::to_string(errno) + ')');
+		}
+
+		epoll_event event = {};
+		event.events = EPOLLIN;
+		event.data.fd = _state->wakeFd;
+		epoll_ctl(_state->epollFd, EPOLL_CTL_ADD, _state->wakeFd, &event);
+	}
+
+	EpollReactor::~EpollReactor()
+	{
+		// When called by a handler, the reactor thread keeps the state (and the file descriptors) until it exits
+		stop();
+	}
+
+	void EpollReactor::start()
+	{
+		{
+			std::lock_guard<std::mutex> lg(_state->mutex);
+			_state->stopRequested = false;
+			_state->stopped = false;
+		}
+		auto state = _state;
+		_thread = std::thread([state]() {
+			// Published before any handler or action runs, so they see they are on the reactor thread
+			state->threadId = std::this_thread::get_id();
+			loop(state);
+		});
+	}
+
+	void EpollReactor::stop()
+	{
+		_state->stopRequested = true;
+		uint64_t one = 1;
+		auto written = ::write(_state->wakeFd, &one, sizeof(one));
+		(void)written;
+
+		if (_thread.joinable())
+		{
+			if (isReactorThread())
+			{
+				// Stopped by a handler: the loop exits when the handler returns, and drops the remaining actions
+				_thread.detach();
+				return;
+			}
+			_thread.join();
+		}
+		dropPostedActions(*_state);
+	}
+
+	void EpollReactor::add(int fd, uint32_t events, Handler handler)
+	{
+		{
+			std::lock_guard<std::mutex> lg(_state->mutex);
+			_state->handlers[fd] = std::make_shared<Handler>(std::move(handler));
+		}
+
+		epoll_event event = {};
+		event.events = events;
+		event.data.fd = fd;
+		if (epoll_ctl(_state->epollFd, EPOLL_CTL_ADD, fd, &event) < 0)
+		{
+			int error = errno;
+			std::lock_guard<std::mutex> lg(_state->mutex);
+			_state->handlers.erase(fd);
+			throw std::runtime_error("epoll_ctl(ADD) failed (errno " + std::to_string(error) + ')');
+		}
+	}
+
+	void EpollReactor::modify(int fd, uint32_t events)
+	{
+		epoll_event event = {};
+		event.events = events;
+		event.data.fd = fd;
+		if (epoll_ctl(_state->epollFd, EPOLL_CTL_MOD, fd, &event) < 0)
+		{
+			throw std::runtime_error("epoll_ctl(MOD) failed (errno " + std::to_string(errno) + ')');
+		}
+	}
+
+	void EpollReactor::remove(int fd)
+	{
+		epoll_ctl(_state->epollFd, EPOLL_CTL_DEL, fd, nullptr);
+		std::lock_guard<std::mutex> lg(_state->mutex);
+		_state->handlers.erase(fd);
+	}
+
+	void EpollReactor::post(std::function<void()> action)
+	{
+		{
+			std::lock_guard<std::mutex> lg(_state->mutex);
+			if (_state->stopped)
+			{
+				return;
+			}
+			_state->postedActions.push_back(std::move(action));
+		}
+		uint64_t one = 1;
+		auto written = ::write(_state->wakeFd, &one, sizeof(one));
+		(void)written;
+	}
+
+	bool EpollReactor::isReactorThread() const
+	{
+		return _state->threadId == std::this_thread::get_id();
+	}
+
+	void EpollReactor::loop(std::shared_ptr<State> state)
+	{
+		const int maxEvents = 64;
+		epoll_event events[maxEvents];
+
+		while (!state->stopRequested)
+		{
+			int count = epoll_wait(state->epollFd, events, maxEvents, -1);
+			if (count < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				state->logger->log(LogLevel::Error, "EpollReactor", "epoll_wait failed", std::to_string(errno));
+				break;
+			}
+
+			for (int i = 0; i < count && !state->stopRequested; i++)
+			{
+				int fd = events[i].data.fd;
+				if (fd == state->wakeFd)
+				{
+					uint64_t value;
+					auto read = ::read(state->wakeFd, &value, sizeof(value));
+					(void)read;
+					runPostedActions(*state);
+					continue;
+				}
+
+				std::shared_ptr<Handler> handler;
+				{
+					std::lock_guard<std::mutex> lg(state->mutex);
+					auto it = state->handlers.find(fd);
+					if (it != state->handlers.end())
+					{
+						handler = it->second;
+					}
+				}
+
+				// The socket may have been removed by a previous handler of the batch
+				if (handler)
+				{
+					try
+					{
+						(*handler)(events[i].events);
+					}
+					catch (const std::exception& ex)
+					{
+						state->logger->log(LogLevel::Error, "EpollReactor", "Socket handler failed", ex.what());
+					}
+				}
+			}
+		}
+
+		dropPostedActions(*state);
+	}
+
+	void EpollReactor::runPostedActions(State& state)
+	{
+		std::vector<std::function<void()>> actions;
+		{
+			std::lock_guard<std::mutex> lg(state.mutex);
+			actions.swap(state.postedActions);
+		}
+
+		// An action may stop the reactor: the next ones are dropped with the actions posted later
+		for (std::size_t i = 0; i < actions.size() && !state.stopRequested; i++)
+		{
+			try
+			{
+				actions[i]();
+			}
+			catch (const std::exception& ex)
+			{
+				state.logger->log(LogLevel::Error, "EpollReactor", "Posted action failed", ex.what());
+			}
+		}
+	}
+
+	void EpollReactor::dropPostedActions(State& state)
+	{
+		std::vector<std::function<void()>> actions;
+		{
+			std::lock_guard<std::mutex> lg(state.mutex);
+			state.stopped = true;
+			actions.swap(state.postedActions);
+		}
+	}
+}
+
+#endif
@@ -1,10 +1,23 @@
 #include "stormancer/stdafx.h"
 #include "stormancer/TCP/TcpConnection.h"
+#include "stormancer/TCP/EpollReactor.h"
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#endif
 
 namespace Stormancer
 {
-	TcpConnection::TcpConnection(std::shared_ptr<SOCKET> socketId, uint64 connectionId, std::string ip)
-		:_socketId(socketId)
+	namespace
+	{
+		/// Maximum number of queued frames written by one sendmsg call.
+		const std::size_t maxIovecs = 64;
+	}
+
+	TcpConnection::TcpConnection(SOCKET socketId, uint64 connectionId, std::string ip, std::shared_ptr<EpollReactor> reactor)
+		: _socketId(socketId)
+		, _reactor(reactor)
 		, _id(connectionId)
 		, _ip(ip)
 	{
@@ -27,9 +40,16 @@ namespace Stormancer
 	{
 		if (_connectionState != ConnectionState::Disconnected && _connectionState != ConnectionState::Disconnecting)
 		{
+			_closeReason = reason;
 			setConnectionState(ConnectionState::Disconnecting);
-			_closeAction("");
-			setConnectionState(ConnectionState::Disconnected);
+#if defined(__linux__)
+			// The reactor sees the end of the stream, and closes the connection like a remote disconnection
+			std::lock_guard<std::mutex> lg(_sendMutex);
+			if (_socketId >= 0)
+			{
+				::shutdown(_socketId, SHUT_RDWR);
+			}
+#endif
 		}
 	}
 
@@ -120,20 +140,123 @@ namespace Stormancer
 
 	void TcpConnection::send(const Writer& writer, int /*channelUid*/, PacketPriority /*priority*/, PacketReliability /*reliability*/, const TransformMetadata& /*transformMetadata*/)
 	{
-		if (!_socketId.expired())
+#if defined(__linux__)
+		// Frame: int32 length, followed by the message
+		obytestream stream;
+		int32_t length = 0;
+		stream.write((const byte*)&length, sizeof(length));
+		if (writer)
+		{
+			writer(&stream);
+		}
+		stream.flush();
+		byte* dataPtr = stream.startPtr();
+		std::size_t dataSize = (std::size_t)stream.writtenBytesCount();
+		length = (int32_t)(dataSize - sizeof(length));
+		std::memcpy(dataPtr, &length, sizeof(length));
+
+		std::lock_guard<std::mutex> lg(_sendMutex);
+		if (_socketId < 0)
+		{
+			return;
+		}
+
+		std::size_t written = 0;
+		if (_sendQueue.empty())
 		{
-			//SOCKET socketId = *(_socketId.lock());
-			obytestream stream;
-			if (writer)
+			// Nothing is pending: write directly from the calling thread
+			ssize_t result = ::send(_socketId, dataPtr, dataSize, MSG_NOSIGNAL);
+			if (result >= 0)
+			{
+				written = (std::size_t)result;
+			}
+			else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				// The reactor reports the error when it reads the socket
+				return;
+			}
+			if (written == dataSize)
 			{
-				writer(&stream);
+				return;
 			}
-			stream.flush();
-			auto bytes = stream.bytes();
+			_sendOffset = written;
+			_reactor->modify(_socketId, EPOLLIN | EPOLLOUT);
+		}
+		_sendQueue.emplace_back(dataPtr, dataPtr + dataSize);
+#else
+		throw std::runtime_error("TCP connections are only supported on Linux");
+#endif
+	}
 
-			//unsigned int length = (unsigned int)bytes.length();
-			//send__(socketId, (char*)&length, sizeof(length), 0);
-			//send__(socketId, bytes.data(), length, 0);
+	bool TcpConnection::flushSendQueue()
+	{
+#if defined(__linux__)
+		std::lock_guard<std::mutex> lg(_sendMutex);
+		while (!_sendQueue.empty() && _socketId >= 0)
+		{
+			iovec iov[maxIovecs];
+			std::size_t count = 0;
+			for (auto it = _sendQueue.begin(); it != _sendQueue.end() && count < maxIovecs; ++it, ++count)
+			{
+				std::size_t offset = (count == 0 ? _sendOffset : 0);
+				iov[count].iov_base = it->data() + offset;
+				iov[count].iov_len = it->size() - offset;
+			}
+
+			msghdr message = {};
+			message.msg_iov = iov;
+			message.msg_iovlen = count;
+			ssize_t result = ::sendmsg(_socketId, &message, MSG_NOSIGNAL);
+			if (result < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return errno == EAGAIN || errno == EWOULDBLOCK;
+			}
+
+			std::size_t written = (std::size_t)result;
+			while (written > 0)
+			{
+				std::size_t remaining = _sendQueue.front().size() - _sendOffset;
+				if (written < remaining)
+				{
+					_sendOffset += written;
+					break;
+				}
+				written -= remaining;
+				_sendOffset = 0;
+				_sendQueue.pop_front();
+			}
+
+			if (!_sendQueue.empty())
+			{
+				// The socket buffer is full
+				return true;
+			}
+		}
+
+		if (_socketId >= 0)
+		{
+			_reactor->modify(_socketId, EPOLLIN);
+		}
+#endif
+		return true;
+	}
+
+	void TcpConnection::closeSocket()
+	{
+#if defined(__linux__)
+		std::lock_guard<std::mutex> lg(_sendMutex);
+		if (_socketId >= 0)
+		{
+			_reactor->remove(_socketId);
+			::close(_socketId);
+			_socketId = -1;
 		}
+		_sendQueue.clear();
+		_sendOffset = 0;
+#endif
 	}
 }
@@ -1,84 +1,155 @@
 #include "stormancer/stdafx.h"
 #include "stormancer/TCP/TcpTransport.h"
+#include "stormancer/TCP/EpollReactor.h"
+#include "stormancer/Configuration.h"
 #include "stormancer/MessageIDTypes.h"
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <netinet/tcp.h>
+#endif
+
 namespace Stormancer
 {
+	namespace
+	{
+		/// Size of the receive blocks. Larger messages get a dedicated block.
+		const std::size_t receiveBlockSize = 64 * 1024;
+
+		/// Maximum number of free receive blocks kept by the transport.
+		const std::size_t receiveBlockPoolCapacity = 32;
+
+		const std::size_t frameHeaderSize = sizeof(int32_t);
+
+		/// Maximum size of the received frames when the configuration is not registered.
+		const std::size_t defaultMaxFrameSize = 16 * 1024 * 1024;
+	}
+
+	TcpTransport::ReceiveBlockPool::ReceiveBlockPool(std::size_t blockSize, std::size_t capacity)
+		: _blockSize(blockSize)
+		, _capacity(capacity)
+	{
+	}
+
+	TcpTransport::ReceiveBlockPool::~ReceiveBlockPool()
+	{
+		for (auto block : _free)
+		{
+			delete block;
+		}
+	}
+
+	TcpTransport::ReceiveBlock* TcpTransport::ReceiveBlockPool::take(std::size_t minSize)
+	{
+		ReceiveBlock* block = nullptr;
+		if (minSize <= _blockSize)
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			if (!_free.empty())
+			{
+				block = _free.back();
+				_free.pop_back();
+			}
+		}
+
+		if (!block)
+		{
+			block = new ReceiveBlock();
+			block->data.resize(std::max(minSize, _blockSize));
+		}
+		block->references = 1;
+		block->begin = 0;
+		block->end = 0;
+		return block;
+	}
+
+	void TcpTransport::ReceiveBlockPool::release(ReceiveBlock* block)
+	{
+		if (--block->references > 0)
+		{
+			return;
+		}
+
+		if (block->data.size() == _blockSize)
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			if (_free.size() < _capacity)
+			{
+				_free.push_back(block);
+				return;
+			}
+		}
+		delete block;
+	}
+
 	TcpTransport::TcpTransport(DependencyResolver* dependencyResolver)
 		: _dependencyResolver(dependencyResolver)
 		, _logger(dependencyResolver->resolve<ILogger>())
-		, _scheduler(dependencyResolver->resolve<IScheduler>())
+		, _blockPool(std::make_shared<ReceiveBlockPool>(receiveBlockSize, receiveBlockPoolCapacity))
+		, _maxFrameSize(defaultMaxFrameSize)
 		, _name("tcp")
+		, _id(0)
 	{
+		auto config = dependencyResolver->resolve<Configuration>();
+		if (config && config->maxFrameSize > 0)
+		{
+			_maxFrameSize = (std::size_t)config->maxFrameSize;
+		}
+
+		auto blockPool = _blockPool;
+		_packetPool->setBufferReleaser([blockPool](void* block, void*) {
+			blockPool->release((ReceiveBlock*)block);
+		});
 	}
 
 	TcpTransport::~TcpTransport()
 	{
-		_logger->log(LogLevel::Trace, "TcpTransport", "Deleting TCP transport...");
+		STORMANCER_LOG(_logger, LogLevel::Trace, "TcpTransport", "Deleting TCP transport...");
 
 		if (_isRunning)
 		{
 			stop();
 		}
 
-		if (_listeningThread)
-		{
-			_listeningThread->detach();
-		}
-
-		_logger->log(LogLevel::Trace, "TcpTransport", "TCP transport deleted");
+		STORMANCER_LOG(_logger, LogLevel::Trace, "TcpTransport", "TCP transport deleted");
 	}
 
 	void TcpTransport::start(std::string type, std::shared_ptr<IConnectionManager> handler, pplx::cancellation_token ct, uint16 port, uint16)
 	{
-		_logger->log(LogLevel::Trace, "TcpTransport", "Starting TCP transport...");
+		STORMANCER_LOG(_logger, LogLevel::Trace, "TcpTransport", "Starting TCP transport...");
 
-		if (!compareExchange(_mutex, _isRunning, false, true))
-		{
-			throw std::runtime_error("TCP transport is already started.");
-		}
+#if !defined(__linux__)
+		throw std::runtime_error("TCP transport is only supported on Linux.");
+#endif
 
 		if (port > 0)
 		{
 			throw std::invalid_argument("TCP transport does not support opening a server port.");
 		}
 
+		if (!compareExchange(_mutex, _isRunning, false, true))
+		{
+			throw std::runtime_error("TCP transport is already started.");
+		}
+
 		_type = type;
 		_handler = handler;
-		initialize();
 
-		_scheduler->schedulePeriodic(15, [=]() {
-			// action queue
-			{
-				std::lock_guard<std::mutex> lock(_actionQueueMutex);
-				while (!_actionQueue.empty())
-				{
-					_actionQueue.front()();
-					_actionQueue.pop();
-				}
-			}
-			// packet queue
-			{
-				std::lock_guard<std::mutex> lock(_mutex);
-				if (_isRunning)
-				{
-					run();
-				}
-			}
-		}, ct);
+#if defined(__linux__)
+		_reactor = std::make_shared<EpollReactor>(_logger);
+		_reactor->start();
+#endif
 
 		ct.register_callback([=]()
 		{
 			stop();
 		});
 
-		_logger->log(LogLevel::Trace, "TcpTransport", "TCP transport started");
+		STORMANCER_LOG(_logger, LogLevel::Trace, "TcpTransport", "TCP transport started");
 	}
 
 	pplx::task<std::shared_ptr<IConnection>> TcpTransport::connect(std::string endpoint, pplx::cancellation_token ct)
 	{
-		std::lock_guard<std::mutex> lock(_mutex);
-
 		std::smatch m;
 		std::regex ipRegex("^(([0-9A-F]{1,4}:){7}[0-9A-F]{1,4}|(\\d{1,3}\\.){3}\\d{1,3}):(\\d{1,5})$", std::regex_constants::ECMAScript | std::regex_constants::icase);
 		bool res = std::regex_search(endpoint, m, ipRegex);
@@ -87,32 +158,74 @@ namespace Stormancer
 			throw std::invalid_argument("Bad scene endpoint (" + endpoint + ')');
 		}
 
-		//_host = m.str(1);
-		_port = (uint16)std::atoi(m.str(4).c_str());
-		if (_port == 0)
+		std::string host = m.str(1);
+		uint16 port = (uint16)std::atoi(m.str(4).c_str());
+		if (port == 0)
 		{
 			throw std::runtime_error("Scene endpoint port should not be 0 (" + endpoint + ')');
 		}
 
-		if (_socketId == nullptr)
+#if defined(__linux__)
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (!_isRunning || !_reactor)
 		{
 			throw std::runtime_error("TCP transport not started. Make sure you started it.");
 		}
 
-		if (_listeningThread)
+		sockaddr_in sin = {};
+		sin.sin_family = AF_INET;
+		if (inet_pton(AF_INET, host.c_str(), &sin.sin_addr) <= 0)
 		{
-			throw std::runtime_error("Connect has already been called on this TCP transport, and TCP transports only supports connection to a single endpoint.");
+			throw std::runtime_error("Unable to resolve ip " + endpoint);
 		}
+		sin.sin_port = htons(port);
 
-		auto tce = pplx::task_completion_event<std::weak_ptr<IConnection>>();
-		_pendingConnections[endpoint] = tce;
+		SOCKET socketId = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+		if (socketId < 0)
+		{
+			throw std::runtime_error("Could not create the tcp socket. Error: " + std::to_string(errno));
+		}
 
-		_listeningThread = std::make_shared<std::thread>(&TcpTransport::listen, this, endpoint);
+		// The messages are already framed: don't wait to fill segments
+		int noDelay = 1;
+		setsockopt(socketId, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
 
-		return pplx::create_task(tce).then([] (std::weak_ptr<IConnection> connection)
+		if (::connect(socketId, (sockaddr*)&sin, sizeof(sin)) < 0 && errno != EINPROGRESS)
 		{
-			return connection.lock();
-		}, ct);
+			int error = errno;
+			::close(socketId);
+			throw std::runtime_error("Unable to connect to endpoint " + endpoint + ". Error: " + std::to_string(error));
+		}
+
+		_host = host;
+		_port = port;
+
+		auto& state = _sockets[socketId];
+		state.connection = std::make_shared<TcpConnection>(socketId, 0, _host, _reactor);
+		state.connection->setConnectionState(ConnectionState::Connecting);
+		state.endpoint = endpoint;
+		auto connected = state.connected;
+
+		try
+		{
+			// The socket is writable once connected
+			_reactor->add(socketId, EPOLLOUT, [this, socketId](uint32_t events) {
+				onSocketEvent(socketId, events);
+			});
+		}
+		catch (...)
+		{
+			_sockets.erase(socketId);
+			::close(socketId);
+			throw;
+		}
+
+		return pplx::create_task(connected, pplx::task_options(ct));
+#else
+		(void)ct;
+		throw std::runtime_error("TCP transport is only supported on Linux.");
+#endif
 	}
 
 	bool TcpTransport::isRunning() const
@@ -155,204 +268,302 @@ namespace Stormancer
 		return std::vector<std::string>(1, _host + ":" + std::to_string(_port));
 	}
 
-	void TcpTransport::initialize()
+	std::shared_ptr<PacketPool<>> TcpTransport::packetPool() const
 	{
-		_logger->log(LogLevel::Trace, "TcpTransport", "Initializing TCP transport", _type.c_str());
-
-		auto s = socket__(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-		if (s < 0)
-		{
-			throw std::runtime_error(std::string("Could not create the tcp socket. Error: " + std::to_string(s)));
-		}
-
-		_socketId = std::shared_ptr<SOCKET>(new SOCKET(s), [](SOCKET* socketId)
-		{
-			closesocket__(*socketId);
-			delete(socketId);
-		});
+		return _packetPool;
 	}
 
-	void TcpTransport::run()
+	void TcpTransport::onConnectionIdReceived(int64 id)
 	{
-		Packet_ptr packet;
+		_id = id;
+	}
 
-		bool shouldLoop = true;
-		while (shouldLoop)
+	void TcpTransport::onSocketEvent(SOCKET socketId, uint32_t events)
+	{
+#if defined(__linux__)
+		SocketState* state;
 		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			auto it = _sockets.find(socketId);
+			if (it == _sockets.end())
 			{
-				std::lock_guard<std::mutex> lg(_packetQueueMutex);
-				shouldLoop = _pendingPackets.size() > 0;
+				return;
+			}
+			// The elements of the map are stable, and only erased on the reactor thread
+			state = &it->second;
+		}
 
-				if (shouldLoop)
-				{
-					packet = _pendingPackets.front();
-					_pendingPackets.pop();
-				}
-				else
+		if (state->connection->getConnectionState() == ConnectionState::Connecting)
+		{
+			int error = 0;
+			socklen_t errorSize = sizeof(error);
+			if (getsockopt(socketId, SOL_SOCKET, SO_ERROR, &error, &errorSize) < 0)
+			{
+				error = errno;
+			}
+			if (error != 0)
+			{
+				auto connected = state->connected;
+				auto endpoint = state->endpoint;
+				state->connection->closeSocket();
 				{
-					packet = nullptr;
+					std::lock_guard<std::mutex> lg(_mutex);
+					_sockets.erase(socketId);
 				}
+				connected.set_exception(std::runtime_error("Unable to connect to endpoint " + endpoint + ". Error: " + std::to_string(error)));
+				return;
 			}
+			onConnected(*state);
+			return;
+		}
 
-			if (packet)
+		if (events & EPOLLOUT)
+		{
+			if (!state->connection->flushSendQueue())
 			{
-				_onPacketReceived(packet);
+				onDisconnection(socketId, "an error occurred");
+				return;
 			}
 		}
-	}
 
-	void TcpTransport::onConnectionIdReceived(int64 id)
-	{
-		_id = id;
+		if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+		{
+			receive(*state);
+		}
+#else
+		(void)socketId;
+		(void)events;
+#endif
 	}
 
-	void TcpTransport::listen(std::string endpoint)
+	void TcpTransport::onConnected(SocketState& state)
 	{
-		_logger->log(LogLevel::Trace, "TcpTransport", "Start listening");
+#if defined(__linux__)
+		STORMANCER_LOG(_logger, LogLevel::Trace, "TcpTransport", "Connected", state.endpoint.c_str());
 
-		sockaddr_in sin;
+		auto connection = state.connection;
+		auto endpoint = state.endpoint;
+		connection->onClose([=](std::string reason) {
+			STORMANCER_LOG(_logger, LogLevel::Trace, "TcpTransport", "Closed ", endpoint.c_str());
+		});
 
+		state.block = _blockPool->take(receiveBlockSize);
+		_reactor->modify(connection->_socketId, EPOLLIN);
 
+		_handler->newConnection(connection);
+		connection->setConnectionState(ConnectionState::Connected);
 
-		sin.sin_family = AF_INET;
-		if (inet_pton(AF_INET, _host.c_str(), &sin.sin_addr) <= 0)
-		{
-			_pendingConnections[endpoint].set_exception(std::runtime_error(std::string("Unable to resolve ip ") + endpoint));
-			return;
-		}
-		sin.sin_port = htons(_port);
+		state.connected.set(connection);
+#else
+		(void)state;
+#endif
+	}
 
-		auto ret = ::connect__(*_socketId, (sockaddr*)&sin, sizeof(sin));
-		if (ret < 0)
+	void TcpTransport::receive(SocketState& state)
+	{
+#if defined(__linux__)
+		// Kept alive to check the socket after the packet handlers, which can stop the transport and release the state
+		auto connection = state.connection;
+		SOCKET socketId = connection->_socketId;
+		while (true)
 		{
-			_pendingConnections[endpoint].set_exception(std::runtime_error(std::string("Unable to connect to endpoint ") + endpoint));
-			return;
-		}
+			ReceiveBlock* block = state.block;
+			if (block->begin == block->end && block->references == 1)
+			{
+				// No packet reads the block anymore: reuse it from the start
+				block->begin = 0;
+				block->end = 0;
+			}
 
-		_connection = createNewConnection(endpoint);
-		_pendingConnections[endpoint].set(_connection);
+			if (block->end == block->data.size())
+			{
+				// The block is full: move the incomplete frame to a new block, large enough for the whole frame
+				std::size_t pending = block->end - block->begin;
+				std::size_t required = receiveBlockSize;
+				if (pending >= frameHeaderSize)
+				{
+					// The length of the incomplete frame was already checked by parseFrames
+					int32_t length;
+					std::memcpy(&length, block->data.data() + block->begin, sizeof(length));
+					required = std::max(required, frameHeaderSize + (std::size_t)length);
+				}
+				ReceiveBlock* next = _blockPool->take(required);
+				std::memcpy(next->data.data(), block->data.data() + block->begin, pending);
+				next->end = pending;
+				_blockPool->release(block);
+				state.block = next;
+				block = next;
+			}
 
-		int readbytes = 0;
-		while (isRunning() && _socketId)
-		{
-			SOCKET socketId = *_socketId;
-			int msgLength;
-			readbytes = recv__(socketId, (char*)&msgLength, sizeof(msgLength), MSG_WAITALL);
-			if (readbytes < sizeof(msgLength))
+			ssize_t received = ::recv(socketId, block->data.data() + block->end, block->data.size() - block->end, 0);
+			if (received > 0)
 			{
-				std::lock_guard<std::mutex> lg(_actionQueueMutex);
-				_actionQueue.push([=]()
+				block->end += (std::size_t)received;
+				if (!parseFrames(state))
 				{
-					onDisconnection(endpoint, readbytes == 0 ? "remote server disconnected." : "an error occurred");
-				});
-				break;
+					onDisconnection(socketId, "invalid frame received.");
+					return;
+				}
+				// The socket may have been closed by a packet handler: the state must not be used anymore
+				if (connection->_socketId < 0)
+				{
+					return;
+				}
 			}
-			if (msgLength == 0)
+			else if (received == 0)
 			{
-				continue;
+				onDisconnection(socketId, "remote server disconnected.");
+				return;
+			}
+			else if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				return;
 			}
-			auto buffer = new byte[msgLength];
+			else if (errno != EINTR)
+			{
+				onDisconnection(socketId, "an error occurred");
+				return;
+			}
+		}
+#else
+		(void)state;
+#endif
+	}
 
-			readbytes = recv__(socketId, (char*)buffer, msgLength, MSG_WAITALL);
-			if (readbytes < msgLength)
+	bool TcpTransport::parseFrames(SocketState& state)
+	{
+		auto connection = state.connection;
+		ReceiveBlock* block = state.block;
+		while (block->end - block->begin >= frameHeaderSize)
+		{
+			int32_t length;
+			std::memcpy(&length, block->data.data() + block->begin, sizeof(length));
+			if (length < 0 || (std::size_t)length > _maxFrameSize)
+			{
+				return false;
+			}
+			if (block->end - block->begin - frameHeaderSize < (std::size_t)length)
 			{
-				std::lock_guard<std::mutex> lg(_actionQueueMutex);
-				_actionQueue.push([=]()
-				{
-					onDisconnection(endpoint, readbytes == 0 ? "remote server disconnected." : "an error occurred");
-				});
-				delete[] buffer;
 				break;
 			}
 
-			if (buffer[0] == (byte)MessageIDTypes::ID_CONNECTION_RESULT)
+			byte* frame = block->data.data() + block->begin + frameHeaderSize;
+			block->begin += frameHeaderSize + (std::size_t)length;
+			if (length == 0)
+			{
+				continue;
+			}
+
+			if (frame[0] == (byte)MessageIDTypes::ID_CONNECTION_RESULT && length > (int32_t)sizeof(int64))
 			{
-				int64 sid = *(int64*)(buffer + 1);
-				_logger->log(LogLevel::Trace, "TcpTransport", "Connection ID received.", std::to_string(sid).c_str());
+				int64 sid;
+				std::memcpy(&sid, frame + 1, sizeof(sid));
+				STORMANCER_LOG(_logger, LogLevel::Trace, "TcpTransport", "Connection ID received.", std::to_string(sid).c_str());
 				onConnectionIdReceived(sid);
-				delete[] buffer;
 				continue;
 			}
 
-			auto stream = new ibytestream;
-			stream->rdbuf()->pubsetbuf(buffer, msgLength);
-			Packet_ptr packet(new Packet<>(_connection, stream), deleter<Packet<>>());
-			packet->cleanup += std::function<void(void)>([=]() {
-				if (stream)
-				{
-					stream->rdbuf()->pubsetbuf(nullptr, 0);
-					delete stream;
-				}
-				if (buffer)
-				{
-					delete[] buffer;
-				}
-			});
+			// The packet reads the message in the block, which it keeps alive until it is released
+			block->references++;
+			Packet_ptr packet = _packetPool->acquire(connection, frame, (std::streamsize)length, block);
+			_onPacketReceived(packet);
 
+			// A packet handler may have stopped the transport, which closed the socket and released the state and the block
+			if (connection->_socketId < 0)
 			{
-				std::lock_guard<std::mutex> lg(_packetQueueMutex);
-				_pendingPackets.push(packet);
+				return true;
 			}
 		}
-
-		_logger->log(LogLevel::Trace, "TcpTransport", "Stop listening");
+		return true;
 	}
 
-	std::shared_ptr<TcpConnection> TcpTransport::createNewConnection(std::string endpoint)
+	void TcpTransport::onDisconnection(SOCKET socketId, std::string reason)
 	{
-		_logger->log(LogLevel::Trace, "TcpTransport", "Connected", endpoint.c_str());
-		uint64 cid = 0;
-		std::shared_ptr<TcpConnection> connection = std::make_shared<TcpConnection>(_socketId, cid, _host);
-		connection->onClose([=](std::string reason) {
-			_logger->log(LogLevel::Trace, "tcpTransport", "Closed ", endpoint.c_str());
-		});
-		_connection = connection;
-
-		_handler->newConnection(connection);
+		std::shared_ptr<TcpConnection> connection;
+		ReceiveBlock* block = nullptr;
+		std::string endpoint;
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			auto it = _sockets.find(socketId);
+			if (it == _sockets.end())
+			{
+				return;
+			}
+			connection = it->second.connection;
+			block = it->second.block;
+			endpoint = it->second.endpoint;
+			_sockets.erase(it);
+		}
 
-		connection->setConnectionState(ConnectionState::Connected);
+		connection->closeSocket();
+		if (block)
+		{
+			_blockPool->release(block);
+		}
 
-		return connection;
-	}
+		if (!connection->_closeReason.empty())
+		{
+			reason = connection->_closeReason;
+		}
 
-	void TcpTransport::onDisconnection(std::string endpoint, std::string reason)
-	{
 		auto msg = endpoint + " disconnected.";
-		_logger->log(LogLevel::Trace, "TcpTransport", msg.c_str(), reason.c_str());
-		if (_connection)
+		STORMANCER_LOG(_logger, LogLevel::Trace, "TcpTransport", msg.c_str(), reason.c_str());
+
+		if (_handler)
 		{
-			_handler->closeConnection(_connection, reason);
-			_connection->_closeAction(reason);
-			_connection->setConnectionState(ConnectionState::Disconnected);
-			_connection = nullptr;
+			_handler->closeConnection(connection, reason);
 		}
+		connection->_closeAction(reason);
+		connection->setConnectionState(ConnectionState::Disconnected);
 	}
 
 	void TcpTransport::stop()
 	{
-		_logger->log(LogLevel::Trace, "TcpTransport", "Stopping TCP transport...");
+		STORMANCER_LOG(_logger, LogLevel::Trace, "TcpTransport", "Stopping TCP transport...");
 
 		if (!compareExchange(_mutex, _isRunning, true, false))
 		{
 			throw std::runtime_error("TCP transport is not started");
 		}
 
-		_socketId = nullptr;
+		// No handler runs once the reactor is stopped
+		if (_reactor)
+		{
+			_reactor->stop();
+		}
 
-		if (_listeningThread)
+		std::unordered_map<SOCKET, SocketState> sockets;
 		{
-			_listeningThread->join();
-			_listeningThread.reset();
+			std::lock_guard<std::mutex> lg(_mutex);
+			sockets.swap(_sockets);
 		}
 
-		_connection = nullptr;
+		for (auto& socket : sockets)
+		{
+			auto& state = socket.second;
+			bool wasConnected = state.connection->getConnectionState() != ConnectionState::Connecting;
+			state.connection->closeSocket();
+			if (state.block)
+			{
+				_blockPool->release(state.block);
+			}
+			if (wasConnected)
+			{
+				state.connection->_closeAction("TCP transport stopped");
+				state.connection->setConnectionState(ConnectionState::Disconnected);
+			}
+			else
+			{
+				state.connected.set_exception(std::runtime_error("TCP transport stopped before the connection to " + state.endpoint));
+			}
+		}
 
 		if (_handler)
 		{
 			_handler.reset();
 		}
 
-		_logger->log(LogLevel::Trace, "TcpTransport", "TCP transport stopped");
+		STORMANCER_LOG(_logger, LogLevel::Trace, "TcpTransport", "TCP transport stopped");
 	}
 
 	pplx::task<int> TcpTransport::sendPing(const std::string& /*address*/, pplx::cancellation_token /*ct*/)
@@ -360,6 +571,11 @@ namespace Stormancer
 		throw std::runtime_error("not implemented");
 	}
 
+	pplx::task<int> TcpTransport::sendPing(const std::string& /*address*/, const int /*nb*/, pplx::cancellation_token /*ct*/)
+	{
+		throw std::runtime_error("not implemented");
+	}
+
 	void TcpTransport::openNat(const std::string& /*address*/)
 	{
 		throw std::runtime_error("not implemented");
@@ -18,7 +18,8 @@ namespace Stormancer
 	}
 
 	TimerThread::TimerThread() :
-		_thread(&TimerThread::_threadLoop, this)
+		_state(std::make_shared<State>()),
+		_thread(&TimerThread::_threadLoop, _state)
 	{
 	}
 
@@ -27,103 +28,260 @@ namespace Stormancer
 		_stop(true);
 	}
 
-	void TimerThread::schedule(std::function<void()> func, clock_type::time_point when)
+	TimerThread::TimerId TimerThread::schedule(std::function<void()> func, clock_type::time_point when, bool runInline)
 	{
 		assert(func);
 
-		std::unique_lock<std::mutex> lock(_mutex);
+		TimerWheel::Timer timer;
+		timer.function = std::move(func);
+		timer.expiry = _state->toTick(when);
+		timer.runInline = runInline;
+		return add(std::move(timer));
+	}
 
-		if (_stopRequested)
+	TimerThread::TimerId TimerThread::schedulePeriodic(std::function<void()> func, std::chrono::milliseconds period, clock_type::time_point firstRun, pplx::cancellation_token ct, bool runInline)
+	{
+		assert(func);
+
+		if (period.count() <= 0)
 		{
-			return;
+			throw std::out_of_range("TimerThread: the period must be positive.");
+		}
+
+		TimerWheel::Timer timer;
+		timer.function = std::move(func);
+		timer.expiry = _state->toTick(firstRun);
+		timer.period = (uint64)period.count();
+		timer.runInline = runInline;
+		timer.token = ct;
+		return add(std::move(timer));
+	}
+
+	bool TimerThread::cancel(TimerId id)
+	{
+		std::lock_guard<std::mutex> lock(_state->mutex);
+		return _state->wheel.cancel(id);
+	}
+
+	std::size_t TimerThread::size()
+	{
+		std::lock_guard<std::mutex> lock(_state->mutex);
+		return _state->wheel.size();
+	}
+
+	uint64 TimerThread::State::toTick(clock_type::time_point time) const
+	{
+		if (time <= start)
+		{
+			return 0;
+		}
+		return (uint64)std::chrono::duration_cast<std::chrono::milliseconds>(time - start).count();
+	}
+
+	TimerThread::TimerId TimerThread::add(TimerWheel::Timer&& timer)
+	{
+		std::lock_guard<std::mutex> lock(_state->mutex);
+
+		if (_state->stopRequested)
+		{
+			return 0;
 		}
 
-		// Do not notify the thread if there is a pending function that is scheduled to run earlier
-		// than the new to-be-scheduled function
-		bool notifyThread = true;
-		if (!_taskQueue.empty() && _taskQueue.top().scheduledTime <= when)
+		auto& wheel = _state->wheel;
+
+		// The wheel doesn't advance while it is empty: catch up with the current time
+		if (wheel.pendingCount() == 0)
 		{
-			notifyThread = false;
+			auto now = _state->toTick(clock_type::now());
+			if (now > wheel.currentTick())
+			{
+				std::vector<TimerId> expired;
+				wheel.advance(now - 1, expired);
+			}
 		}
 
-		_taskQueue.emplace(when, func);
-		if (notifyThread)
+		// Do not notify the thread if it will wake up before the new timer expires
+		auto expiry = timer.expiry;
+		auto id = wheel.add(std::move(timer));
+		if (expiry < _state->wakeTick)
 		{
-			_cond.notify_one();
+			_state->cond.notify_one();
 		}
+		return id;
 	}
 
 	void TimerThread::_stop(bool immediate)
 	{
 		{
-			std::unique_lock<std::mutex> lock(_mutex);
+			std::lock_guard<std::mutex> lock(_state->mutex);
 
-			_stopRequested = true;
+			_state->stopRequested = true;
 
 			if (immediate)
 			{
-				// Clear function queue
-				func_queue_type emptyQueue;
-				_taskQueue.swap(emptyQueue);
+				_state->wheel.clear();
 			}
 		}
 
-		_cond.notify_one();
+		_state->cond.notify_one();
 		_thread.join();
 	}
 
-	void TimerThread::_threadLoop()
+	void TimerThread::_threadLoop(std::shared_ptr<State> state)
 	{
-		while (!(_stopRequested && _taskQueue.empty()))
+		std::vector<TimerId> expired;
+		std::vector<Run> runs;
+
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->wakeTick = 0;
+
+		while (!(state->stopRequested && state->wheel.pendingCount() == 0))
 		{
-			std::function<void()> function;
+			expired.clear();
+			state->wheel.advance(state->toTick(clock_type::now()), expired);
 
-			// Retrieve the next function to be run
+			if (expired.empty())
 			{
-				std::unique_lock<std::mutex> lock(_mutex);
+				uint64 nextTick = 0;
+				if (state->wheel.nextTick(nextTick))
+				{
+					state->wakeTick = nextTick;
+					state->cond.wait_until(lock, state->start + std::chrono::milliseconds(nextTick));
+				}
+				else
+				{
+					state->wakeTick = std::numeric_limits<uint64>::max();
+					state->cond.wait(lock);
+				}
+				state->wakeTick = 0;
+				continue;
+			}
 
-				
-				if (_taskQueue.empty() && !_stopRequested)
+			for (auto id : expired)
+			{
+				auto timer = state->wheel.get(id);
+				if (!timer)
 				{
-					_cond.wait(lock);
 					continue;
 				}
 
-				auto duration = _taskQueue.top().scheduledTime - clock_type::now();
-				if (duration > std::chrono::milliseconds(1))
+				if (timer->token.is_canceled())
 				{
-					_cond.wait_for(lock, duration);
+					state->wheel.complete(id, 0, true);
 					continue;
 				}
+
+				Run run{ id, nullptr, nullptr, timer->runInline };
+				if (timer->period == 0)
+				{
+					run.function = std::move(timer->function);
+					state->wheel.complete(id, 0, true);
+				}
 				else
 				{
-					function = _taskQueue.top().function;
-					_taskQueue.pop();
+					// The function of a periodic timer stays in the wheel, which keeps the timer until it is completed
+					run.periodicTimer = timer;
 				}
+				runs.push_back(std::move(run));
 			}
 
-			// Run the function on its own task
-			if (function)
+			lock.unlock();
+
+			for (auto& run : runs)
 			{
-				pplx::task<void>(function).then([](pplx::task<void> result)
+				if (run.runInline)
 				{
-					// We do not want to crash if the function throws, so handle any exception
+					// We do not want to crash if the function throws
 					try
 					{
-						result.get();
+						if (run.periodicTimer)
+						{
+							run.periodicTimer->function();
+						}
+						else
+						{
+							run.function();
+						}
 					}
-					catch (std::exception&)
+					catch (...)
 					{
-						// print
 					}
-				});
+				}
+				else
+				{
+					_runTask(state, std::move(run));
+				}
 			}
-			else if (!_stopRequested)
+
+			lock.lock();
+
+			for (auto& run : runs)
 			{
-				// User pushed an empty function.
-				throw std::runtime_error("TimerThread: cannot run an empty function");
+				if (run.runInline && run.periodicTimer)
+				{
+					_completePeriodic(*state, run.id);
+				}
 			}
+			runs.clear();
+		}
+	}
+
+	void TimerThread::_runTask(std::shared_ptr<State> state, Run run)
+	{
+		if (run.periodicTimer)
+		{
+			auto timer = run.periodicTimer;
+			auto id = run.id;
+			pplx::create_task([timer]()
+			{
+				timer->function();
+			}).then([state, id](pplx::task<void> result)
+			{
+				// We do not want to crash if the function throws, so handle any exception
+				try
+				{
+					result.get();
+				}
+				catch (...)
+				{
+				}
+
+				std::lock_guard<std::mutex> lock(state->mutex);
+				_completePeriodic(*state, id);
+			});
+		}
+		else
+		{
+			pplx::create_task(std::move(run.function)).then([](pplx::task<void> result)
+			{
+				// We do not want to crash if the function throws, so handle any exception
+				try
+				{
+					result.get();
+				}
+				catch (...)
+				{
+				}
+			});
+		}
+	}
+
+	void TimerThread::_completePeriodic(State& state, TimerId id)
+	{
+		auto timer = state.wheel.get(id);
+		if (!timer)
+		{
+			return;
+		}
+
+		bool release = state.stopRequested || timer->token.is_canceled();
+		auto nextExpiry = state.toTick(clock_type::now()) + timer->period;
+		state.wheel.complete(id, nextExpiry, release);
+
+		if (!release && nextExpiry < state.wakeTick)
+		{
+			state.cond.notify_one();
 		}
 	}
 
-}
\ No newline at end of file
+}
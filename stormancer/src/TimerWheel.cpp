@@ -0,0 +1,313 @@
+#include "stormancer/stdafx.h"
+#include "stormancer/TimerWheel.h"
+
+namespace Stormancer
+{
+	TimerWheel::TimerWheel()
+	{
+		std::fill(std::begin(_root), std::end(_root), nullptr);
+		for (auto& level : _levels)
+		{
+			std::fill(std::begin(level), std::end(level), nullptr);
+		}
+	}
+
+	TimerWheel::~TimerWheel()
+	{
+	}
+
+	TimerWheel::TimerId TimerWheel::add(Timer&& timer)
+	{
+		Node* node;
+		if (_freeNodes.empty())
+		{
+			_nodes.emplace_back();
+			node = &_nodes.back();
+			node->index = (uint32)(_nodes.size() - 1);
+		}
+		else
+		{
+			node = &_nodes[_freeNodes.back()];
+			_freeNodes.pop_back();
+		}
+
+		node->timer = std::move(timer);
+		node->generation++;
+		if (node->generation == 0)
+		{
+			node->generation++;
+		}
+		insert(node);
+
+		return ((TimerId)node->generation << 32) | node->index;
+	}
+
+	bool TimerWheel::cancel(TimerId id)
+	{
+		auto node = find(id);
+		if (!node)
+		{
+			return false;
+		}
+
+		switch (node->state)
+		{
+		case NodeState::Pending:
+			unlink(node);
+			release(node);
+			return true;
+		case NodeState::Expired:
+			node->state = NodeState::Cancelled;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void TimerWheel::advance(uint64 tick, std::vector<TimerId>& expired)
+	{
+		while (_currentTick <= tick)
+		{
+			if (_pendingCount == 0)
+			{
+				_currentTick = tick + 1;
+				return;
+			}
+
+			uint32 index = (uint32)(_currentTick & (rootSize - 1));
+
+			// Skip the ticks without timers
+			if (index != 0 && !_root[index])
+			{
+				uint64 next;
+				nextTick(next);
+				_currentTick = std::min(next, tick + 1);
+				continue;
+			}
+
+			if (index == 0)
+			{
+				for (int level = 0; level < levelsCount; level++)
+				{
+					uint32 levelIndex = (uint32)((_currentTick >> (rootBits + level * levelBits)) & (levelSize - 1));
+					cascade(level, levelIndex);
+					if (levelIndex != 0)
+					{
+						break;
+					}
+				}
+			}
+
+			while (_root[index])
+			{
+				auto node = _root[index];
+				unlink(node);
+				node->state = NodeState::Expired;
+				expired.push_back(((TimerId)node->generation << 32) | node->index);
+			}
+
+			_currentTick++;
+		}
+	}
+
+	TimerWheel::Timer* TimerWheel::get(TimerId id)
+	{
+		auto node = find(id);
+		if (!node || node->state == NodeState::Free)
+		{
+			return nullptr;
+		}
+		return &node->timer;
+	}
+
+	void TimerWheel::complete(TimerId id, uint64 nextExpiry, bool release)
+	{
+		auto node = find(id);
+		if (!node || (node->state != NodeState::Expired && node->state != NodeState::Cancelled))
+		{
+			return;
+		}
+
+		if (release || node->state == NodeState::Cancelled || node->timer.period == 0)
+		{
+			this->release(node);
+		}
+		else
+		{
+			node->timer.expiry = nextExpiry;
+			insert(node);
+		}
+	}
+
+	bool TimerWheel::nextTick(uint64& tick) const
+	{
+		if (_pendingCount == 0)
+		{
+			return false;
+		}
+
+		// The slots of the next levels must be moved to the first level before the timers of the current tick can be collected
+		uint32 index = (uint32)(_currentTick & (rootSize - 1));
+		if (index == 0)
+		{
+			tick = _currentTick;
+			return true;
+		}
+
+		uint64 next = std::numeric_limits<uint64>::max();
+		for (uint32 i = 0; i < rootSize; i++)
+		{
+			if (_root[(index + i) & (rootSize - 1)])
+			{
+				next = _currentTick + i;
+				break;
+			}
+		}
+		if (index + (next - _currentTick) < rootSize)
+		{
+			tick = next;
+			return true;
+		}
+
+		// The timers of the next levels can't expire before the start of their slot
+		for (int level = 0; level < levelsCount; level++)
+		{
+			int shift = rootBits + level * levelBits;
+			uint64 block = _currentTick >> shift;
+			for (uint32 i = 1; i <= levelSize; i++)
+			{
+				if (_levels[level][(block + i) & (levelSize - 1)])
+				{
+					next = std::min(next, (block + i) << shift);
+					break;
+				}
+			}
+		}
+
+		tick = next;
+		return true;
+	}
+
+	uint64 TimerWheel::currentTick() const
+	{
+		return _currentTick;
+	}
+
+	std::size_t TimerWheel::size() const
+	{
+		return _nodes.size() - _freeNodes.size();
+	}
+
+	std::size_t TimerWheel::pendingCount() const
+	{
+		return _pendingCount;
+	}
+
+	void TimerWheel::clear()
+	{
+		for (auto& node : _nodes)
+		{
+			if (node.state == NodeState::Pending)
+			{
+				unlink(&node);
+				release(&node);
+			}
+		}
+	}
+
+	TimerWheel::Node* TimerWheel::find(TimerId id)
+	{
+		uint32 index = (uint32)(id & 0xffffffff);
+		uint32 generation = (uint32)(id >> 32);
+		if (index >= _nodes.size())
+		{
+			return nullptr;
+		}
+		auto node = &_nodes[index];
+		if (node->generation != generation || node->state == NodeState::Free)
+		{
+			return nullptr;
+		}
+		return node;
+	}
+
+	void TimerWheel::insert(Node* node)
+	{
+		uint64 expiry = std::max(node->timer.expiry, _currentTick);
+		uint64 delta = expiry - _currentTick;
+
+		Node** slot;
+		if (delta < rootSize)
+		{
+			slot = &_root[expiry & (rootSize - 1)];
+		}
+		else
+		{
+			int level = 0;
+			while (level < levelsCount - 1 && delta >= ((uint64)1 << (rootBits + (level + 1) * levelBits)))
+			{
+				level++;
+			}
+
+			// Timers beyond the range of the wheel wait in the farthest slot, and are placed again when it is reached
+			uint64 maxDelta = ((uint64)1 << (rootBits + levelsCount * levelBits)) - 1;
+			if (delta > maxDelta)
+			{
+				expiry = _currentTick + maxDelta;
+			}
+			slot = &_levels[level][(expiry >> (rootBits + level * levelBits)) & (levelSize - 1)];
+		}
+
+		node->slot = slot;
+		node->prev = nullptr;
+		node->next = *slot;
+		if (*slot)
+		{
+			(*slot)->prev = node;
+		}
+		*slot = node;
+		node->state = NodeState::Pending;
+		_pendingCount++;
+	}
+
+	void TimerWheel::unlink(Node* node)
+	{
+		if (node->prev)
+		{
+			node->prev->next = node->next;
+		}
+		else
+		{
+			*node->slot = node->next;
+		}
+		if (node->next)
+		{
+			node->next->prev = node->prev;
+		}
+		node->prev = nullptr;
+		node->next = nullptr;
+		node->slot = nullptr;
+		_pendingCount--;
+	}
+
+	void TimerWheel::release(Node* node)
+	{
+		node->timer = Timer();
+		node->state = NodeState::Free;
+		_freeNodes.push_back(node->index);
+	}
+
+	void TimerWheel::cascade(int level, uint32 index)
+	{
+		auto node = _levels[level][index];
+		_levels[level][index] = nullptr;
+
+		while (node)
+		{
+			auto next = node->next;
+			_pendingCount--;
+			insert(node);
+			node = next;
+		}
+	}
+};
@@ -42,7 +42,7 @@ namespace Stormancer
 			<< " " << cData.SceneId
 			<< " " << cData.UserData
 			<< " " << cData.Version;
-		_logger->log(LogLevel::Trace, "TokenHandler", "Decoded token : " + ss.str());
+		STORMANCER_LOG(_logger, LogLevel::Trace, "TokenHandler", "Decoded token : " + ss.str());
 
 		return SceneEndpoint(token, cData);
 	}